@@ -0,0 +1,239 @@
+// batch.c - short records scattered over memory, parsed k at a time
+// compile: cc -O2 -o batch batch.c
+//
+// batch [-m MB] [-n records]
+//
+// -n records (default 1000000) of a few fields each are placed at random in
+// an arena of -m MB (default 1024, larger than the last level cache), so
+// each record starts with a cache miss, as records reached through a hash
+// table or an index would. they are parsed once one after another in a loop,
+// then with uubatch() interleaving k parses on one thread, k = 1 to 32; each
+// is timed best of 3. one record in 1000 is malformed and fails with uuerror().
+// -m 1 -n 4000 keeps the arena in cache and shows what the switching costs
+// (-n is at most the number of 256-byte slots, 4096 a MB).
+
+// record:
+//      field { field }
+// field:
+//      name "=" value
+// value:
+//      integer | name | "[" name { "," name } "]"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+
+#define UUBATCH
+#define UUTERMINALS X(_name_) X(_int_)
+
+#include "uuscan.h"
+#include "bench.h"
+
+#define EQ      CHAR('=')
+#define LBRACK  CHAR('[')
+#define RBRACK  CHAR(']')
+#define COMMA   CHAR(',')
+
+// terminal scanners:
+
+UUDEFINE(_name_)
+{
+    if (!isalpha(*lp))
+        return fail(lp);
+    while (isalnum(*lp) || *lp == '_')
+        ++lp;
+    return success(lp);
+}
+
+UUDEFINE(_int_, long *v)
+{
+    long n = 0;
+
+    if (!isdigit(*lp))
+        return fail(lp);
+    while (isdigit(*lp))
+        n = n * 10 + *lp++ - '0';
+    if (v)
+        *v = n;
+    return success(lp);
+}
+
+struct tally {
+    long fields, sum;
+};
+
+void
+value(struct tally *t)
+{
+    long n;
+
+    if (accept(_int_, &n))
+        t->sum += n;
+    else if (accept(LBRACK)) {
+        do
+            expect(_name_, NULL, "tag expected");
+        while (accept(COMMA));
+        expect(RBRACK);
+    } else
+        expect(_name_, NULL, "value expected");
+}
+
+bool
+record(void *res)
+{
+    struct tally *t = res;
+
+    if (!accept(_name_))
+        return false;
+    do {
+        expect(EQ);
+        value(t);
+        ++t->fields;
+    } while (accept(_name_));
+    return true;
+}
+
+// input:
+
+#define SLOT    256             // one record per slot, at a random offset
+
+static const char *names[] = {
+    "user", "host", "region", "mode", "plan", "state", "owner", "zone",
+};
+static const char *words[] = {
+    "alice", "bob", "eu1", "us2", "fast", "slow", "gold", "idle", "web", "db",
+};
+#define NNAMES  (int)(sizeof names / sizeof names[0])
+#define NWORDS  (int)(sizeof words / sizeof words[0])
+
+static int
+generate(char *cp, int i)
+{
+    char *start = cp;
+
+    cp += sprintf(cp, "id=%d", i);
+    for (int nf = 2 + rnd(4); nf > 0; --nf)
+        switch (rnd(3)) {
+        case 0: cp += sprintf(cp, " ttl=%u", rnd(100000)); break;
+        case 1: cp += sprintf(cp, " %s=%s", names[rnd(NNAMES)], words[rnd(NWORDS)]); break;
+        case 2:
+            cp += sprintf(cp, " tags=[%s", words[rnd(NWORDS)]);
+            for (int nt = rnd(3); nt > 0; --nt)
+                cp += sprintf(cp, ",%s", words[rnd(NWORDS)]);
+            *cp++ = ']';
+            break;
+        }
+    if (i % 1000 == 999)
+        cp += sprintf(cp, " owner=");   // value expected
+    *cp++ = '\0';
+    return cp - start;
+}
+
+int
+main(int argc, char **argv)
+{
+    long mb = 1024;
+    int n = 1000000, opt;
+
+    while ((opt = getopt(argc, argv, "m:n:")) != -1)
+        switch (opt) {
+        case 'm': mb = atol(optarg); break;
+        case 'n': n = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: batch [-m MB] [-n records]\n");
+            return 1;
+        }
+
+    size_t slots = mb * 1024 * 1024 / SLOT;
+    char *arena = malloc(slots * SLOT);
+    unsigned *slot = malloc(slots * sizeof *slot);
+    struct uujob *jobs = calloc(n, sizeof *jobs);
+    char (*msgs)[80] = malloc(n * sizeof *msgs);
+    struct tally tally;
+
+    if (n < 1 || slots < 1 || (size_t)n > slots) {
+        fprintf(stderr, "batch: %d records do not fit in %ld MB\n", n, mb);
+        return 1;
+    }
+    if (arena == NULL || slot == NULL || jobs == NULL || msgs == NULL) {
+        perror("batch");
+        return 1;
+    }
+
+    // records in shuffled slots: consecutive jobs are far apart
+    for (size_t i = 0; i < slots; ++i)
+        slot[i] = i;
+    for (size_t i = slots - 1; i > 0; --i) {
+        size_t j = ((size_t)rnd(1u << 30) << 30 | rnd(1u << 30)) % (i + 1);
+        unsigned t = slot[i]; slot[i] = slot[j]; slot[j] = t;
+    }
+    for (int i = 0; i < n; ++i) {
+        char rec[SLOT];
+        int len = generate(rec, i);
+
+        jobs[i].line = arena + (size_t)slot[i] * SLOT + rnd(SLOT - len + 1);
+        memcpy(jobs[i].line, rec, len);
+        jobs[i].res = &tally;
+        jobs[i].msg = msgs[i];
+    }
+    free(slot);
+
+    printf("%d records in %ld MB, best of 3\n", n, mb);
+    for (int k = 0; k <= 32; k = k? k * 2 : 1) {
+        double best = 0;
+        long ok = 0, errors = 0, yields = 0;
+
+        for (int run = 0; run < 3; ++run) {
+            double t = now();
+
+            memset(&tally, 0, sizeof tally);
+            if (k == 0) {
+                // one parse at a time, as a plain on_uuerror loop would
+                for (int i = 0; i < n; ++i) {
+                    volatile int status = UUPARSE_OK;
+
+                    uu.lp = uu.line = jobs[i].line;
+                    on_uuerror {
+                        status = UUPARSE_ERROR;
+                        goto next;
+                    }
+                    if (!record(&tally))
+                        status = UUPARSE_NOMATCH;
+                    else if (*skipspace(uu.lp))
+                        status = UUPARSE_TRAILING;
+next:
+                    jobs[i].status = status;
+                }
+            } else if (uubatch(jobs, n, k, record) < 0) {
+                perror("batch");
+                return 1;
+            }
+            t = now() - t;
+            keepbest(&best, t);
+            yields = k? uubatch_yields() : 0;
+        }
+
+        for (int i = 0; i < n; ++i)
+            if (jobs[i].status == UUPARSE_OK)
+                ++ok;
+            else
+                ++errors;
+        if (k == 0)
+            printf("loop    ");
+        else
+            printf("k = %-3d ", k);
+        printf("%7.1f ns/record  %6.2f Mrecords/s  %4.2f switches/record  "
+               "%ld ok  %ld errors  %ld fields  sum %ld\n",
+               best / n * 1e9, n / best / 1e6, (double)yields / n, ok, errors,
+               tally.fields, tally.sum);
+    }
+    // a sample error, from the last uubatch() run
+    for (int i = 0; i < n; ++i)
+        if (jobs[i].status != UUPARSE_OK) {
+            printf("record %d: %s\n", i, jobs[i].status == UUPARSE_ERROR? jobs[i].msg
+                   : jobs[i].status == UUPARSE_TRAILING? "input left over" : "no match");
+            break;
+        }
+    return 0;
+}
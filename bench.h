@@ -0,0 +1,85 @@
+// bench.h - helpers shared by the example programs
+// a clock, a random number generator with a fixed seed so that generated
+// input is the same from run to run, whole input read into memory and split
+// into lines, and keeping the best of repeated timings
+// github.com/spinau/uuscan
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// seconds on the monotonic clock
+static inline double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// xorshift, the same sequence every run; a program may save and set rng
+static unsigned long long rng __attribute__((unused)) = 88172645463325252ULL;
+
+// random number in [0, n)
+static inline unsigned
+rnd(unsigned n)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng % n;
+}
+
+// all of fp, NUL terminated; its length in *len if len is not NULL
+static inline char *
+readall(FILE *fp, size_t *len)
+{
+    size_t sz = 1 << 20, n, got = 0;
+    char *buf = (char *)malloc(sz);
+
+    while (buf && (n = fread(buf + got, 1, sz - got - 1, fp)) > 0)
+        if ((got += n) == sz - 1)
+            buf = (char *)realloc(buf, sz *= 2);
+
+    if (buf == NULL) {
+        perror("input");
+        exit(1);
+    }
+    buf[got] = '\0';
+    if (len)
+        *len = got;
+    return buf;
+}
+
+// split buf into lines in place, returns the array of line starts
+static inline char **
+splitlines(char *buf, long *n)
+{
+    long sz = 1024;
+    char **lines = (char **)malloc(sz * sizeof *lines);
+
+    for (*n = 0; lines && *buf; ++*n) {
+        char *nl = strchr(buf, '\n');
+        if (*n == sz)
+            lines = (char **)realloc(lines, (sz *= 2) * sizeof *lines);
+        lines[*n] = buf;
+        if (nl == NULL)
+            break;
+        *nl = '\0';
+        buf = nl + 1;
+    }
+    if (lines == NULL) {
+        perror("input");
+        exit(1);
+    }
+    return lines;
+}
+
+// keep t in *best if it is the first timing or a faster one
+static inline void
+keepbest(double *best, double t)
+{
+    if (*best == 0 || t < *best)
+        *best = t;
+}
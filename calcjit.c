@@ -0,0 +1,493 @@
+// calcjit.c - native code for hot example.c expressions
+// compile: cc -O2 -o calcjit calcjit.c
+//
+// calcjit [-n hot] [-r rounds] [file]
+//
+// reads expressions, one per line, and evaluates the whole list -r times
+// (default 1000), as an alerting loop evaluates its formulas, three ways:
+//
+//      reparse     parse each line and run its actions, as example.c does
+//      actions     parse each distinct line once, keep its actions with
+//                  uudetach() and run them on every evaluation
+//      jit         as actions, but a line evaluated more than -n times
+//                  (default 100) is compiled to x86-64 code in an mmap'd
+//                  region and called instead
+//
+// and reports ns per evaluation. every evaluation must give the same value or
+// the same error all three ways; rand() is seeded alike for each so that its
+// calls line up. the compiled code loads identifiers from a slot array, read
+// from the environment once, and makes the same division checks as divide().
+// on other machines jit runs the actions.
+//
+// e.g. gen -g expr -n 1000 -w primary=3,0,1,1,1,1 | calcjit
+
+#define main example_main
+#include "example.c"
+#include "bench.h"
+#undef main
+
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+
+struct formula {
+    char *text;             // the line; env actions point into it
+    struct uuaction *prog;  // its actions, NULL if it did not parse
+    int nprog;
+    int error;              // parse error, a msgid()
+    long evals;
+    calc_t (*code)(calc_t *slots, calc_t *stack, int *err);
+    bool nocode;            // not compilable, keeps running the actions
+};
+
+// results: a value, or ERROR with the message id
+#define ERROR   (1LL << 32)
+
+// messages seen, so that errors compare by number
+int
+msgid(char *msg)
+{
+    static char *msgs[64];
+    static int nmsgs;
+
+    for (int i = 0; i < nmsgs; ++i)
+        if (strcmp(msgs[i], msg) == 0)
+            return i;
+    if (nmsgs == NELEMS(msgs))
+        return nmsgs;
+    msgs[nmsgs] = strdup(msg);
+    return nmsgs++;
+}
+
+// compiled code is packed into one region, so hot formulas share pages; it
+// is mapped read and execute, and writable only while a formula is written
+#define ARENA (16 << 20)
+
+unsigned char *arena;
+size_t arenaused;
+
+// variables: each identifier gets a slot, read from the environment once
+
+#define MAXSLOTS 256
+
+char slotname[MAXSLOTS][MAXIDENTLEN+1];
+calc_t slots[MAXSLOTS];
+int nslots;
+
+// slot of identifier p, -1 if it is not in the environment
+int
+slot(char *p, int n)
+{
+    char id[MAXIDENTLEN+1], *cp;
+
+    strncpy(id, p, n = n>MAXIDENTLEN? MAXIDENTLEN : n);
+    id[n] = '\0';
+    for (int i = 0; i < nslots; ++i)
+        if (strcmp(slotname[i], id) == 0)
+            return i;
+    if (nslots == MAXSLOTS || (cp = getenv(id)) == NULL)
+        return -1;
+    strcpy(slotname[nslots], id);
+    slots[nslots] = (calc_t) atoi(cp);
+    return nslots++;
+}
+
+//{{{ x86-64 code generation
+#ifdef __x86_64__
+// the value stack is kept as the actions keep it, in memory from r12 up, but
+// with its top in eax; a constant or variable right operand goes straight to
+// ecx. rbx holds the slot array, r13 the error flag
+//
+//      prologue    push rbx, r12, r13 (aligns rsp for calls); load them
+//      push        spill eax to [r12], r12 += 4; load eax
+//      binop       right to ecx, pop left to eax; op eax, ecx
+//      call        spill eax; r12 -= 4n; fn(n, r12) leaves the result in eax
+//      error       mov dword [r13], code; jmp epilogue
+
+static unsigned char *pc;
+
+static void emit(const char *b, int n) { memcpy(pc, b, n); pc += n; }
+static void emit4(uint32_t v) { memcpy(pc, &v, 4); pc += 4; }
+static void emit8(uint64_t v) { memcpy(pc, &v, 8); pc += 8; }
+
+#define E(s)    emit(s, sizeof s - 1)
+
+enum { ERR_DIVZERO = 1, ERR_OVERFLOW };
+
+static unsigned char *jumps[1024];  // rel32 jumps to the epilogue, to patch
+static int njumps;
+
+static bool
+errjump(int code)
+{
+    if (njumps == NELEMS(jumps))
+        return false;
+    E("\x41\xc7\x45\x00");          // mov dword [r13], code
+    emit4(code);
+    E("\xe9");                      // jmp epilogue
+    jumps[njumps++] = pc;
+    emit4(0);
+    return true;
+}
+
+// eax = eax op ecx; k is the constant right operand or NULL
+static bool
+binop(void (*fn)(void *, long), calc_t *k)
+{
+    if (fn == add)
+        E("\x01\xc8");              // add eax, ecx
+    else if (fn == sub)
+        E("\x29\xc8");              // sub eax, ecx
+    else if (fn == mul)
+        E("\x0f\xaf\xc1");          // imul eax, ecx
+    else {
+        // divide()'s checks, in its order; a constant divisor drops them
+        if (k == NULL) {
+            E("\x85\xc9\x75\x0d");  // test ecx, ecx; jne +13
+            if (!errjump(ERR_DIVZERO))
+                return false;
+        } else if (*k == 0 && !errjump(ERR_DIVZERO))
+            return false;
+        if (k == NULL || *k == -1) {
+            E("\x83\xf9\xff\x75\x14");      // cmp ecx, -1; jne +20
+            E("\x3d\x00\x00\x00\x80");      // cmp eax, INT_MIN
+            E("\x75\x0d");                  // jne +13
+            if (!errjump(ERR_OVERFLOW))
+                return false;
+        }
+        E("\x99\xf7\xf9");          // cdq; idiv ecx
+    }
+    return true;
+}
+
+static bool
+isbinop(void (*fn)(void *, long))
+{
+    return fn == add || fn == sub || fn == mul || fn == divide;
+}
+
+// code for f's actions, false if they are not all compilable
+bool
+compile(struct formula *f)
+{
+    size_t size = f->nprog * 48 + 64; // longest code per action, and the rest
+    unsigned char *code = arena + arenaused;
+    unsigned char *page = (unsigned char *)((uintptr_t)code & ~(uintptr_t)4095);
+    size_t pages = code + size - page;
+    int depth = 0, s;
+
+    if (arenaused + size > ARENA || mprotect(page, pages, PROT_READ|PROT_WRITE) != 0)
+        return false;
+    pc = code;
+    njumps = 0;
+
+    E("\x53\x41\x54\x41\x55");      // push rbx; push r12; push r13
+    E("\x48\x89\xfb");              // mov rbx, rdi
+    E("\x49\x89\xf4");              // mov r12, rsi
+    E("\x49\x89\xd5");              // mov r13, rdx
+
+    for (int i = 0; i < f->nprog; ++i) {
+        struct uuaction *a = &f->prog[i];
+
+        if (a->fn == push || a->fn == env) {
+            s = a->fn == env? slot(a->p, a->n) : 0;
+            if (s < 0)
+                goto fail;
+
+            // pushval() raises an error past MAXSTACK values
+            if (depth + 1 > MAXSTACK)
+                goto fail;
+
+            // right operand of the next action: straight to ecx
+            if (i + 1 < f->nprog && isbinop(f->prog[i+1].fn) && depth > 0) {
+                calc_t k = a->n;
+                if (a->fn == push) {
+                    E("\xb9");      // mov ecx, imm32
+                    emit4(k);
+                } else {
+                    E("\x8b\x8b");  // mov ecx, [rbx + disp32]
+                    emit4(s * sizeof(calc_t));
+                }
+                if (!binop(f->prog[++i].fn, a->fn == push? &k : NULL))
+                    goto fail;
+                continue;
+            }
+
+            if (depth > 0)
+                E("\x41\x89\x04\x24\x49\x83\xc4\x04");  // mov [r12], eax; add r12, 4
+            if (a->fn == push) {
+                E("\xb8");          // mov eax, imm32
+                emit4(a->n);
+            } else {
+                E("\x8b\x83");      // mov eax, [rbx + disp32]
+                emit4(s * sizeof(calc_t));
+            }
+            ++depth;
+        } else if (a->fn == neg) {
+            E("\xf7\xd8");          // neg eax
+        } else if (isbinop(a->fn)) {
+            E("\x89\xc1");          // mov ecx, eax
+            E("\x49\x83\xec\x04");  // sub r12, 4
+            E("\x41\x8b\x04\x24");  // mov eax, [r12]
+            if (!binop(a->fn, NULL))
+                goto fail;
+            --depth;
+        } else if (a->fn == call) {
+            if (depth > 0)
+                E("\x41\x89\x04\x24\x49\x83\xc4\x04");  // mov [r12], eax; add r12, 4
+            if (a->n > 0) {
+                E("\x49\x83\xec");  // sub r12, 4n
+                *pc++ = a->n * sizeof(calc_t);
+            }
+            E("\xbf");              // mov edi, n
+            emit4(a->n);
+            E("\x4c\x89\xe6");      // mov rsi, r12
+            E("\x48\xb8");          // mov rax, fn
+            emit8((uintptr_t)((struct fn_list *)a->p)->fn);
+            E("\xff\xd0");          // call rax
+            if ((depth += 1 - a->n) > MAXSTACK)
+                goto fail;
+        } else
+            goto fail;
+    }
+    if (depth != 1)
+        goto fail;
+
+    for (int j = 0; j < njumps; ++j) {
+        int32_t rel = pc - (jumps[j] + 4);
+        memcpy(jumps[j], &rel, 4);
+    }
+    E("\x41\x5d\x41\x5c\x5b\xc3");  // pop r13; pop r12; pop rbx; ret
+
+    if (mprotect(page, pages, PROT_READ|PROT_EXEC) != 0)
+        return false;
+    f->code = (calc_t (*)(calc_t *, calc_t *, int *))code;
+    arenaused = (pc - arena + 15) & ~(size_t)15;
+    return true;
+
+fail:
+    mprotect(page, pages, PROT_READ|PROT_EXEC);
+    return false;
+}
+#else
+bool compile(struct formula *f) { return false; }
+#endif
+//}}}
+
+// input and formulas
+
+struct formula **line;  // per input line, lines with the same text share one
+long nlines;
+struct formula *formulas;
+long nformulas;
+
+void
+readlines(FILE *fp)
+{
+    char *buf = NULL;
+    size_t bufsz = 0, tabsz = 1024;
+    struct formula **tab;
+    long len;
+
+    line = malloc(tabsz / 2 * sizeof *line);
+    formulas = malloc(tabsz / 2 * sizeof *formulas);
+    tab = calloc(tabsz, sizeof *tab);
+
+    while (line && formulas && tab && (len = getline(&buf, &bufsz, fp)) > 0) {
+        unsigned h = 5381;
+
+        if (buf[len-1] == '\n')
+            buf[len-1] = '\0';
+        for (char *cp = buf; *cp; ++cp)
+            h = h * 33 + *cp;
+
+        struct formula **e = &tab[h & (tabsz - 1)];
+        while (*e && strcmp((*e)->text, buf) != 0)
+            if (++e == tab + tabsz)
+                e = tab;
+        if (*e == NULL) {
+            *e = &formulas[nformulas++];
+            memset(*e, 0, sizeof **e);
+            (*e)->text = strdup(buf);
+        }
+        line[nlines++] = *e;
+
+        // keep the table half empty; formulas moves, so index it afresh
+        if (nlines == tabsz / 2) {
+            struct formula *old = formulas;
+
+            tabsz *= 2;
+            line = realloc(line, tabsz / 2 * sizeof *line);
+            formulas = realloc(formulas, tabsz / 2 * sizeof *formulas);
+            free(tab);
+            tab = calloc(tabsz, sizeof *tab);
+            if (!line || !formulas || !tab)
+                break;
+            for (long i = 0; i < nlines; ++i)
+                line[i] = formulas + (line[i] - old);
+            for (long i = 0; i < nformulas; ++i) {
+                h = 5381;
+                for (char *cp = formulas[i].text; *cp; ++cp)
+                    h = h * 33 + *cp;
+                for (e = &tab[h & (tabsz - 1)]; *e; )
+                    if (++e == tab + tabsz)
+                        e = tab;
+                *e = &formulas[i];
+            }
+        }
+    }
+    if (!line || !formulas || !tab) {
+        perror("calcjit");
+        exit(1);
+    }
+    free(tab);
+}
+
+// parse each formula once and keep its actions
+void
+prepare()
+{
+    static long i; // survives the uuerror longjmp
+
+    i = 0;
+    on_uuerror
+        formulas[i++].error = msgid(uu.msg);
+
+    for (; i < nformulas; ++i) {
+        uu.lp = uu.line = formulas[i].text;
+        expr();
+        formulas[i].prog = uudetach(&formulas[i].nprog);
+    }
+}
+
+long hot = 100;
+calc_t jitstack[MAXSTACK];
+
+// one timed pass of method h over rounds of all lines, results into res
+double
+run(int h, long long *res, long total)
+{
+    static long k; // survives the uuerror longjmp
+    static int errid[3];
+    double t;
+
+    errid[ERR_DIVZERO] = msgid("division by zero");
+    errid[ERR_OVERFLOW] = msgid("integer overflow");
+    arenaused = 0;
+    for (long i = 0; i < nformulas; ++i) {
+        formulas[i].code = NULL;
+        formulas[i].nocode = false;
+        formulas[i].evals = 0;
+    }
+    srand(1);
+    k = 0;
+    t = now();
+
+    on_uuerror
+        res[k++] = ERROR | msgid(uu.msg);
+
+    for (; k < total; ++k) {
+        struct formula *f = line[k % nlines];
+
+        if (h == 0) {
+            uu.lp = uu.line = f->text;
+            expr();
+            sp = stack;
+            uurun();
+            res[k] = (uint32_t)*--sp;
+            continue;
+        }
+
+        if (f->prog == NULL) {
+            res[k] = ERROR | f->error;
+            continue;
+        }
+
+        if (h == 2 && f->code == NULL && !f->nocode && ++f->evals > hot)
+            f->nocode = !compile(f);
+
+        if (f->code) {
+            int err = 0;
+            calc_t v = f->code(slots, jitstack, &err);
+            res[k] = err? ERROR | errid[err] : (uint32_t)v;
+        } else {
+            sp = stack;
+            for (int j = 0; j < f->nprog; ++j)
+                f->prog[j].fn(f->prog[j].p, f->prog[j].n);
+            res[k] = (uint32_t)*--sp;
+        }
+    }
+    return now() - t;
+}
+
+int
+main(int argc, char **argv)
+{
+    static char *how[] = { "reparse", "actions", "jit" };
+    double best[NELEMS(how)] = { 0 };
+    long rounds = 1000, compiled = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:r:")) != -1)
+        switch (opt) {
+        case 'n': hot = atol(optarg); break;
+        case 'r': rounds = atol(optarg); break;
+        default:
+            fprintf(stderr, "usage: calcjit [-n hot] [-r rounds] [file]\n");
+            return 1;
+        }
+    if (optind < argc) {
+        FILE *fp = fopen(argv[optind], "r");
+        if (fp == NULL) {
+            perror(argv[optind]);
+            return 1;
+        }
+        readlines(fp);
+    } else
+        readlines(stdin);
+    if (nlines == 0 || rounds < 1) {
+        fprintf(stderr, "calcjit: nothing to evaluate\n");
+        return 1;
+    }
+
+    uuterms[_eol_].name = "end of line";
+    prepare();
+
+    arena = mmap(NULL, ARENA, PROT_READ|PROT_EXEC, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if (arena == MAP_FAILED) {
+        perror("calcjit");
+        return 1;
+    }
+
+    long total = nlines * rounds;
+    long long *res[NELEMS(how)];
+    for (int h = 0; h < NELEMS(how); ++h)
+        if ((res[h] = malloc(total * sizeof *res[h])) == NULL) {
+            perror("calcjit");
+            return 1;
+        }
+
+    // interleaved so drift affects all methods alike
+    for (int rep = 0; rep < 3; ++rep)
+        for (int h = 0; h < NELEMS(how); ++h) {
+            double t = run(h, res[h], total);
+            keepbest(&best[h], t);
+        }
+
+    for (int h = 1; h < NELEMS(how); ++h)
+        for (long k = 0; k < total; ++k)
+            if (res[h][k] != res[0][k]) {
+                fprintf(stderr, "calcjit: %s differs at line %ld \"%s\": %llx, reparse %llx\n",
+                        how[h], k % nlines + 1, line[k % nlines]->text, res[h][k], res[0][k]);
+                return 1;
+            }
+
+    for (long i = 0; i < nformulas; ++i)
+        compiled += formulas[i].code != NULL;
+    printf("%ld lines, %ld formulas, %ld compiled (%zu bytes of code), %ld rounds\n",
+           nlines, nformulas, compiled, arenaused, rounds);
+    for (int h = 0; h < NELEMS(how); ++h)
+        printf("%-8s %8.1f ns/eval\n", how[h], best[h] / total * 1e9);
+    return 0;
+}
@@ -0,0 +1,342 @@
+// cli.c - network-style command lines with abbreviated keywords
+// compile: cc -O2 -o cli cli.c
+//
+// cli [-n] [-c] [-b lines]
+//
+// reads command lines from stdin and writes each with its keywords spelled
+// out ("sh ip int br" -> "show ip interface brief"), or the error. keywords
+// are matched through UUKEYS sets; -n matches them with a scanner that
+// tries every keyword of the set in turn, as a grammar without keyword sets
+// would. -b generates lines of randomly abbreviated commands and times both
+// ways over them, best of 3. compiled with -DUUCOMPLETE, -c reads partial
+// lines instead and writes what could come next at the end of each.
+
+// line:
+//      "show" target { option | arg }
+//    | "clear" ( "counters" | "arp-cache" | "logging" | "ip" "route" ) { arg }
+//    | "configure" "terminal"
+//    | command { arg }
+// target:
+//      "interface" | "ip" ( "route" | "interface" | "bgp" | ... ) | "version" | ...
+// option:
+//      "brief" | "detail" | "summary"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+
+#define UUTERMINALS X(_arg_) X(_abbrev_)
+
+#include "uuscan.h"
+#include "bench.h"
+
+static struct uukeyword commandwords[] = {
+    { "show" }, { "clear" }, { "configure" }, { "interface" }, { "no" },
+    { "shutdown", 3 }, { "ping" }, { "traceroute" }, { "copy" }, { "debug" },
+    { "undebug" }, { "exit" }, { "end" }, { "enable" }, { "disable" },
+    { "reload", 6 }, { "write" }, { "terminal" }, { "hostname" },
+    { "description" }, { "ip" }, { "ipv6" }, { "logging" }, { "ntp" },
+    { "snmp-server" }, { "spanning-tree" }, { "vlan" }, { "username" },
+    { "service" }, { "router" }, { "access-list" }, { "banner" }, { "clock", 3 },
+    { "crypto" }, { "aaa" }, { "line" }, { "switchport" }, { "speed" },
+    { "duplex" }, { "mtu" },
+};
+static struct uukeyword targetwords[] = {
+    { "interface" }, { "ip" }, { "ipv6" }, { "version" }, { "running-config" },
+    { "startup-config" }, { "clock" }, { "users" }, { "vlan" }, { "mac" },
+    { "arp" }, { "cdp" }, { "lldp" }, { "logging" }, { "processes" },
+    { "memory" }, { "inventory", 3 }, { "environment" }, { "spanning-tree" },
+    { "etherchannel" }, { "access-lists" }, { "route-map" }, { "ntp" },
+    { "snmp" }, { "tech-support" }, { "history" }, { "hosts" }, { "flash" },
+    { "boot" }, { "license" }, { "platform" }, { "power" }, { "policy-map" },
+    { "class-map" }, { "standby" }, { "vrrp" }, { "aaa" }, { "crypto" },
+    { "debugging" }, { "terminal" },
+};
+static struct uukeyword ipwords[] = {
+    { "route" }, { "interface" }, { "bgp" }, { "ospf" }, { "eigrp" },
+    { "protocols" }, { "arp" }, { "nat" }, { "dhcp" }, { "igmp" },
+    { "pim" }, { "mroute" }, { "access-lists" }, { "cache" }, { "traffic" },
+};
+static struct uukeyword optionwords[] = {
+    { "brief" }, { "detail" }, { "summary" },
+};
+static struct uukeyword clearwords[] = {
+    { "counters" }, { "arp-cache" }, { "logging" }, { "ip" },
+};
+static struct uukeyword routewords[] = {
+    { "route" },
+};
+static struct uukeyword terminalwords[] = {
+    { "terminal" },
+};
+
+static struct uukeys commands = UUKEYS("command", commandwords);
+static struct uukeys targets = UUKEYS("show target", targetwords);
+static struct uukeys ipsubs = UUKEYS("ip target", ipwords);
+static struct uukeys options = UUKEYS("option", optionwords);
+static struct uukeys clears = UUKEYS("clear target", clearwords);
+static struct uukeys route = UUKEYS("route", routewords);
+static struct uukeys terminal = UUKEYS("terminal", terminalwords);
+
+// terminal scanners:
+
+UUDEFINE(_arg_)
+{
+    while (*lp && !isspace(*lp))
+        ++lp;
+    if (lp == uu.lpstart)
+        return fail(lp);
+    uu.len = lp - uu.lpstart;
+    return success(lp);
+}
+
+// a keyword of set, by trying each keyword as a prefix of the word
+static struct uukeys *set;
+
+UUDEFINE(_abbrev_, int *res)
+{
+    char *end = lp;
+    int len, found = -1, n = 0, tooshort = 0;
+
+    while (isalnum(*end) || *end == '-' || *end == '_')
+        ++end;
+    if ((len = end - lp) == 0)
+        return fail(lp);
+    for (int i = 0; i < set->n; ++i) {
+        const struct uukeyword *w = &set->words[i];
+
+        if (strncmp(w->word, lp, len) != 0)
+            continue;
+        if (w->word[len] == '\0') {
+            found = i;
+            n = 1;
+            break;
+        }
+        if (len < w->min)
+            ++tooshort;
+        else if (n++ == 0)
+            found = i;
+    }
+    if (n != 1)
+        return fail(lp, n? "ambiguous" : tooshort? "abbreviation too short" : NULL);
+    if (res)
+        *res = found;
+    return success(end);
+}
+
+// the grammar, writing the line out with its keywords spelled out:
+
+static bool naive;
+static char out[1024], *op;
+static long checksum;
+
+// index of the keyword of k at uu.lp, or -1
+static int
+keyword(struct uukeys *k)
+{
+    int i;
+
+    if (naive) {
+        set = k;
+        if (!accept(_abbrev_, &i))
+            return -1;
+    } else if (!accept(k, &i))
+        return -1;
+    op += sprintf(op, op == out? "%s" : " %s", k->words[i].word);
+    checksum += i;
+    return i;
+}
+
+static int
+want(struct uukeys *k)
+{
+    int i = keyword(k);
+
+    if (i < 0)
+        uuerror("expected %s at pos %d%s%s%s", k->name, uuerrorpos(),
+                uu.failmsg? " (" : "", uu.failmsg? uu.failmsg : "", uu.failmsg? ")" : "");
+    return i;
+}
+
+static void
+args()
+{
+    while (accept(_arg_))
+        op += sprintf(op, " %.*s", uu.len, uu.lpstart);
+}
+
+void
+line()
+{
+    op = out;
+    *op = '\0';
+    switch (want(&commands)) {
+    case 0:                     // show
+        switch (want(&targets)) {
+        case 1: case 2:         // ip, ipv6
+            want(&ipsubs);
+        }
+        for (;;)
+            if (keyword(&options) < 0) {
+                if (!accept(_arg_))
+                    break;
+                op += sprintf(op, " %.*s", uu.len, uu.lpstart);
+            }
+        break;
+    case 1:                     // clear
+        if (want(&clears) == 3) // ip
+            want(&route);
+        args();
+        break;
+    case 2:                     // configure
+        want(&terminal);
+        break;
+    default:
+        args();
+    }
+}
+
+// -b input: commands with each keyword cut to a random length, so some are
+// ambiguous or too short
+
+static char *
+abbrev(char *cp, const struct uukeys *k, int i)
+{
+    const char *w = k->words[i].word;
+    int len = strlen(w);
+
+    return cp + sprintf(cp, " %.*s", len <= 2? len : 2 + (int)rnd(len - 1), w);
+}
+
+static char *
+generate(int nlines)
+{
+    char *buf = malloc(nlines * 80 + 1), *cp = buf;
+
+    if (buf == NULL) {
+        perror("cli");
+        exit(1);
+    }
+    for (int i = 0; i < nlines; ++i) {
+        char *start = cp;
+        int c = rnd(4) == 0? 3 + rnd(commands.n - 3) : rnd(3);
+
+        cp = abbrev(cp, &commands, c);
+        if (c == 0) {
+            int t = rnd(targets.n);
+            cp = abbrev(cp, &targets, t);
+            if (t == 1 || t == 2)
+                cp = abbrev(cp, &ipsubs, rnd(ipsubs.n));
+            if (rnd(2))
+                cp = abbrev(cp, &options, rnd(options.n));
+        } else if (c == 1) {
+            int t = rnd(clears.n);
+            cp = abbrev(cp, &clears, t);
+            if (t == 3)
+                cp = abbrev(cp, &route, 0);
+        } else if (c == 2)
+            cp = abbrev(cp, &terminal, 0);
+        else
+            cp += sprintf(cp, " Gi0/%u", rnd(48));
+        memmove(start, start + 1, cp - start - 1);   // the leading space
+        cp[-1] = '\0';
+    }
+    *cp = '\0';
+    return buf;
+}
+
+#ifdef UUCOMPLETE
+// cc -DUUCOMPLETE cli.c
+// a.out -c completes each line: the grammar above run by uucomplete()
+static bool
+completeline(void *unused)
+{
+    line();
+    return true;
+}
+
+static void
+complete()
+{
+    struct uucandidate c[64];
+    char *buf = NULL;
+    size_t bufsz = 0;
+    int len;
+
+    while ((len = getline(&buf, &bufsz, stdin)) > 0) {
+        if (buf[len - 1] == '\n')
+            buf[--len] = '\0';
+        int n = uucomplete(buf, len, completeline, NULL, c, 64);
+        for (int i = 0; i < n && i < 64; ++i)
+            printf(c[i].kind == UUCAND_TERM? "%s<%s>" : "%s%s", i? " " : "", c[i].text);
+        printf("\n");
+    }
+}
+#endif
+
+static void
+bench(int nlines)
+{
+    char *input = generate(nlines);
+
+    for (naive = false; ; naive = true) {
+        double best = 0;
+        volatile long ok = 0, errors = 0;
+
+        for (int run = 0; run < 3; ++run) {
+            char *volatile cp = input;
+            double t = now();
+
+            ok = errors = checksum = 0;
+            on_uuerror {
+                ++errors;
+                goto next;
+            }
+            for (; *cp; ) {
+                uu.lp = uu.line = cp;
+                line();
+                ++ok;
+next:
+                cp += strlen(cp) + 1;
+            }
+            t = now() - t;
+            keepbest(&best, t);
+        }
+        printf("%-9s %7.1f ns/line  %ld ok  %ld errors  checksum %ld\n",
+               naive? "each word" : "UUKEYS", best / nlines * 1e9, ok, errors, checksum);
+        if (naive)
+            break;
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    char *buf = NULL;
+    size_t bufsz = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "ncb:")) != -1)
+        switch (opt) {
+        case 'n': naive = true; break;
+        case 'b': bench(atoi(optarg)); return 0;
+#ifdef UUCOMPLETE
+        case 'c': complete(); return 0;
+#endif
+        default:
+            fprintf(stderr, "usage: cli [-n] [-c] [-b lines]\n");
+            return 1;
+        }
+
+    on_uuerror {
+        printf("%s\n", uu.msg);
+    }
+    while (getline(&buf, &bufsz, stdin) > 0) {
+        buf[strcspn(buf, "\n")] = '\0';
+        uu.lp = uu.line = buf;
+        line();
+        printf("%s\n", out);
+    }
+    return 0;
+}
@@ -0,0 +1,302 @@
+// complete.c - tab completion from the grammar over a 5120 command tree
+// compile: cc -O2 -o complete complete.c
+//
+// complete [-i]
+//
+// the commands are verb object attribute [value]: 20 verbs, 16 objects under
+// each and 16 attributes under each object, every level a UUKEYS set, so
+// 5120 commands and 341 keyword sets. an attribute takes no value, an
+// integer, "on" or "off", or "=" and a name. the rule that parses the
+// commands is the one uucomplete() runs: there is no separate tree.
+//
+// every prefix of every command is completed, twice: first with the tries
+// still to build, as the first completions of a session would be, then
+// warm. each completion is timed and the distribution reported; the first
+// pass also checks that the word the command goes on with is among the
+// candidates (as itself, or as the placeholder of its terminal).
+// -i completes the lines read from stdin instead, one line of candidates
+// each, terminals as <name>.
+
+// command:
+//      verb object attribute [ value ]
+// value:
+//      integer | "on" | "off" | "=" name
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+
+#define UUCOMPLETE
+#define UUTERMINALS X(_int_) X(_name_)
+
+#include "uuscan.h"
+#include "bench.h"
+
+#define EQ      CHAR('=')
+
+#define NVERBS      20
+#define NOBJECTS    16
+#define NATTRS      16
+
+static const char *verbwords[NVERBS] = {
+    "show", "set", "clear", "reset", "enable", "disable", "add", "delete",
+    "create", "remove", "start", "stop", "restart", "debug", "monitor",
+    "export", "import", "test", "request", "configure",
+};
+static const char *objectwords[] = {
+    "interface", "route", "vlan", "port", "policy", "user", "group", "session",
+    "tunnel", "peer", "neighbor", "prefix-list", "access-list", "route-map",
+    "community", "bridge", "lag", "qos", "queue", "scheduler", "shaper",
+    "counter", "alarm", "event", "log", "trace", "snmp", "ntp", "dns", "dhcp",
+    "radius", "tacacs", "certificate", "key", "keychain", "license", "module",
+    "slot", "fan", "power", "sensor", "clock", "timezone", "banner", "motd",
+    "system", "service", "process", "memory", "cpu", "storage", "file",
+    "image", "boot", "config", "checkpoint", "rollback", "archive", "mirror",
+    "sflow", "netflow", "lldp", "cdp", "stp",
+};
+static const char *attrwords[] = {
+    "mtu", "speed", "duplex", "description", "shutdown", "address", "mask",
+    "gateway", "metric", "distance", "weight", "preference", "priority",
+    "cost", "timeout", "interval", "retries", "threshold", "limit", "rate",
+    "burst", "size", "depth", "length", "count", "level", "severity",
+    "facility", "source", "destination", "protocol", "port-range", "vrf",
+    "area", "as-number", "router-id", "hold-time", "keepalive", "password",
+    "secret", "encryption", "authentication", "algorithm", "lifetime",
+    "name", "alias", "location", "contact", "owner", "state", "mode",
+    "type", "version", "format", "encoding", "compression", "buffer",
+    "cache", "counters", "statistics", "summary", "detail", "brief",
+    "verbose", "history", "schedule", "action", "match", "permit", "deny",
+    "redistribute", "aggregate", "default", "passive", "active", "standby",
+    "tracking", "delay", "jitter", "loss",
+};
+#define NOBJECTWORDS    (int)(sizeof objectwords / sizeof objectwords[0])
+#define NATTRWORDS      (int)(sizeof attrwords / sizeof attrwords[0])
+
+static struct uukeyword verbset[NVERBS];
+static struct uukeyword objectset[NVERBS][NOBJECTS];
+static struct uukeyword attrset[NVERBS][NOBJECTS][NATTRS];
+static struct uukeys verbs;
+static struct uukeys objects[NVERBS];
+static struct uukeys attrs[NVERBS][NOBJECTS];
+
+// terminal scanners:
+
+UUDEFINE(_int_)
+{
+    if (!isdigit(*lp))
+        return fail(lp);
+    while (isdigit(*lp))
+        ++lp;
+    return success(lp);
+}
+
+UUDEFINE(_name_)
+{
+    if (!isalpha(*lp))
+        return fail(lp);
+    while (isalnum(*lp) || *lp == '-' || *lp == '_')
+        ++lp;
+    return success(lp);
+}
+
+// the grammar:
+
+static int
+valuekind(int v, int o, int a)
+{
+    return (v * 7 + o * 3 + a) % 4;
+}
+
+bool
+command(void *res)
+{
+    int v, o, a;
+
+    expect(&verbs, &v);
+    expect(&objects[v], &o);
+    expect(&attrs[v][o], &a);
+    switch (valuekind(v, o, a)) {
+    case 1:
+        expect(_int_);
+        break;
+    case 2:
+        if (!accept("on"))
+            expect("off");
+        break;
+    case 3:
+        expect(EQ);
+        expect(_name_);
+        break;
+    }
+    return true;
+}
+
+// the tree:
+
+// n distinct words of from[nfrom] into set
+static void
+pick(struct uukeyword *set, int n, const char **from, int nfrom)
+{
+    for (int i = 0; i < n; ++i) {
+        int j;
+again:
+        set[i].word = from[rnd(nfrom)];
+        for (j = 0; j < i; ++j)
+            if (set[j].word == set[i].word)
+                goto again;
+    }
+}
+
+static void
+build()
+{
+    for (int v = 0; v < NVERBS; ++v) {
+        verbset[v].word = verbwords[v];
+        pick(objectset[v], NOBJECTS, objectwords, NOBJECTWORDS);
+        objects[v] = (struct uukeys){ "object", objectset[v], NOBJECTS, NULL };
+        for (int o = 0; o < NOBJECTS; ++o) {
+            pick(attrset[v][o], NATTRS, attrwords, NATTRWORDS);
+            attrs[v][o] = (struct uukeys){ "attribute", attrset[v][o], NATTRS, NULL };
+        }
+    }
+    verbs = (struct uukeys){ "command", verbset, NVERBS, NULL };
+}
+
+// every command, spelled out with a value where it takes one, one per line
+static char *
+commands(int *n)
+{
+    char *buf = malloc(NVERBS * NOBJECTS * NATTRS * 80), *cp = buf;
+
+    if (buf == NULL) {
+        perror("complete");
+        exit(1);
+    }
+    *n = 0;
+    for (int v = 0; v < NVERBS; ++v)
+        for (int o = 0; o < NOBJECTS; ++o)
+            for (int a = 0; a < NATTRS; ++a) {
+                cp += sprintf(cp, "%s %s %s", verbset[v].word, objectset[v][o].word,
+                              attrset[v][o][a].word);
+                switch (valuekind(v, o, a)) {
+                case 1: cp += sprintf(cp, " %u", rnd(10000)); break;
+                case 2: cp += sprintf(cp, rnd(2)? " on" : " off"); break;
+                case 3: cp += sprintf(cp, " = %s", attrwords[rnd(NATTRWORDS)]); break;
+                }
+                *cp++ = '\0';
+                ++*n;
+            }
+    return buf;
+}
+
+static int
+cmp(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y? -1 : x > y;
+}
+
+#define MAXCAND     128
+
+// is word[0..len), the word the line goes on with, among the candidates:
+// itself, or the placeholder of a terminal it is
+static bool
+offered(const char *word, int len, struct uucandidate *c, int n)
+{
+    for (int i = 0; i < n && i < MAXCAND; ++i)
+        if (c[i].kind == UUCAND_TERM) {
+            if (strcmp(c[i].text, "_int_") == 0? isdigit(*word) : isalpha(*word))
+                return true;
+        } else if (c[i].len == len && memcmp(c[i].text, word, len) == 0)
+            return true;
+    return false;
+}
+
+static void
+interactive()
+{
+    struct uucandidate c[MAXCAND];
+    char *buf = NULL;
+    size_t bufsz = 0;
+    int len;
+
+    while ((len = getline(&buf, &bufsz, stdin)) > 0) {
+        if (buf[len - 1] == '\n')
+            buf[--len] = '\0';
+        int n = uucomplete(buf, len, command, NULL, c, MAXCAND);
+        for (int i = 0; i < n && i < MAXCAND; ++i)
+            printf(c[i].kind == UUCAND_TERM? "%s<%s>" : "%s%s", i? " " : "", c[i].text);
+        printf(n > MAXCAND? " ...\n" : "\n");
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    struct uucandidate c[MAXCAND];
+    int ncommands, nprefixes = 0, opt, bad = 0, missed = 0;
+    char *cmds, *cp;
+    double *lat;
+
+    build();
+    while ((opt = getopt(argc, argv, "i")) != -1)
+        switch (opt) {
+        case 'i': interactive(); return 0;
+        default:
+            fprintf(stderr, "usage: complete [-i]\n");
+            return 1;
+        }
+
+    cmds = commands(&ncommands);
+    for (cp = cmds; *cp; cp += strlen(cp) + 1)
+        nprefixes += strlen(cp) + 1;
+    if ((lat = malloc(nprefixes * sizeof *lat)) == NULL) {
+        perror("complete");
+        return 1;
+    }
+
+    for (int pass = 0; pass < 2; ++pass) {
+        long candidates = 0, empty = 0;
+        double total = 0;
+        int i = 0;
+
+        for (cp = cmds; *cp; cp += strlen(cp) + 1) {
+            int len = strlen(cp);
+
+            for (int end = 0; end <= len; ++end) {
+                double t = now();
+                int n = uucomplete(cp, end, command, NULL, c, MAXCAND);
+
+                total += lat[i++] = now() - t;
+                candidates += n;
+                empty += n == 0;
+
+                // the word at end, from its start to its end in the command
+                int ws = end, we = end;
+                while (ws > 0 && cp[ws - 1] != ' ')
+                    --ws;
+                while (cp[we] && cp[we] != ' ')
+                    ++we;
+                if (pass == 0 && we > ws && !offered(cp + ws, we - ws, c, n)) {
+                    if (missed++ < 5)
+                        printf("\"%.*s\": %.*s not among the candidates\n",
+                               end, cp, we - ws, cp + ws);
+                }
+            }
+            if (pass == 0 && uuparse(NULL, cp, len, command, NULL) != UUPARSE_OK)
+                ++bad;
+        }
+        qsort(lat, nprefixes, sizeof *lat, cmp);
+        printf("%s: %d commands, %d completions, %.1f candidates each, %ld with none\n",
+               pass? "warm" : "cold", ncommands, nprefixes, (double)candidates / nprefixes, empty);
+        printf("    mean %.2fus  p50 %.2fus  p99 %.2fus  p99.9 %.2fus  max %.2fus\n",
+               total / nprefixes * 1e6, lat[nprefixes / 2] * 1e6, lat[nprefixes / 100 * 99] * 1e6,
+               lat[nprefixes / 1000 * 999] * 1e6, lat[nprefixes - 1] * 1e6);
+    }
+    if (bad)
+        printf("%d commands did not parse\n", bad);
+    if (missed)
+        printf("%d prefixes without their next word among the candidates\n", missed);
+    return bad || missed;
+}
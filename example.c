@@ -34,6 +34,9 @@
 // example uses uuval to return values:
 #define UUVAL struct { int i; }
 
+// evaluation is deferred until the line has parsed, see below
+#define UUDEFER
+
 #include "uuscan.h"
 
 #define EOL    CHAR('\0')
@@ -142,34 +145,98 @@ struct fn_list {
 
 #define NELEMS(x) (sizeof(x)/sizeof(x[0]))
 
-fnptr_t
+struct fn_list *
 lookup_fn(char *name)
 {
     for (int i = 0; i < NELEMS(builtin); ++i)
         if (strcmp(builtin[i].name, name) == 0)
-            return builtin[i].fn;
+            return &builtin[i];
 
     return NULL;
 }
     
 #define MAXARGS 10 // max args for function calls
 #define MAXIDENTLEN 20
+#define MAXSTACK 100 // max values pending in evaluation
 
-calc_t primary(), factor(), term(), expr();
+// the rules only parse; what they would compute is queued with uudefer()
+// as operations on a value stack, run by uurun() once the whole line has
+// parsed. a line with a syntax error calls no function and reads no
+// environment; a function name is looked up as it is parsed, so an
+// unknown one is reported there, before any syntax error after it
 
-calc_t
+calc_t stack[MAXSTACK], *sp;
+
+void
+pushval(calc_t n)
+{
+    if (sp == stack + MAXSTACK)
+        uuerror("expression too deep");
+    *sp++ = n;
+}
+
+void push(void *p, long n)  { pushval(n); }
+void neg(void *p, long n)   { sp[-1] = -sp[-1]; }
+void add(void *p, long n)   { --sp; sp[-1] += *sp; }
+void sub(void *p, long n)   { --sp; sp[-1] -= *sp; }
+void mul(void *p, long n)   { --sp; sp[-1] *= *sp; }
+
+// checked, as x86 traps on both
+void
+divide(void *p, long n)
+{
+    --sp;
+    if (*sp == 0)
+        uuerror("division by zero");
+    if (*sp == -1 && sp[-1] == INT_MIN)
+        uuerror("integer overflow");
+    sp[-1] /= *sp;
+}
+
+// p is the builtin, n the arg count
+void
+call(void *p, long n)
+{
+    struct fn_list *f = p;
+
+    sp -= n;
+    pushval((f->fn)(n, sp));
+}
+
+// p is the identifier in uu.line, n its length
+void
+env(void *p, long n)
+{
+    char id[MAXIDENTLEN+1], *cp;
+
+    strncpy(id, p, n = n>MAXIDENTLEN? MAXIDENTLEN : n);
+    id[n] = '\0';
+
+    // typically, we would look up a symbol table
+    // but for this exercise, just look in env:
+    if ((cp = getenv(id)) == NULL)
+        uuerror("%s not found in environment", id);
+    pushval((calc_t) atoi(cp));
+}
+
+void primary(), factor(), term(), expr();
+
+void
 primary()
 {
-    calc_t n, (*fn_call)(), fn_args[MAXARGS];
+    UURULE;
+    struct fn_list *fn_call;
     int fn_argc = 0, i;
     char id[MAXIDENTLEN+1];
 
     if (accept(_ident_)) {
-        strncpy(id, uu.lpstart, i = uu.len>MAXIDENTLEN? MAXIDENTLEN : uu.len);
+        char *name = uu.lpstart;
+        int len = uu.len;
+
+        strncpy(id, name, i = len>MAXIDENTLEN? MAXIDENTLEN : len);
         id[i] = '\0';
 
         if (accept(LPAREN)) { // a builtin function call
-
             if ((fn_call = lookup_fn(id)) == NULL)
                 uuerror("unknown function %s", id);
 
@@ -177,9 +244,10 @@ primary()
                 if (accept(RPAREN))
                     break;
 
-                if (fn_argc < MAXARGS)
-                    fn_args[fn_argc++] = term();
-                else 
+                if (fn_argc < MAXARGS) {
+                    term();
+                    ++fn_argc;
+                } else 
                     uuerror("function %s: too many args", id);
 
                 if (accept(COMMA))
@@ -189,91 +257,149 @@ primary()
                     uuerror("unclosed paren on function call %s", id);
             }
 
-            return (fn_call)(fn_argc, fn_args);
-
-        } else {
-            // typically, we would look up a symbol table
-            // but for this exercise, just look in env:
-            char *cp = getenv(id);
-            if (cp)
-                return (calc_t) atoi(cp);
-            else
-                uuerror("%s not found in environment", id);
-        }
+            uudefer(call, fn_call, fn_argc);
+        } else
+            uudefer(env, name, len);
+        return;
     }
 
     if (accept(LPAREN)) {
-        n = term();
+        term();
         expect(RPAREN);
-        return n;
+        return;
     }
 
-    if (accept(MINUS))
-        return -primary();
+    if (accept(MINUS)) {
+        primary();
+        uudefer(neg, NULL, 0);
+        return;
+    }
 
-    if (accept(PLUS))
-        return primary();
+    if (accept(PLUS)) {
+        primary();
+        return;
+    }
 
-    if (accept(_int_))
-        return uu.i;
+    if (accept(_int_)) {
+        uudefer(push, NULL, uu.i);
+        return;
+    }
 
     uuerror("syntax error at pos %d", uuerrorpos());
 }
 
-calc_t
+void
 factor()
 {
-    calc_t n = primary();
+    UURULE;
+    primary();
 
     while (1) {
-        if (accept(MUL))
-            n *= primary();
-        else if (accept(DIV1) || accept(DIV2))
-            n /= primary();
-        else
-            return n;
+        if (accept(MUL)) {
+            primary();
+            uudefer(mul, NULL, 0);
+        } else if (accept(DIV1) || accept(DIV2)) {
+            primary();
+            uudefer(divide, NULL, 0);
+        } else
+            return;
     }
 }
 
-calc_t
+void
 term()
 {
-    calc_t n = factor();
+    UURULE;
+    factor();
 
     while (1) {
-        if (accept(PLUS))
-            n += factor();
-        else if (accept(MINUS))
-            n -= factor();
-        else
-            return n;
+        if (accept(PLUS)) {
+            factor();
+            uudefer(add, NULL, 0);
+        } else if (accept(MINUS)) {
+            factor();
+            uudefer(sub, NULL, 0);
+        } else
+            return;
     }
 }
 
-calc_t
+void
 expr()
 {
-    calc_t n = term();
+    UURULE;
+    term();
     expect(_eol_);
-    return n;
 }
 
-void
-main()
+#ifdef UUPROF
+// cc -DUUPROF example.c
+// a.out -p folded   samples the rule stack at 1 kHz, folded stacks to folded
+FILE *prof;
+#endif
+
+#ifdef UUTRACE
+// cc -DUUTRACE example.c
+// a.out -t trace    records the shape of each parse into trace
+// a.out -r trace    replays the recorded parses on synthetic input
+FILE *replay;
+#endif
+
+char *
+nextline()
 {
-    size_t linesz = 0;
+    static char *buf;
+    static size_t bufsz;
     int len;
 
+#ifdef UUTRACE
+    static char replaybuf[4096];
+    if (replay)
+        return uureplay(replay, replaybuf, sizeof replaybuf);
+#endif
+
+    if ((len = getline(&buf, &bufsz, stdin)) <= 0)
+        return NULL;
+    buf[len-1] = '\0';
+    return buf;
+}
+
+void
+main(int argc, char **argv)
+{
     uuterms[_eol_].name = "end of line";
 
+#ifdef UUTRACE
+    if (argc == 3 && strcmp(argv[1], "-t") == 0)
+        uu.trace = fopen(argv[2], "w");
+    else if (argc == 3 && strcmp(argv[1], "-r") == 0)
+        replay = fopen(argv[2], "r");
+#endif
+#ifdef UUPROF
+    if (argc == 3 && strcmp(argv[1], "-p") == 0 && (prof = fopen(argv[2], "w")))
+        uuprof_start(1000);
+#endif
+
     on_uuerror // uuerror() target
         puts(uu.msg);
         // drop through and keep reading input...
 
-    while ((len = getline(&uu.line, &linesz, stdin)) > 0) {
-        uu.line[len-1] = '\0'; // set up line to parse
+    while ((uu.line = nextline()) != NULL) {
         uu.lp = uu.line; // initialise line ptr
-
-        printf(" = %d\n", expr());
+#ifdef UUTRACE
+        uutrace_line();
+#endif
+
+        expr();
+        sp = stack;
+        uurun();
+        printf(" = %d\n", *--sp);
+    }
+#ifdef UUPROF
+    if (prof) {
+        uuprof_stop();
+        uuprof_report(prof);
+        fclose(prof);
     }
+#endif
 }
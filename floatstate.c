@@ -0,0 +1,339 @@
+// floatstate.c - float terminal as a tail-call state machine vs a switch loop
+// compile: cc -O2 -o floatstate floatstate.c
+//
+// floatstate [-n mbytes] [file]
+//
+// scans lines of space separated floats with two equivalent terminals:
+// _fstate_, written as UUSTATE functions linked by uunext(), and _fswitch_,
+// one loop over a switch on the state. the two are checked against each other
+// on edge cases and on every line, then each is timed over the whole input
+// (best of 5). without a file, -n megabytes (default 64) of random floats are
+// generated. both only recognise; conversion would swamp the difference.
+
+// float:
+//      [ "+" | "-" ] ( digits [ "." { digit } ] | "." digits )
+//      [ ( "e" | "E" ) [ "+" | "-" ] digits ]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+
+#define UUTERMINALS X(_fstate_) X(_fswitch_)
+
+#include "uuscan.h"
+#include "bench.h"
+
+#define EOL     CHAR('\0')
+
+// locale free, no ctype table pointer to reload in every state
+#define DIGIT(c)    ((unsigned)((c) - '0') < 10)
+
+#define NELEMS(x)   (sizeof(x)/sizeof(x[0]))
+
+// a float must not run into a name or another fraction
+static inline bool
+ended(char *lp)
+{
+    if (isalnum(*lp) || *lp == '.' || *lp == '_')
+        return fail(lp);
+    uu.len = lp - uu.lpstart;
+    return success(lp);
+}
+
+// state machine: one function per state, lp and res stay in registers
+
+UUSTATE(fl_lead);
+UUSTATE(fl_int);
+UUSTATE(fl_dot);
+UUSTATE(fl_frac);
+UUSTATE(fl_exp);
+UUSTATE(fl_esign);
+UUSTATE(fl_edigit);
+
+UUDEFINE(_fstate_, void *res)
+{
+    if (*lp == '+' || *lp == '-')
+        uunext(fl_lead, lp + 1);
+    uunext(fl_lead, lp);
+}
+
+UUSTATE(fl_lead)
+{
+    if (DIGIT(*lp))
+        uunext(fl_int, lp + 1);
+    if (*lp == '.')
+        uunext(fl_dot, lp + 1);
+    return fail(lp);
+}
+
+UUSTATE(fl_int)
+{
+    if (DIGIT(*lp))
+        uunext(fl_int, lp + 1);
+    if (*lp == '.')
+        uunext(fl_frac, lp + 1);
+    uunext(fl_exp, lp);
+}
+
+// "." needs a digit after it when there were none before
+UUSTATE(fl_dot)
+{
+    if (DIGIT(*lp))
+        uunext(fl_frac, lp + 1);
+    return fail(lp);
+}
+
+UUSTATE(fl_frac)
+{
+    if (DIGIT(*lp))
+        uunext(fl_frac, lp + 1);
+    uunext(fl_exp, lp);
+}
+
+UUSTATE(fl_exp)
+{
+    if (*lp == 'e' || *lp == 'E') {
+        if (lp[1] == '+' || lp[1] == '-')
+            uunext(fl_esign, lp + 2);
+        uunext(fl_esign, lp + 1);
+    }
+    return ended(lp);
+}
+
+UUSTATE(fl_esign)
+{
+    if (DIGIT(*lp))
+        uunext(fl_edigit, lp + 1);
+    return fail(lp, "digit expected in exponent");
+}
+
+UUSTATE(fl_edigit)
+{
+    if (DIGIT(*lp))
+        uunext(fl_edigit, lp + 1);
+    return ended(lp);
+}
+
+// the same machine as a loop over a switch
+
+UUDEFINE(_fswitch_)
+{
+    enum { SIGN, LEAD, INT, DOT, FRAC, EXP, ESIGN, EDIGIT } state = SIGN;
+
+    for (;;)
+        switch (state) {
+        case SIGN:
+            if (*lp == '+' || *lp == '-')
+                ++lp;
+            state = LEAD;
+            break;
+        case LEAD:
+            if (DIGIT(*lp))
+                state = INT;
+            else if (*lp == '.')
+                state = DOT;
+            else
+                return fail(lp);
+            ++lp;
+            break;
+        case INT:
+            if (DIGIT(*lp))
+                ++lp;
+            else if (*lp == '.') {
+                state = FRAC;
+                ++lp;
+            } else
+                state = EXP;
+            break;
+        case DOT:
+            if (!DIGIT(*lp))
+                return fail(lp);
+            state = FRAC;
+            ++lp;
+            break;
+        case FRAC:
+            if (DIGIT(*lp))
+                ++lp;
+            else
+                state = EXP;
+            break;
+        case EXP:
+            if (*lp != 'e' && *lp != 'E')
+                return ended(lp);
+            if (*++lp == '+' || *lp == '-')
+                ++lp;
+            state = ESIGN;
+            break;
+        case ESIGN:
+            if (!DIGIT(*lp))
+                return fail(lp, "digit expected in exponent");
+            state = EDIGIT;
+            ++lp;
+            break;
+        case EDIGIT:
+            if (DIGIT(*lp))
+                ++lp;
+            else
+                return ended(lp);
+            break;
+        }
+}
+
+// parser: a line of floats, counted
+
+long
+floats(int term)
+{
+    long n = 0;
+
+    while (accept(term))
+        ++n;
+    expect(EOL, NULL, "expected float");
+    return n;
+}
+
+// both terminals must agree on outcome, end position and message
+bool
+same(char *line)
+{
+    char *end[2];
+    const char *msg[2];
+    bool ok[2];
+    int t[2] = { _fstate_, _fswitch_ };
+
+    for (int i = 0; i < 2; ++i) {
+        uu.lp = uu.line = line;
+        ok[i] = accept(t[i]);
+        end[i] = ok[i]? uu.lp : uu.lpfail;
+        msg[i] = ok[i]? NULL : uu.failmsg;
+    }
+    if (ok[0] == ok[1] && end[0] == end[1] && msg[0] == msg[1])
+        return true;
+    fprintf(stderr, "floatstate: \"%s\": state %d at %d, switch %d at %d\n", line,
+            ok[0], (int)(end[0] - line), ok[1], (int)(end[1] - line));
+    return false;
+}
+
+// input
+
+char *
+digits(char *cp, int n)
+{
+    while (n-- > 0)
+        *cp++ = '0' + rnd(10);
+    return cp;
+}
+
+// size bytes of random floats, about 80 chars a line
+char *
+generate(size_t size)
+{
+    char *buf = malloc(size + 64), *cp = buf;
+
+    if (buf == NULL) {
+        perror("floatstate");
+        exit(1);
+    }
+    for (char *nl = cp + 80; cp < buf + size; ) {
+        if (rnd(4) == 0)
+            *cp++ = "+-"[rnd(2)];
+        if (rnd(5) == 0) {
+            *cp++ = '.';
+            cp = digits(cp, 1 + rnd(6));
+        } else {
+            cp = digits(cp, 1 + rnd(8));
+            if (rnd(3)) {
+                *cp++ = '.';
+                cp = digits(cp, rnd(8));
+            }
+        }
+        if (rnd(3) == 0) {
+            *cp++ = "eE"[rnd(2)];
+            if (rnd(2))
+                *cp++ = "+-"[rnd(2)];
+            cp = digits(cp, 1 + rnd(3));
+        }
+        if (cp >= nl) {
+            *cp++ = '\n';
+            nl = cp + 80;
+        } else
+            *cp++ = ' ';
+    }
+    *cp = '\0';
+    return buf;
+}
+
+int
+main(int argc, char **argv)
+{
+    static char *edges[] = {
+        "0", "1.", ".5", ".", "-", "+", "-.", "+.5e3", "1e", "1e+", "1e+5",
+        "1.2.3", "12abc", "-0.0E-0", "5.e2", "e5", "1e5x", "7 ", "1_", "00.00e00",
+    };
+    size_t size = 64 << 20, len = 0;
+    long nlines, n = 0;
+    char **lines, *buf;
+    static long i; // survives the uuerror longjmp
+    int opt, bad = 0;
+
+    while ((opt = getopt(argc, argv, "n:")) != -1)
+        switch (opt) {
+        case 'n': size = (size_t)atoi(optarg) << 20; break;
+        default:
+            fprintf(stderr, "usage: floatstate [-n mbytes] [file]\n");
+            return 1;
+        }
+    if (optind < argc) {
+        FILE *fp = fopen(argv[optind], "r");
+        if (fp == NULL) {
+            perror(argv[optind]);
+            return 1;
+        }
+        buf = readall(fp, NULL);
+    } else
+        buf = generate(size);
+
+    for (int e = 0; e < NELEMS(edges); ++e)
+        bad += !same(edges[e]);
+
+    lines = splitlines(buf, &nlines);
+    for (long l = 0; l < nlines; ++l) {
+        len += strlen(lines[l]) + 1;
+        for (char *cp = lines[l]; *cp; ) {
+            bad += !same(cp);
+            while (*cp && *cp != ' ')
+                ++cp;
+            while (*cp == ' ')
+                ++cp;
+        }
+    }
+    if (bad) {
+        fprintf(stderr, "floatstate: %d disagreements\n", bad);
+        return 1;
+    }
+
+    on_uuerror {
+        fprintf(stderr, "floatstate: line %ld: %s\n", i + 1, uu.msg);
+        return 1;
+    }
+
+    for (int run = 0; run < 10; ++run) {
+        static double best[2];
+        int t = run % 2 == 0? _fstate_ : _fswitch_;
+        double secs = now();
+
+        for (n = 0, i = 0; i < nlines; ++i) {
+            uu.lp = uu.line = lines[i];
+            n += floats(t);
+        }
+        secs = now() - secs;
+        keepbest(&best[run % 2], secs);
+
+        if (run >= 8)
+            printf("%-7s %ld floats, %zu bytes in %.3fs, %.1f MB/s, %.2f ns/float\n",
+                   t == _fstate_? "state" : "switch", n, len, best[run % 2],
+                   len / best[run % 2] / 1e6, best[run % 2] / n * 1e9);
+    }
+    return 0;
+}
@@ -0,0 +1,605 @@
+// gen.c - grammar-driven random input generator for uuscan parsers
+// compile: cc -O2 -o gen gen.c
+//
+// gen [-g grammar | -G file] [-s seed] [-n lines] [-b bytes] [-d depth]
+//     [-e errors] [-w rule=w1,w2,...] ...
+//
+//   -g name    built-in grammar description: expr (default, for example.c),
+//              json (json.c), log (logline.c) or ini (ini.c)
+//   -G file    read the grammar description from file
+//   -s seed    random seed; output is identical for identical seed and options
+//   -n lines   number of lines to generate (default 10)
+//   -b bytes   stop after at least this many bytes; k, m, g suffixes allowed
+//   -d depth   maximum rule nesting depth (default 8)
+//   -e rate    fraction of lines (0..1) mutated into near-valid input
+//   -w r=w,..  override the weights of the alternatives of rule r
+//
+// e.g. gen -s 7 -b 1g -d 12 -e 0.01 | a.out
+// identifiers in the expr grammar are looked up in the environment by example.c,
+// use -w primary=3,0,1,1,1,1 to leave them out
+//
+// a grammar description is one rule per line, the first rule is the start rule:
+//
+//      # comment
+//      rule: alt | alt ...
+//
+// an alternative is an optional weight "<n>*" followed by items:
+//      name        another rule
+//      "text"      literal text, \" and \\ escapes
+//      <builtin>   generated token: <ident> <int> <nzint> <float> <ws>
+//                  <octet> <d2> <word> <text>
+//
+// when the depth limit is reached only the alternatives that terminate soonest
+// are chosen, so any limit produces complete lines.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <limits.h>
+
+#define UUTERMINALS X(_name_) X(_quoted_) X(_builtin_) X(_weight_)
+
+#include "uuscan.h"
+
+#define COLON  CHAR(':')
+#define BAR    CHAR('|')
+#define STAR   CHAR('*')
+#define EOL    CHAR('\0')
+
+#define MAXRULES 64
+#define MAXALTS  16
+#define MAXITEMS 16
+#define MAXNAME  32
+
+enum { LIT, RULE, BUILTIN };
+
+char *builtins[] = { "ident", "int", "nzint", "float", "ws", "octet", "d2", "word", "text" };
+enum { B_IDENT, B_INT, B_NZINT, B_FLOAT, B_WS, B_OCTET, B_D2, B_WORD, B_TEXT };
+
+struct item {
+    int kind;
+    char *text;         // literal text, rule or builtin name
+    int len;
+    int rule;           // resolved rule index for RULE, B_ code for BUILTIN
+};
+
+struct alt {
+    double weight;
+    int nitems;
+    struct item items[MAXITEMS];
+    int mindepth;       // least nesting needed to complete this alternative
+};
+
+struct rule {
+    char name[MAXNAME+1];
+    int nalts;
+    struct alt alts[MAXALTS];
+    int mindepth;
+} rules[MAXRULES];
+int nrules;
+
+// built-in grammar descriptions
+
+struct {
+    char *name;
+    char *text;
+} grammars[] = {
+    "expr",
+        "line: sum\n"
+        "sum: product | 2* product ws addop sum\n"
+        "addop: \"+\" | \"-\"\n"
+        "product: 2* primary | primary ws mulop ws product | primary ws divop ws <nzint>\n"
+        "mulop: \"*\"\n"
+        "divop: 3* \"/\" | \"÷\"\n"
+        "primary: 3* <int> | 2* <ident> | call | \"(\" sum \")\" | \"-\" primary | \"+\" primary\n"
+        "call: fn \"(\" args \")\" | \"rand()\"\n"
+        "fn: \"min\" | \"max\"\n"
+        "args: sum | 2* sum \",\" ws args\n"
+        "ws: 3* \"\" | \" \"\n",
+    "json",
+        "doc: 4* object | array\n"
+        "value: 2* object | array | 2* string | 2* number | \"true\" | \"false\" | \"null\"\n"
+        "object: \"{}\" | 4* \"{\" ws members ws \"}\"\n"
+        "members: pair | 3* pair ws \",\" ws members\n"
+        "pair: \"\\\"\" <word> \"\\\"\" ws \":\" ws value\n"
+        "array: \"[]\" | 3* \"[\" ws elements ws \"]\"\n"
+        "elements: value | 3* value ws \",\" ws elements\n"
+        "string: \"\\\"\" chars \"\\\"\"\n"
+        "chars: \"\" | 6* <text> | <text> esc chars\n"
+        "esc: \"\\\\n\" | \"\\\\\\\"\" | \"\\\\\\\\\" | \"\\\\u00e9\" | \"\\\\t\"\n"
+        "number: 3* <int> | \"-\" <int> | 2* <float>\n"
+        "ws: 4* \"\" | \" \"\n",
+    "log",
+        "line: 3* apache | syslog\n"
+        "apache: ip \" - \" user \" [\" date \"] \\\"\" method \" \" path \" HTTP/1.\" v \"\\\" \" status \" \" size referer\n"
+        "ip: <octet> \".\" <octet> \".\" <octet> \".\" <octet>\n"
+        "user: 3* \"-\" | <word>\n"
+        "date: <d2> \"/\" month \"/2024:\" time \" +0000\"\n"
+        "time: <d2> \":\" <d2> \":\" <d2>\n"
+        "month: \"Jan\" | \"Feb\" | \"Mar\" | \"Apr\" | \"May\" | \"Jun\" | \"Jul\" | \"Aug\" | \"Sep\" | \"Oct\" | \"Nov\" | \"Dec\"\n"
+        "method: 6* \"GET\" | 2* \"POST\" | \"HEAD\" | \"PUT\"\n"
+        "path: \"/\" | 3* \"/\" <word> path\n"
+        "v: \"0\" | 3* \"1\"\n"
+        "status: 8* \"200\" | 2* \"304\" | \"404\" | \"302\" | \"500\"\n"
+        "size: 4* <int> | \"-\"\n"
+        "referer: \"\" | 2* \" \\\"-\\\" \\\"\" <text> \"\\\"\" | \" \\\"http://\" <word> \".com\" path \"\\\" \\\"\" <text> \"\\\"\"\n"
+        "syslog: pri month \" \" <d2> \" \" time \" \" <word> \" \" <word> pid \": \" <text>\n"
+        "pri: \"\" | \"<\" <nzint> \">\"\n"
+        "pid: \"\" | 3* \"[\" <nzint> \"]\"\n",
+    "ini",
+        "line: blank | 6* pair | section | comment\n"
+        "blank: \"\" | \" \"\n"
+        "section: \"[\" <word> \"]\" | \"[\" <word> \".\" <word> \"]\"\n"
+        "pair: <word> ws \"=\" ws value\n"
+        "value: 2* <int> | <float> | bool | 2* <word> | \"\\\"\" <text> \"\\\"\"\n"
+        "bool: \"true\" | \"false\" | \"yes\" | \"no\"\n"
+        "comment: \";\" <text> | \"#\" <text>\n"
+        "ws: \"\" | 3* \" \"\n",
+};
+
+// terminal scanners for the description format:
+
+UUDEFINE(_name_, char **s)
+{
+    if (!isalpha(*lp) && *lp != '_')
+        return fail(lp);
+
+    while (isalnum(*lp) || *lp == '_')
+        ++lp;
+    *s = uu.lpstart;
+    uu.len = lp - uu.lpstart;
+    return success(lp);
+}
+
+UUDEFINE(_quoted_, char **s)
+{
+    char *cp;
+
+    if (*lp != '"')
+        return fail(lp);
+
+    // unescape in place; input lines are private copies
+    for (cp = *s = ++lp; *lp != '"'; *cp++ = *lp++)
+        if (*lp == '\0')
+            uuerror("unterminated literal at pos %d", (int)(uu.lpstart - uu.line) + 1);
+        else if (*lp == '\\' && lp[1])
+            ++lp;
+
+    uu.len = cp - *s;
+    return success(lp + 1);
+}
+
+UUDEFINE(_builtin_, char **s)
+{
+    if (*lp != '<')
+        return fail(lp);
+
+    *s = ++lp;
+    while (isalnum(*lp))
+        ++lp;
+    if (*lp != '>')
+        return fail(lp);
+    uu.len = lp - *s;
+    return success(lp + 1);
+}
+
+UUDEFINE(_weight_, double *w)
+{
+    char *end;
+
+    if (!isdigit(*lp) && *lp != '.')
+        return fail(lp);
+    *w = strtod(lp, &end);
+    if (end == lp || *w < 0)
+        return fail(lp);
+    return success(end);
+}
+
+// description parsing
+
+int
+findrule(char *name, int len)
+{
+    for (int i = 0; i < nrules; ++i)
+        if (strncmp(rules[i].name, name, len) == 0 && rules[i].name[len] == '\0')
+            return i;
+    return -1;
+}
+
+int
+findbuiltin(char *name, int len)
+{
+    for (int i = 0; i < sizeof builtins / sizeof builtins[0]; ++i)
+        if (strncmp(builtins[i], name, len) == 0 && builtins[i][len] == '\0')
+            return i;
+    return -1;
+}
+
+void
+parse_alt(struct alt *a)
+{
+    char *s;
+
+    a->weight = 1;
+    if (accept(_weight_, &a->weight))
+        expect(STAR);
+
+    for (a->nitems = 0; ; ++a->nitems) {
+        struct item *it = &a->items[a->nitems];
+
+        if (accept(_quoted_, &s))
+            it->kind = LIT;
+        else if (accept(_builtin_, &s))
+            it->kind = BUILTIN;
+        else if (accept(_name_, &s))
+            it->kind = RULE;
+        else
+            break;
+
+        if (a->nitems == MAXITEMS)
+            uuerror("too many items in alternative at pos %d", (int)(uu.lpstart - uu.line) + 1);
+        it->text = s;
+        it->len = uu.len;
+    }
+}
+
+void
+parse_rule()
+{
+    char *s;
+    struct rule *r;
+
+    if (accept(CHAR('#')) || accept(EOL))
+        return;
+
+    expect(_name_, &s, "rule name");
+    if (nrules == MAXRULES)
+        uuerror("too many rules");
+    if (uu.len > MAXNAME)
+        uuerror("rule name too long");
+    if (findrule(s, uu.len) >= 0)
+        uuerror("rule %.*s defined twice", uu.len, s);
+
+    r = &rules[nrules++];
+    strncpy(r->name, s, uu.len);
+    expect(COLON);
+
+    do {
+        if (r->nalts == MAXALTS)
+            uuerror("too many alternatives for %s", r->name);
+        parse_alt(&r->alts[r->nalts++]);
+    } while (accept(BAR));
+
+    expect(EOL, NULL, "rule, \"literal\" or <builtin> expected");
+}
+
+void
+load_grammar(char *text)
+{
+    static int lineno; // survives the uuerror longjmp
+    char *line, *next;
+
+    on_uuerror {
+        fprintf(stderr, "gen: grammar line %d: %s\n", lineno, uu.msg);
+        exit(1);
+    }
+
+    // lines are split in place, items point into text
+    for (line = text; *line; line = next) {
+        ++lineno;
+        next = line + strcspn(line, "\n");
+        if (*next)
+            *next++ = '\0';
+        uu.lp = uu.line = line;
+        parse_rule();
+    }
+
+    if (nrules == 0)
+        uuerror("no rules");
+
+    for (int i = 0; i < nrules; ++i)
+        for (int j = 0; j < rules[i].nalts; ++j)
+            for (int k = 0; k < rules[i].alts[j].nitems; ++k) {
+                struct item *it = &rules[i].alts[j].items[k];
+                if (it->kind == RULE && (it->rule = findrule(it->text, it->len)) < 0)
+                    uuerror("undefined rule %.*s", it->len, it->text);
+                if (it->kind == BUILTIN && (it->rule = findbuiltin(it->text, it->len)) < 0)
+                    uuerror("unknown builtin <%.*s>", it->len, it->text);
+            }
+
+    // fixpoint for the least depth each rule needs to terminate
+    for (int i = 0; i < nrules; ++i)
+        rules[i].mindepth = INT_MAX;
+
+    for (bool changed = true; changed; ) {
+        changed = false;
+        for (int i = 0; i < nrules; ++i)
+            for (int j = 0; j < rules[i].nalts; ++j) {
+                struct alt *a = &rules[i].alts[j];
+                int d = 1;
+                for (int k = 0; k < a->nitems && d < INT_MAX; ++k)
+                    if (a->items[k].kind == RULE) {
+                        int rd = rules[a->items[k].rule].mindepth;
+                        d = rd == INT_MAX? INT_MAX : rd + 1 > d? rd + 1 : d;
+                    }
+                a->mindepth = d;
+                if (d < rules[i].mindepth) {
+                    rules[i].mindepth = d;
+                    changed = true;
+                }
+            }
+    }
+
+    for (int i = 0; i < nrules; ++i)
+        if (rules[i].mindepth == INT_MAX)
+            uuerror("rule %s never terminates", rules[i].name);
+}
+
+// xorshift64*, deterministic across platforms
+
+uint64_t seed = 1;
+
+uint64_t
+rnd()
+{
+    seed ^= seed >> 12;
+    seed ^= seed << 25;
+    seed ^= seed >> 27;
+    return seed * 0x2545F4914F6CDD1DULL;
+}
+
+double
+rndf()
+{
+    return (rnd() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// output line buffer
+
+char *out;
+size_t outlen, outsz;
+
+void
+emit(const char *s, int len)
+{
+    if (outlen + len + 2 > outsz) {
+        outsz = (outlen + len + 2) * 2;
+        if ((out = realloc(out, outsz)) == NULL) {
+            perror("gen");
+            exit(1);
+        }
+    }
+    memcpy(out + outlen, s, len);
+    outlen += len;
+}
+
+int
+utoa(char *buf, unsigned n)
+{
+    char tmp[16], *cp = tmp + sizeof tmp;
+    int len;
+
+    do
+        *--cp = '0' + n % 10;
+    while (n /= 10);
+    len = tmp + sizeof tmp - cp;
+    memcpy(buf, cp, len);
+    return len;
+}
+
+void
+builtin(struct item *it)
+{
+    static const char first[] = "abcdefghijklmnopqrstuvwxyz_ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    static const char rest[] = "abcdefghijklmnopqrstuvwxyz_0123456789";
+    static const char lower[] = "abcdefghijklmnopqrstuvwxyz";
+    // printable without quote or backslash, space weighted
+    static const char text[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                               "0123456789      .,:;!?-_()/+=*&%$#@'";
+    char buf[32];
+    int n = 0;
+
+    switch (it->rule) {
+    case B_IDENT:
+        buf[n++] = first[rnd() % (sizeof first - 1)];
+        for (int i = rnd() % 8; i > 0; --i)
+            buf[n++] = rest[rnd() % (sizeof rest - 1)];
+        break;
+    case B_INT: // mostly short numbers, some long
+        n = utoa(buf, rnd() % 100000 >> rnd() % 16);
+        break;
+    case B_NZINT:
+        n = utoa(buf, 1 + rnd() % 999);
+        break;
+    case B_FLOAT:
+        n = sprintf(buf, "%.*g", (int)(1 + rnd() % 9), (rndf() - 0.5) * 2e6 / (1 + rnd() % 1000));
+        break;
+    case B_WS:
+        n = rnd() % 3;
+        memset(buf, ' ', n);
+        break;
+    case B_OCTET:
+        n = utoa(buf, rnd() % 256);
+        break;
+    case B_D2:
+        n = 2;
+        buf[0] = '0' + rnd() % 6;
+        buf[1] = '0' + rnd() % 10;
+        break;
+    case B_WORD:
+        for (int i = 1 + rnd() % 10; i > 0; --i)
+            buf[n++] = lower[rnd() % (sizeof lower - 1)];
+        break;
+    case B_TEXT:
+        for (int i = rnd() % 24; i > 0; --i)
+            buf[n++] = text[rnd() % (sizeof text - 1)];
+        break;
+    }
+
+    emit(buf, n);
+}
+
+int maxdepth = 8;
+
+void
+generate(struct rule *r, int depth)
+{
+    double total = 0, pick;
+    struct alt *a = NULL;
+    // past the depth limit only the quickest-terminating alternatives qualify
+    bool limit = depth >= maxdepth;
+
+    for (int j = 0; j < r->nalts; ++j)
+        if (!limit || r->alts[j].mindepth == r->mindepth)
+            total += r->alts[j].weight;
+
+    pick = rndf() * total;
+    for (int j = 0; j < r->nalts; ++j)
+        if (!limit || r->alts[j].mindepth == r->mindepth) {
+            a = &r->alts[j];
+            if ((pick -= a->weight) < 0)
+                break;
+        }
+
+    for (int k = 0; k < a->nitems; ++k) {
+        struct item *it = &a->items[k];
+        switch (it->kind) {
+        case LIT:
+            emit(it->text, it->len);
+            break;
+        case RULE:
+            generate(&rules[it->rule], depth + 1);
+            break;
+        case BUILTIN:
+            builtin(it);
+            break;
+        }
+    }
+}
+
+// turn a valid line into a near-valid one: drop, insert or repeat a char
+void
+mutate()
+{
+    static const char noise[] = "()+-*/,.;\"'= ";
+    size_t at = outlen? rnd() % outlen : 0;
+
+    switch (rnd() % 3) {
+    case 0:
+        if (outlen) {
+            memmove(out + at, out + at + 1, outlen - at - 1);
+            --outlen;
+        }
+        break;
+    case 1:
+        emit(" ", 1);
+        memmove(out + at + 1, out + at, outlen - at - 1);
+        out[at] = noise[rnd() % (sizeof noise - 1)];
+        break;
+    case 2:
+        if (outlen) {
+            emit(" ", 1);
+            memmove(out + at + 1, out + at, outlen - at - 1);
+        }
+        break;
+    }
+}
+
+void
+setweights(char *arg)
+{
+    char *eq = strchr(arg, '=');
+    int r = eq? findrule(arg, eq - arg) : -1;
+
+    if (r < 0) {
+        fprintf(stderr, "gen: -w %s: no such rule\n", arg);
+        exit(1);
+    }
+    for (int j = 0; j < rules[r].nalts && *eq; ++j) {
+        rules[r].alts[j].weight = strtod(eq + 1, &eq);
+        if (*eq && *eq != ',')
+            break;
+    }
+}
+
+long long
+size_arg(char *s)
+{
+    char *end;
+    long long n = strtoll(s, &end, 10);
+    switch (tolower(*end)) {
+    case 'g': n <<= 10; // fall through
+    case 'm': n <<= 10; // fall through
+    case 'k': n <<= 10;
+    }
+    return n;
+}
+
+char *
+readfile(char *path)
+{
+    FILE *fp = fopen(path, "r");
+    char *text = NULL;
+    size_t sz = 0;
+
+    if (fp == NULL || getdelim(&text, &sz, '\0', fp) < 0) {
+        perror(path);
+        exit(1);
+    }
+    fclose(fp);
+    return text;
+}
+
+int
+main(int argc, char **argv)
+{
+    char *text = NULL, *weights[MAXRULES];
+    int nweights = 0, opt;
+    long long lines = 10, bytes = 0, written = 0;
+    double errors = 0;
+
+    while ((opt = getopt(argc, argv, "g:G:s:n:b:d:e:w:")) != -1)
+        switch (opt) {
+        case 'g':
+            for (int i = 0; i < sizeof grammars / sizeof grammars[0]; ++i)
+                if (strcmp(grammars[i].name, optarg) == 0)
+                    text = strdup(grammars[i].text);
+            if (text == NULL) {
+                fprintf(stderr, "gen: no built-in grammar %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'G': text = readfile(optarg); break;
+        case 's': seed = strtoull(optarg, NULL, 0) * 2 + 1; break;
+        case 'n': lines = size_arg(optarg); break;
+        case 'b': bytes = size_arg(optarg); lines = 0; break;
+        case 'd': maxdepth = atoi(optarg); break;
+        case 'e': errors = atof(optarg); break;
+        case 'w': if (nweights < MAXRULES) weights[nweights++] = optarg; break;
+        default:
+            fprintf(stderr, "usage: gen [-g grammar | -G file] [-s seed] [-n lines] "
+                    "[-b bytes] [-d depth] [-e errors] [-w rule=w1,w2,...]\n");
+            return 1;
+        }
+
+    load_grammar(text? text : strdup(grammars[0].text));
+    for (int i = 0; i < nweights; ++i)
+        setweights(weights[i]);
+
+    static char obuf[1 << 16];
+    setvbuf(stdout, obuf, _IOFBF, sizeof obuf);
+
+    for (long long n = 0; lines? n < lines : written < bytes; ++n) {
+        outlen = 0;
+        generate(&rules[0], 0);
+        if (errors > 0 && rndf() < errors)
+            mutate();
+        emit("\n", 1);
+        if (fwrite(out, 1, outlen, stdout) != outlen)
+            return 1;
+        written += outlen;
+    }
+
+    return fflush(stdout) != 0;
+}
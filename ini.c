@@ -0,0 +1,340 @@
+// ini.c - INI / key-value config parser on uuscan
+// compile: cc -O2 -o ini ini.c
+//
+// ini [-c] [file]
+//
+// parses file or stdin as INI-style config and reports what was found and the
+// throughput. the input is read into memory and split into lines first; only
+// the parse is timed. -c also times a strtok() based parser that classifies
+// values the same way, and gives the ratio of the times if every count agrees
+// (an input with errors does not).
+// compiled with -DUUCACHE=1024 ints and floats are converted once per distinct
+// value and the hit ratios are reported.
+//
+//      gen -g ini -b 256m > corpus.ini
+//      ini -c corpus.ini
+
+// line:
+//      [ section | pair | comment ] eol
+// section:
+//      "[" name { "." name } "]"
+// pair:
+//      name "=" value [ comment ]
+// value:
+//      integer | float | bool | "\"" text "\"" | text
+// comment:
+//      ";" text | "#" text
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+#define UUTERMINALS X(_name_) X(_int_) X(_float_) X(_quoted_) X(_text_) X(_comment_)
+
+#define UUVAL struct { long l; double d; }
+
+#include "uuscan.h"
+#include "bench.h"
+
+#define LSQ     CHAR('[')
+#define RSQ     CHAR(']')
+#define DOT     CHAR('.')
+#define EQ      CHAR('=')
+#define EOL     CHAR('\0')
+
+struct counts {
+    long sections, keys, ints, floats, bools, strings, comments, errors;
+} count;
+
+// terminal scanners:
+
+#ifdef UUCACHE
+// end of the number-like run at lp: the cache key, empty unless a digit or
+// point follows the sign. a conversion that stops inside the run is never
+// put, so a hit is a span the conversion would take
+static char *
+numspan(char *lp)
+{
+    char *cp = lp + (*lp == '-' || *lp == '+');
+
+    if (!isdigit(*cp) && *cp != '.')
+        return lp;
+    for (lp = cp; isalnum(*lp) || *lp == '.'; ++lp)
+        if ((*lp == 'e' || *lp == 'E') && (lp[1] == '-' || lp[1] == '+'))
+            ++lp;
+    return lp;
+}
+#endif
+
+UUDEFINE(_name_)
+{
+    while (isalnum(*lp) || *lp == '_' || *lp == '-')
+        ++lp;
+    if (lp == uu.lpstart)
+        return fail(lp);
+    uu.len = lp - uu.lpstart;
+    return success(lp);
+}
+
+UUDEFINE(_int_)
+{
+    char *end;
+
+#ifdef UUCACHE
+    end = numspan(lp);
+    if (uucache_get(_int_, lp, end - lp, &uu.l, sizeof uu.l))
+        return success(end);
+#endif
+    errno = 0;
+    uu.l = strtol(lp, &end, 0);
+    if (end == lp || isalnum(*end) || *end == '.')
+        return fail(lp);
+    if (errno == ERANGE)
+        return fail(lp, "integer out of range");
+#ifdef UUCACHE
+    uucache_put(_int_, lp, end - lp, &uu.l, sizeof uu.l);
+#endif
+    return success(end);
+}
+
+UUDEFINE(_float_)
+{
+    char *end;
+
+    // strtod also takes inf, nan and hex; config floats are decimal
+    if (!isdigit(*lp) && *lp != '.' && *lp != '-' && *lp != '+')
+        return fail(lp);
+#ifdef UUCACHE
+    end = numspan(lp);
+    if (uucache_get(_float_, lp, end - lp, &uu.d, sizeof uu.d))
+        return success(end);
+    bool cacheable = end > lp; // not signed inf or nan
+#endif
+    uu.d = strtod(lp, &end);
+    if (end == lp || isalnum(*end))
+        return fail(lp);
+#ifdef UUCACHE
+    if (cacheable)
+        uucache_put(_float_, lp, end - lp, &uu.d, sizeof uu.d);
+#endif
+    return success(end);
+}
+
+UUDEFINE(_quoted_)
+{
+    char *cp = lp + 1;
+
+    if (*lp != '"')
+        return fail(lp);
+    for (; *cp != '"'; ++cp)
+        if (*cp == '\0')
+            return fail(cp, "unterminated quote");
+        else if (*cp == '\\' && cp[1])
+            ++cp;
+    uu.len = cp - lp - 1;
+    uu.lpstart = lp + 1;
+    return success(cp + 1);
+}
+
+// bare value up to a comment or the end of line, trailing space trimmed
+UUDEFINE(_text_)
+{
+    char *end = lp;
+
+    while (*lp && *lp != ';' && *lp != '#')
+        if (!isspace(*lp++))
+            end = lp;
+    if (end == uu.lpstart)
+        return fail(lp);
+    uu.len = end - uu.lpstart;
+    return success(end);
+}
+
+UUDEFINE(_comment_)
+{
+    if (*lp != ';' && *lp != '#')
+        return fail(lp);
+    return success(lp + strlen(lp));
+}
+
+// parser:
+
+// a typed value must be followed by the end of line or a comment,
+// otherwise "10 seconds" would be an int with trailing junk
+bool
+ended()
+{
+    char *lp = uu.lp;
+
+    if (accept(EOL) || accept(_comment_)) {
+        uu.lp = lp;
+        return true;
+    }
+    return false;
+}
+
+void
+value()
+{
+    char *lp = uu.lp;
+
+    if (accept(_int_) && ended())
+        ++count.ints;
+    else if ((uu.lp = lp, accept(_float_)) && ended())
+        ++count.floats;
+    else if ((uu.lp = lp, acceptall("true", EOL) || acceptall("false", EOL)
+                       || acceptall("yes", EOL) || acceptall("no", EOL)
+                       || acceptall("on", EOL) || acceptall("off", EOL)))
+        ++count.bools;
+    else if (accept(_quoted_))
+        ++count.strings;
+    else if (uu.failmsg) // malformed rather than not quoted
+        uuerror("%s at pos %d", uu.failmsg, uuerrorpos());
+    else if (accept(_text_))
+        ++count.strings;
+    else
+        uuerror("value expected at pos %d", uuerrorpos());
+}
+
+void
+line()
+{
+    if (accept(LSQ)) {
+        do
+            expect(_name_, NULL, "expected section name");
+        while (accept(DOT));
+        expect(RSQ);
+        ++count.sections;
+    } else if (accept(_name_)) {
+        expect(EQ);
+        value();
+        ++count.keys;
+    }
+
+    if (accept(_comment_))
+        ++count.comments;
+    expect(EOL, NULL, "expected end of line");
+}
+
+// strtok() equivalent of line() for comparison; modifies the line
+
+void
+strtok_line(char *lp)
+{
+    char *key, *val, *end;
+
+    lp += strspn(lp, " \t");
+    if (*lp == '\0')
+        return;
+    if (*lp == ';' || *lp == '#') {
+        ++count.comments;
+        return;
+    }
+    if (*lp == '[') {
+        if (strtok(lp + 1, "]"))
+            ++count.sections;
+        return;
+    }
+    if ((key = strtok(lp, "= \t")) == NULL || (val = strtok(NULL, "=;#")) == NULL)
+        return;
+    ++count.keys;
+    val += strspn(val, " \t");
+    for (end = val + strlen(val); end > val && isspace(end[-1]); )
+        *--end = '\0';
+
+    strtol(val, &end, 0);
+    if (end != val && *end == '\0') {
+        ++count.ints;
+        return;
+    }
+    // as _float_: strtod's inf, nan and hex forms need a digit, point or sign first
+    if ((isdigit(*val) || *val == '.' || *val == '-' || *val == '+')
+            && (strtod(val, &end), end != val && *end == '\0'))
+        ++count.floats;
+    else if (!strcmp(val, "true") || !strcmp(val, "false") || !strcmp(val, "yes")
+             || !strcmp(val, "no") || !strcmp(val, "on") || !strcmp(val, "off"))
+        ++count.bools;
+    else
+        ++count.strings;
+}
+
+// input
+
+void
+report()
+{
+    printf("%ld sections, %ld keys: %ld int, %ld float, %ld bool, %ld string; %ld comments\n",
+           count.sections, count.keys, count.ints, count.floats, count.bools,
+           count.strings, count.comments);
+}
+
+int
+main(int argc, char **argv)
+{
+    FILE *fp = stdin;
+    size_t len;
+    long nlines;
+    char **lines;
+    static long i; // survives the uuerror longjmp
+    bool compare = false;
+    double t;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "c")) != -1)
+        switch (opt) {
+        case 'c': compare = true; break;
+        default:
+            fprintf(stderr, "usage: ini [-c] [file]\n");
+            return 1;
+        }
+    if (optind < argc && (fp = fopen(argv[optind], "r")) == NULL) {
+        perror(argv[optind]);
+        return 1;
+    }
+
+    lines = splitlines(readall(fp, &len), &nlines);
+
+    t = now();
+    on_uuerror {
+        if (count.errors++ < 10)
+            fprintf(stderr, "ini: line %ld: %s\n", i + 1, uu.msg);
+        ++i;
+    }
+
+    for (; i < nlines; ++i) {
+        uu.lp = uu.line = lines[i];
+        line();
+    }
+    t = now() - t;
+
+    report();
+    fprintf(stderr, "uuscan: %zu bytes in %.3fs, %.1f MB/s, %ld errors\n",
+            len, t, len / t / 1e6, count.errors);
+#ifdef UUCACHE
+    uucache_report(stderr);
+#endif
+
+    if (compare) {
+        double tuu = t;
+        struct counts uucount = count;
+
+        memset(&count, 0, sizeof count);
+        t = now();
+        for (i = 0; i < nlines; ++i)
+            strtok_line(lines[i]);
+        t = now() - t;
+        report();
+        fprintf(stderr, "strtok: %zu bytes in %.3fs, %.1f MB/s\n", len, t, len / t / 1e6);
+
+        // a ratio only for the same work: every line classified alike
+        count.errors = uucount.errors;
+        if (memcmp(&count, &uucount, sizeof count) != 0)
+            fprintf(stderr, "counts differ, not compared\n");
+        else
+            fprintf(stderr, "uuscan takes %.2fx the time of strtok\n", tuu / t);
+    }
+
+    return count.errors != 0;
+}
@@ -0,0 +1,228 @@
+// json.c - JSON parser on uuscan, reports value counts and throughput
+// compile: cc -O2 -o json json.c
+//
+// json [-p folded] [file]
+//
+// parses a sequence of JSON values separated by white space (one document,
+// or NDJSON lines) from file or stdin. the input is read into memory first
+// and only the parse is timed. e.g.
+//
+//      gen -g json -b 256m > corpus.json
+//      json corpus.json
+//
+// compiled with -DUUPROF, -p samples the parse's rule stack at 1 kHz and
+// writes folded stacks to the file named, for flamegraph.pl and the like.
+
+// value:
+//      object | array | string | number | "true" | "false" | "null"
+// object:
+//      "{" [ string ":" value { "," string ":" value } ] "}"
+// array:
+//      "[" [ value { "," value } ] "]"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define UUTERMINALS X(_string_) X(_number_)
+
+#define UUVAL struct { double d; }
+
+#include "uuscan.h"
+#include "bench.h"
+
+#define LBRACE   CHAR('{')
+#define RBRACE   CHAR('}')
+#define LBRACKET CHAR('[')
+#define RBRACKET CHAR(']')
+#define COLON    CHAR(':')
+#define COMMA    CHAR(',')
+#define EOL      CHAR('\0')
+
+#define MAXDEPTH 512
+
+struct {
+    long objects, arrays, strings, numbers, literals;
+    int depth;
+} count;
+
+// terminal scanners:
+
+// string is validated, not unescaped; uu.lpstart and uu.len give the
+// quoted text
+UUDEFINE(_string_)
+{
+    if (*lp != '"')
+        return fail(lp);
+
+    for (++lp; *lp != '"'; ++lp)
+        if (*lp == '\0')
+            return fail(lp, "unterminated string");
+        else if ((unsigned char)*lp < ' ')
+            return fail(lp, "control character in string");
+        else if (*lp == '\\')
+            switch (*++lp) {
+            case '"': case '\\': case '/':
+            case 'b': case 'f': case 'n': case 'r': case 't':
+                break;
+            case 'u':
+                for (int i = 0; i < 4; ++i)
+                    if (!isxdigit(*++lp))
+                        return fail(lp, "bad \\u escape");
+                break;
+            default:
+                return fail(lp, "bad escape");
+            }
+
+    ++lp;
+    uu.len = lp - uu.lpstart;
+    return success(lp);
+}
+
+// -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+UUDEFINE(_number_)
+{
+    char *cp = lp;
+
+    if (*cp == '-')
+        ++cp;
+    if (*cp == '0')
+        ++cp;
+    else if (isdigit(*cp))
+        while (isdigit(*cp))
+            ++cp;
+    else
+        return fail(cp);
+
+    if (*cp == '.') {
+        if (!isdigit(*++cp))
+            return fail(cp, "digit expected after decimal point");
+        while (isdigit(*cp))
+            ++cp;
+    }
+
+    if (*cp == 'e' || *cp == 'E') {
+        if (*++cp == '+' || *cp == '-')
+            ++cp;
+        if (!isdigit(*cp))
+            return fail(cp, "digit expected in exponent");
+        while (isdigit(*cp))
+            ++cp;
+    }
+
+    uu.d = strtod(lp, NULL);
+    uu.len = cp - lp;
+    return success(cp);
+}
+
+// parser:
+
+void
+value(int depth)
+{
+    UURULE;
+
+    if (depth > count.depth)
+        count.depth = depth;
+    if (depth == MAXDEPTH)
+        uuerror("nesting deeper than %d at pos %d", MAXDEPTH, (int)(uu.lp - uu.line) + 1);
+
+    if (accept(LBRACE)) {
+        ++count.objects;
+        if (accept(RBRACE))
+            return;
+        do {
+            expect(_string_, NULL, "expected member name");
+            expect(COLON);
+            value(depth + 1);
+        } while (accept(COMMA));
+        expect(RBRACE, NULL, "expected ',' or '}'");
+
+    } else if (accept(LBRACKET)) {
+        ++count.arrays;
+        if (accept(RBRACKET))
+            return;
+        do
+            value(depth + 1);
+        while (accept(COMMA));
+        expect(RBRACKET, NULL, "expected ',' or ']'");
+
+    } else if (accept(_string_))
+        ++count.strings;
+    else if (uu.failmsg) // malformed rather than not a string
+        uuerror("%s at pos %d", uu.failmsg, uuerrorpos());
+    else if (accept(_number_))
+        ++count.numbers;
+    else if (uu.failmsg)
+        uuerror("%s at pos %d", uu.failmsg, uuerrorpos());
+    else if (accept("true") || accept("false") || accept("null"))
+        ++count.literals;
+    else
+        uuerror("value expected at pos %d", uuerrorpos());
+}
+
+int
+main(int argc, char **argv)
+{
+    FILE *fp;
+#ifdef UUPROF
+    FILE *prof = NULL;
+#endif
+    size_t len;
+    double t;
+    long docs = 0;
+
+    if (argc > 2 && strcmp(argv[1], "-p") == 0) {
+#ifdef UUPROF
+        if ((prof = fopen(argv[2], "w")) == NULL) {
+            perror(argv[2]);
+            return 1;
+        }
+#else
+        fprintf(stderr, "json: -p needs -DUUPROF\n");
+        return 1;
+#endif
+        argv += 2;
+        argc -= 2;
+    }
+    fp = argc > 1? fopen(argv[1], "r") : stdin;
+
+    if (fp == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    uu.lp = uu.line = readall(fp, &len);
+
+    on_uuerror {
+        char *at = uu.lpfail > uu.lp? uu.lpfail : uu.lp;
+        int line = 1;
+        for (char *cp = uu.line; cp < at; ++cp)
+            line += *cp == '\n';
+        fprintf(stderr, "json: line %d: %s\n", line, uu.msg);
+        return 1;
+    }
+
+    t = now();
+#ifdef UUPROF
+    if (prof)
+        uuprof_start(1000);
+#endif
+    while (!accept(EOL)) {
+        value(0);
+        ++docs;
+    }
+    t = now() - t;
+#ifdef UUPROF
+    if (prof) {
+        uuprof_stop();
+        uuprof_report(prof);
+        fclose(prof);
+    }
+#endif
+
+    printf("%ld documents: %ld objects, %ld arrays, %ld strings, %ld numbers, "
+           "%ld literals, depth %d\n", docs, count.objects, count.arrays,
+           count.strings, count.numbers, count.literals, count.depth);
+    fprintf(stderr, "json: %zu bytes in %.3fs, %.1f MB/s\n", len, t, len / t / 1e6);
+    return 0;
+}
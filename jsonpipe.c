@@ -0,0 +1,347 @@
+// jsonpipe.c - JSON lexed on one thread and parsed on another, through uupipe.h
+// compile: cc -O2 -pthread -o jsonpipe jsonpipe.c
+//
+// jsonpipe [-r ring] [file]
+//
+// the same grammar and counts as json.c, for single huge documents where
+// there are no lines to parse in parallel. a lexer thread runs the _string_
+// and _number_ scanners and the literal and punctuation scans over the whole
+// input, converting numbers as it goes, and puts the tokens in a ring of -r
+// tokens (default 4096); the rules run on the main thread on token kinds.
+// the parse is timed both ways, best of 3: on one thread with the lexer
+// called to fill the ring whenever it is empty, and on two.
+//
+// a two-element array of a string and a number counts as a pair; it is
+// found by trying "[" string "," number "]" and backtracking over the tokens
+// taken when the array turns out to be something else.
+
+// value:
+//      object | array | string | number | "true" | "false" | "null"
+// object:
+//      "{" [ string ":" value { "," string ":" value } ] "}"
+// array:
+//      "[" [ value { "," value } ] "]"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+
+#define UUTHREADS
+#define UUTERMINALS X(_string_) X(_number_)
+
+#define UUVAL struct { double d; }
+
+#include "uuscan.h"
+#include "bench.h"
+#include "uupipe.h"
+
+#define MAXDEPTH 512
+
+enum {
+    T_LBRACE, T_RBRACE, T_LBRACKET, T_RBRACKET, T_COLON, T_COMMA,
+    T_STRING, T_NUMBER, T_LITERAL, T_END, T_ERROR,
+};
+
+struct {
+    long objects, arrays, strings, numbers, literals, pairs, tokens;
+    int depth;
+} count;
+
+// terminal scanners, as in json.c:
+
+UUDEFINE(_string_)
+{
+    if (*lp != '"')
+        return fail(lp);
+
+    for (++lp; *lp != '"'; ++lp)
+        if (*lp == '\0')
+            return fail(lp, "unterminated string");
+        else if ((unsigned char)*lp < ' ')
+            return fail(lp, "control character in string");
+        else if (*lp == '\\')
+            switch (*++lp) {
+            case '"': case '\\': case '/':
+            case 'b': case 'f': case 'n': case 'r': case 't':
+                break;
+            case 'u':
+                for (int i = 0; i < 4; ++i)
+                    if (!isxdigit(*++lp))
+                        return fail(lp, "bad \\u escape");
+                break;
+            default:
+                return fail(lp, "bad escape");
+            }
+
+    ++lp;
+    uu.len = lp - uu.lpstart;
+    return success(lp);
+}
+
+UUDEFINE(_number_)
+{
+    char *cp = lp;
+
+    if (*cp == '-')
+        ++cp;
+    if (*cp == '0')
+        ++cp;
+    else if (isdigit(*cp))
+        while (isdigit(*cp))
+            ++cp;
+    else
+        return fail(cp);
+
+    if (*cp == '.') {
+        if (!isdigit(*++cp))
+            return fail(cp, "digit expected after decimal point");
+        while (isdigit(*cp))
+            ++cp;
+    }
+
+    if (*cp == 'e' || *cp == 'E') {
+        if (*++cp == '+' || *cp == '-')
+            ++cp;
+        if (!isdigit(*cp))
+            return fail(cp, "digit expected in exponent");
+        while (isdigit(*cp))
+            ++cp;
+    }
+
+    uu.d = strtod(lp, NULL);
+    uu.len = cp - lp;
+    return success(cp);
+}
+
+// lexer: on its own thread, or called by the parser to fill the ring
+
+static struct uupipe stream;
+static char *input;
+
+// scan one token at uu.lp into the ring, false at the end or an error
+static bool
+lexone(struct uupipe *p)
+{
+    struct uutoken *t = uupipe_slot(p);
+    char *lp = uu.lp = skipspace(uu.lp);
+
+    t->pos = lp - input;
+    switch (*lp) {
+    case '{': t->kind = T_LBRACE; ++uu.lp; break;
+    case '}': t->kind = T_RBRACE; ++uu.lp; break;
+    case '[': t->kind = T_LBRACKET; ++uu.lp; break;
+    case ']': t->kind = T_RBRACKET; ++uu.lp; break;
+    case ':': t->kind = T_COLON; ++uu.lp; break;
+    case ',': t->kind = T_COMMA; ++uu.lp; break;
+    case '\0': t->kind = T_END; break;
+    case '"':
+        t->kind = accept(_string_)? T_STRING : T_ERROR;
+        break;
+    case 't': case 'f': case 'n':
+        t->kind = accept("true") || accept("false") || accept("null")? T_LITERAL : T_ERROR;
+        break;
+    default:
+        t->kind = accept(_number_)? T_NUMBER : T_ERROR;
+        t->v.d = uu.d;
+        break;
+    }
+    if (t->kind == T_ERROR) {
+        t->pos = uu.lpfail - input;
+        t->v.p = uu.failmsg;
+    }
+    t->len = uu.lp - lp;
+    uupipe_put(p);
+    return t->kind != T_END && t->kind != T_ERROR;
+}
+
+static bool lexdone;
+
+// one thread: a batch of tokens, whatever fits
+static void
+fill(struct uupipe *p)
+{
+    for (int n = 0; n < UUPIPE_BATCH && !lexdone && !uupipe_full(p); ++n)
+        lexdone = !lexone(p);
+}
+
+static void *
+lexer(void *arg)
+{
+    struct uupipe *p = arg;
+
+    uu.lp = uu.line = input;
+    while (lexone(p))
+        ;
+    uupipe_flush(p);
+    return NULL;
+}
+
+// parser: rules on token kinds
+
+static struct uutoken *
+peek()
+{
+    struct uutoken *t = uupipe_peek(&stream);
+
+    if (t == NULL)
+        uuerror("backtracking past %zu tokens", stream.mask + 1);
+    if (t->kind == T_ERROR)
+        uuerror("%s at pos %zu", t->v.p? (const char *)t->v.p : "bad token", t->pos + 1);
+    return t;
+}
+
+static bool
+tok(int kind)
+{
+    if (peek()->kind != kind)
+        return false;
+    uupipe_next(&stream);
+    ++count.tokens;
+    return true;
+}
+
+static void
+want(int kind, const char *what)
+{
+    if (!tok(kind))
+        uuerror("expected %s at pos %zu", what, peek()->pos + 1);
+}
+
+void
+value(int depth)
+{
+    struct uutoken *t;
+
+    if (depth > count.depth)
+        count.depth = depth;
+    if (depth == MAXDEPTH)
+        uuerror("nesting deeper than %d at pos %zu", MAXDEPTH, peek()->pos + 1);
+
+    if (tok(T_LBRACE)) {
+        ++count.objects;
+        if (tok(T_RBRACE))
+            return;
+        do {
+            want(T_STRING, "member name");
+            want(T_COLON, "':'");
+            value(depth + 1);
+        } while (tok(T_COMMA));
+        want(T_RBRACE, "',' or '}'");
+        return;
+    }
+
+    if (peek()->kind == T_LBRACKET) {
+        size_t m = uupipe_mark(&stream);
+        long tokens = count.tokens;
+
+        tok(T_LBRACKET);
+        if (depth + 1 < MAXDEPTH    // else the elements fail as value() would
+                && tok(T_STRING) && tok(T_COMMA) && tok(T_NUMBER) && tok(T_RBRACKET)) {
+            uupipe_commit(&stream);
+            if (depth + 1 > count.depth)
+                count.depth = depth + 1;
+            ++count.pairs;
+            ++count.arrays;
+            ++count.strings;
+            ++count.numbers;
+            return;
+        }
+        uupipe_rollback(&stream, m);
+        count.tokens = tokens;
+
+        tok(T_LBRACKET);
+        ++count.arrays;
+        if (tok(T_RBRACKET))
+            return;
+        do
+            value(depth + 1);
+        while (tok(T_COMMA));
+        want(T_RBRACKET, "',' or ']'");
+        return;
+    }
+
+    t = peek();
+    if (t->kind == T_STRING)
+        ++count.strings;
+    else if (t->kind == T_NUMBER)
+        ++count.numbers;
+    else if (t->kind == T_LITERAL)
+        ++count.literals;
+    else
+        uuerror("value expected at pos %zu", t->pos + 1);
+    uupipe_next(&stream);
+    ++count.tokens;
+}
+
+int
+main(int argc, char **argv)
+{
+    FILE *fp = stdin;
+    int ring = 4096, opt;
+    size_t len;
+    long docs = 0;
+
+    while ((opt = getopt(argc, argv, "r:")) != -1)
+        switch (opt) {
+        case 'r': ring = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: jsonpipe [-r ring] [file]\n");
+            return 1;
+        }
+    if (ring < UUPIPE_BATCH || (ring & (ring - 1))) {
+        fprintf(stderr, "jsonpipe: ring must be a power of 2, at least %d\n", UUPIPE_BATCH);
+        return 1;
+    }
+    if (optind < argc && (fp = fopen(argv[optind], "r")) == NULL) {
+        perror(argv[optind]);
+        return 1;
+    }
+    input = readall(fp, &len);
+
+    on_uuerror {
+        fprintf(stderr, "jsonpipe: %s\n", uu.msg);
+        exit(1);
+    }
+
+    for (int threads = 1; threads <= 2; ++threads) {
+        double best = 0;
+
+        for (int run = 0; run < 3; ++run) {
+            pthread_t tid;
+            double t = now();
+
+            memset(&count, 0, sizeof count);
+            docs = 0;
+            if (!uupipe_init(&stream, ring, threads == 1? fill : NULL)) {
+                perror("jsonpipe");
+                return 1;
+            }
+            if (threads == 1) {
+                uu.lp = uu.line = input;
+                lexdone = false;
+            } else
+                pthread_create(&tid, NULL, lexer, &stream);
+
+            while (!tok(T_END)) {
+                value(0);
+                ++docs;
+            }
+
+            if (threads == 2)
+                pthread_join(tid, NULL);
+            uupipe_free(&stream);
+            t = now() - t;
+            keepbest(&best, t);
+        }
+        fprintf(stderr, "jsonpipe: %d thread%s, %zu bytes in %.3fs, %.1f MB/s\n",
+                threads, threads > 1? "s" : "", len, best, len / best / 1e6);
+    }
+
+    printf("%ld documents: %ld objects, %ld arrays, %ld strings, %ld numbers, "
+           "%ld literals, depth %d\n", docs, count.objects, count.arrays,
+           count.strings, count.numbers, count.literals, count.depth);
+    printf("%ld tokens, %ld pairs\n", count.tokens, count.pairs);
+    return 0;
+}
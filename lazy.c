@@ -0,0 +1,417 @@
+// lazy.c - a large config loaded with its blocks skipped, parsed when used
+// compile: cc -O2 -o lazy lazy.c
+//
+// lazy [-m MB] [-n]
+//
+// a config of about -m MB (default 16) of named sections is generated, each
+// a block of settings with nested blocks, comments and strings holding
+// braces. it is loaded once in full, and once with each section's block
+// skipped by uuskip() and kept as a thunk; then 1, 10, 100 and all the
+// sections, picked at random, are parsed with uuforce(). -n skips with a
+// scanner that reads a byte at a time instead. each is timed best of 3, and
+// the totals of all the forced sections must be the full load's. last, a
+// short config with an error shows the error found only when forced.
+
+// config:
+//      { section }
+// section:
+//      name [ string ] block
+// block:
+//      "{" { setting } "}"
+// setting:
+//      name { value } ( ";" | block )
+// value:
+//      integer | string | name
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+
+#define UULAZY
+#define UUTERMINALS X(_name_) X(_int_) X(_string_) X(_comment_) X(_block_)
+
+#include "uuscan.h"
+#include "bench.h"
+
+#define LBRACE  CHAR('{')
+#define RBRACE  CHAR('}')
+#define SEMI    CHAR(';')
+
+#define SKIP    (UUSKIP_HASH | UUSKIP_SLASH)
+
+// terminal scanners:
+
+UUDEFINE(_name_)
+{
+    if (!isalpha(*lp) && *lp != '_')
+        return fail(lp);
+    while (isalnum(*lp) || *lp == '_' || *lp == '-' || *lp == '.')
+        ++lp;
+    return success(lp);
+}
+
+UUDEFINE(_int_, long *v)
+{
+    long n = 0;
+
+    if (!isdigit(*lp))
+        return fail(lp);
+    while (isdigit(*lp))
+        n = n * 10 + *lp++ - '0';
+    if (v)
+        *v = n;
+    return success(lp);
+}
+
+UUDEFINE(_string_)
+{
+    if (*lp != '"')
+        return fail(lp);
+    for (++lp; *lp != '"'; ++lp)
+        if (*lp == '\0' || (*lp == '\\' && *++lp == '\0'))
+            return fail(lp, "unterminated string");
+    return success(lp + 1);
+}
+
+UUDEFINE(_comment_)
+{
+    if (*lp == '#' || (lp[0] == '/' && lp[1] == '/')) {
+        while (*lp && *lp != '\n')
+            ++lp;
+        return success(lp);
+    }
+    if (lp[0] != '/' || lp[1] != '*')
+        return fail(lp);
+    for (lp += 2; lp[0] != '*' || lp[1] != '/'; ++lp)
+        if (*lp == '\0')
+            return fail(lp, "unterminated comment");
+    return success(lp + 2);
+}
+
+// -n: a block skipped a byte at a time, as a scanner without uuskip() would
+UUDEFINE(_block_)
+{
+    int depth = 0;
+
+    if (*lp != '{')
+        return fail(lp);
+    for (;;)
+        switch (*lp) {
+        case '\0':
+            return fail(lp, "unterminated block");
+        case '{':
+            ++depth;
+            ++lp;
+            break;
+        case '}':
+            ++lp;
+            if (--depth == 0)
+                return success(lp);
+            break;
+        case '"':
+            for (++lp; *lp != '"'; ++lp)
+                if (*lp == '\0' || (*lp == '\\' && *++lp == '\0'))
+                    return fail(lp, "unterminated block");
+            ++lp;
+            break;
+        case '#':
+            while (*lp && *lp != '\n')
+                ++lp;
+            break;
+        case '/':
+            if (lp[1] == '/')
+                while (*lp && *lp != '\n')
+                    ++lp;
+            else if (lp[1] == '*') {
+                for (lp += 2; lp[0] != '*' || lp[1] != '/'; ++lp)
+                    if (*lp == '\0')
+                        return fail(lp, "unterminated block");
+                lp += 2;
+            } else
+                ++lp;
+            break;
+        default:
+            ++lp;
+        }
+}
+
+// the grammar:
+
+struct tally {
+    long settings, blocks, sum, chars; // chars: of names and strings
+};
+
+struct section {
+    char *name;
+    int len;
+    struct uuthunk body;
+    struct tally tally;         // the body's, once forced
+};
+
+static void
+comments()
+{
+    while (accept(_comment_))
+        ;
+}
+
+bool block(void *res);
+
+static void
+setting(struct tally *t)
+{
+    long n;
+
+    ++t->settings;
+    t->chars += uu.lp - uu.lpstart;
+    for (;;)
+        if (accept(_int_, &n))
+            t->sum += n;
+        else if (accept(_string_) || accept(_name_))
+            t->chars += uu.lp - uu.lpstart;
+        else
+            break;
+    if (!accept(SEMI) && !block(t))
+        uuerror("expected ';' or block at pos %d", uuerrorpos());
+}
+
+bool
+block(void *res)
+{
+    struct tally *t = res;
+
+    if (!accept(LBRACE))
+        return false;
+    ++t->blocks;
+    comments();
+    while (accept(_name_)) {
+        setting(t);
+        comments();
+    }
+    expect(RBRACE);
+    return true;
+}
+
+// sections into s[], up to max, their bodies parsed into t (lazy: skipped);
+// returns how many
+static bool naive;
+
+static int
+config(struct section *s, int max, struct tally *t, bool lazy)
+{
+    int n = 0;
+
+    comments();
+    while (accept(_name_)) {
+        if (n == max)
+            uuerror("more than %d sections", max);
+        s[n].name = uu.lpstart;
+        s[n].len = uu.lp - uu.lpstart;
+        accept(_string_);
+        if (!lazy) {
+            if (!block(t))
+                uuerror("expected block at pos %d", uuerrorpos());
+        } else if (naive)
+            expect(_block_, NULL, "expected block");
+        else if (!uuskip('{', '}', SKIP, &s[n].body))
+            uuerror("expected block at pos %d%s%s", uuerrorpos(),
+                    uu.failmsg? ": " : "", uu.failmsg? uu.failmsg : "");
+        ++n;
+        comments();
+    }
+    if (*skipspace(uu.lp))
+        uuerror("expected section at pos %d", (int)(skipspace(uu.lp) - uu.line) + 1);
+    return n;
+}
+
+// input:
+
+static const char *keys[] = {
+    "listen", "root", "index", "proxy_pass", "timeout", "retries", "limit",
+    "log", "access", "header", "cache", "gzip", "ssl_cert", "workers",
+};
+static const char *strings[] = {
+    "\"/var/www/html\"", "\"http://127.0.0.1:8080\"", "\"${host}{$uri}\"",
+    "\"off\"", "\"}\"", "\"{ \\\"quoted\\\" }\"", "\"/etc/ssl/site.pem\"",
+};
+static const char *comments_[] = {
+    "# keep in sync with the {upstream} list\n", "// } closed below\n",
+    "/* { was here */ ", "# -\n",
+};
+#define NKEYS       (int)(sizeof keys / sizeof keys[0])
+#define NSTRINGS    (int)(sizeof strings / sizeof strings[0])
+#define NCOMMENTS   (int)(sizeof comments_ / sizeof comments_[0])
+
+static char *
+body(char *cp, int depth)
+{
+    cp += sprintf(cp, "{\n");
+    for (int n = depth? 3 + rnd(12) : 20 + rnd(60); n > 0; --n) {
+        if (rnd(8) == 0)
+            cp += sprintf(cp, "%*s%s", depth * 4 + 4, "", comments_[rnd(NCOMMENTS)]);
+        cp += sprintf(cp, "%*s%s", depth * 4 + 4, "", keys[rnd(NKEYS)]);
+        for (int v = rnd(4); v > 0; --v)
+            switch (rnd(3)) {
+            case 0: cp += sprintf(cp, " %u", rnd(100000)); break;
+            case 1: cp += sprintf(cp, " %s", strings[rnd(NSTRINGS)]); break;
+            case 2: cp += sprintf(cp, " %s", keys[rnd(NKEYS)]); break;
+            }
+        if (depth < 3 && rnd(6) == 0) {
+            *cp++ = ' ';
+            cp = body(cp, depth + 1);
+        } else
+            cp += sprintf(cp, ";\n");
+    }
+    return cp + sprintf(cp, "%*s}\n", depth * 4, "");
+}
+
+static char *
+generate(long size, int *nsections)
+{
+    char *buf = malloc(size + 65536), *cp = buf;
+
+    if (buf == NULL) {
+        perror("lazy");
+        exit(1);
+    }
+    for (*nsections = 0; cp - buf < size; ++*nsections) {
+        cp += sprintf(cp, "%ssite-%d \"site %d\" ", rnd(4)? "" : comments_[rnd(NCOMMENTS)],
+                      *nsections, *nsections);
+        cp = body(cp, 0);
+    }
+    *cp = '\0';
+    return buf;
+}
+
+// load buf into s[], best of 3; false with the error printed if it fails
+static bool
+load(char *buf, struct section *s, int max, struct tally *t, bool lazy, int *n, double *best)
+{
+    *best = 0;
+    for (int run = 0; run < 3; ++run) {
+        double t0 = now();
+
+        memset(t, 0, sizeof *t);
+        uu.lp = uu.line = buf;
+        on_uuerror {
+            printf("%s\n", uu.msg);
+            return false;
+        }
+        *n = config(s, max, t, lazy);
+        t0 = now() - t0;
+        keepbest(best, t0);
+    }
+    return true;
+}
+
+static void
+add(struct tally *to, const struct tally *t)
+{
+    to->settings += t->settings;
+    to->blocks += t->blocks;
+    to->sum += t->sum;
+    to->chars += t->chars;
+}
+
+static const char bad[] =
+    "# two sections, the second with an error\n"
+    "good { listen 80; root \"/srv/{a}\"; }\n"
+    "bad {\n"
+    "    listen 81;\n"
+    "    location \"/x\" { limit = 5; }\n"
+    "}\n";
+
+int
+main(int argc, char **argv)
+{
+    long mb = 16;
+    int n, nsections, opt, errors = 0;
+    bool same;
+    struct section *s;
+    struct tally full, t, forced;
+    char *buf, msg[80];
+    double tfull, tload;
+
+    while ((opt = getopt(argc, argv, "m:n")) != -1)
+        switch (opt) {
+        case 'm': mb = atol(optarg); break;
+        case 'n': naive = true; break;
+        default:
+            fprintf(stderr, "usage: lazy [-m MB] [-n]\n");
+            return 1;
+        }
+
+    buf = generate(mb * 1024 * 1024, &nsections);
+    if ((s = calloc(nsections, sizeof *s)) == NULL) {
+        perror("lazy");
+        return 1;
+    }
+    printf("%d sections in %.1f MB, best of 3\n", nsections, strlen(buf) / 1048576.0);
+
+    // the whole config, then with the sections' blocks skipped
+    if (!load(buf, s, nsections, &full, false, &n, &tfull))
+        return 1;
+    printf("full parse    %8.2f ms  %7.1f MB/s  %ld settings  %ld blocks  sum %ld  %ld chars\n",
+           tfull * 1e3, strlen(buf) / tfull / 1048576, full.settings, full.blocks, full.sum,
+           full.chars);
+    if (!load(buf, s, nsections, &t, true, &n, &tload))
+        return 1;
+    printf("%-13s %8.2f ms  %7.1f MB/s  %d sections\n", naive? "byte skip" : "uuskip",
+           tload * 1e3, strlen(buf) / tload / 1048576, n);
+    if (naive)
+        return 0;
+
+    // force k random sections, on a fresh load each time
+    for (int k = 1; ; k = k * 10 < n? k * 10 : n) {
+        double best = 0;
+
+        for (int run = 0; run < 3; ++run) {
+            double t0;
+
+            load(buf, s, nsections, &t, true, &n, &tload);
+            t0 = now();
+            for (int i = 0; i < k; ++i) {
+                struct section *p = &s[k == n? i : rnd(n)];
+
+                if (p->body.status >= 0)
+                    continue;   // forced before
+                memset(&p->tally, 0, sizeof p->tally);
+                if (uuforce(msg, &p->body, block, &p->tally) != UUPARSE_OK)
+                    ++errors;
+            }
+            t0 = tload + now() - t0;
+            keepbest(&best, t0);
+        }
+        printf("load + %-6d %8.2f ms  %5.1f%% of the full parse\n", k, best * 1e3,
+               best / tfull * 100);
+        if (k == n)
+            break;
+    }
+
+    // all forced: the same totals as the full parse
+    memset(&forced, 0, sizeof forced);
+    for (int i = 0; i < n; ++i)
+        add(&forced, &s[i].tally);
+    same = forced.settings == full.settings && forced.blocks == full.blocks
+           && forced.sum == full.sum && forced.chars == full.chars && errors == 0;
+    printf("forced all: %ld settings  %ld blocks  sum %ld  %ld chars  %s\n", forced.settings,
+           forced.blocks, forced.sum, forced.chars, same? "same as the full parse" : "DIFFERENT");
+
+    // an error in a block is found when that block is forced
+    strcpy(buf, bad);
+    uu.lp = uu.line = buf;
+    on_uuerror {
+        printf("%s\n", uu.msg);
+        return 1;
+    }
+    n = config(s, nsections, &t, true);
+    for (int i = 0; i < n; ++i) {
+        memset(&s[i].tally, 0, sizeof s[i].tally);
+        if (uuforce(msg, &s[i].body, block, &s[i].tally) == UUPARSE_OK)
+            printf("%.*s: %ld settings\n", s[i].len, s[i].name, s[i].tally.settings);
+        else
+            printf("%.*s: %s\n", s[i].len, s[i].name, msg);
+    }
+    return !same;
+}
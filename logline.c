@@ -0,0 +1,524 @@
+// logline.c - Apache access log and syslog line parser on uuscan
+// compile: cc -O2 -o logline logline.c
+//
+// logline [-c] [-k checkpoint [-K seconds]] [file]
+//
+// parses each line of file or stdin as an Apache common/combined log entry or
+// an RFC 3164 syslog message and reports line counts and throughput. the input
+// is read into memory and split into lines first; only the parse is timed.
+// -c also times an sscanf() based parser on the same lines for comparison.
+//
+// -k keeps a checkpoint of how far the input has been counted, and the counts
+// so far, written atomically (uuckpt.h) every -K seconds (default 1) and at the
+// end. run again with the same -k, logline skips the input it has counted and
+// goes on from there. the input is then read 16MB of whole lines at a time, and
+// SIGINT or SIGTERM stop it at the end of a line, with a checkpoint.
+//
+// fields go straight from the grammar into uusink.h columns, one row per line,
+// and the counts are taken from each batch of columns through the Arrow C data
+// interface: there is no record struct between parse and analysis.
+//
+//      gen -g log -b 256m > corpus.log
+//      logline -c corpus.log
+
+// line:
+//      apache | syslog
+// apache:
+//      host ident user "[" time "]" "\"" method path protocol "\"" status size
+//      [ "\"" referer "\"" "\"" agent "\"" ]
+// syslog:
+//      [ "<" pri ">" ] month day hh ":" mm ":" ss host tag [ "[" pid "]" ] ":" message
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <limits.h>
+#include <signal.h>
+#include <time.h>
+
+#define UUTERMINALS X(_field_) X(_int_) X(_bracketed_) X(_quoted_) X(_month_) \
+                    X(_tag_) X(_rest_)
+
+#define UUVAL struct { int i; }
+
+#include "uuscan.h"
+#include "bench.h"
+#include "uusink.h"
+#include "uuckpt.h"
+
+#define LT      CHAR('<')
+#define GT      CHAR('>')
+#define LSQ     CHAR('[')
+#define RSQ     CHAR(']')
+#define COLON   CHAR(':')
+#define QUOTE   CHAR('"')
+#define DASH    CHAR('-')
+#define EOL     CHAR('\0')
+
+struct span {
+    char *p;
+    int len;
+};
+
+enum { APACHE, SYSLOG };
+
+// columns, apache fields are null in syslog rows and the other way about
+enum {
+    KIND, HOST, IDENT, USER, TIME, METHOD, PATH, PROTOCOL, STATUS, SIZE,
+    REFERER, AGENT, PRI, MONTH, DAY, HH, MM, SS, TAG, PID, MESSAGE, NCOLS
+};
+
+struct uucol cols[NCOLS] = {
+    [KIND] = { "kind", UUSINK_INT },
+    [HOST] = { "host", UUSINK_STR },
+    [IDENT] = { "ident", UUSINK_STR },
+    [USER] = { "user", UUSINK_STR },
+    [TIME] = { "time", UUSINK_STR },
+    [METHOD] = { "method", UUSINK_STR },
+    [PATH] = { "path", UUSINK_STR },
+    [PROTOCOL] = { "protocol", UUSINK_STR },
+    [STATUS] = { "status", UUSINK_INT },
+    [SIZE] = { "size", UUSINK_INT },
+    [REFERER] = { "referer", UUSINK_STR },
+    [AGENT] = { "agent", UUSINK_STR },
+    [PRI] = { "pri", UUSINK_INT },
+    [MONTH] = { "month", UUSINK_INT },
+    [DAY] = { "day", UUSINK_INT },
+    [HH] = { "hh", UUSINK_INT },
+    [MM] = { "mm", UUSINK_INT },
+    [SS] = { "ss", UUSINK_INT },
+    [TAG] = { "tag", UUSINK_STR },
+    [PID] = { "pid", UUSINK_INT },
+    [MESSAGE] = { "message", UUSINK_STR },
+};
+
+#define BATCH   4096    // rows per column batch, columns stay in cache
+#define CHUNK   (16 << 20) // bytes of input at a time with -k
+
+struct uusink sink;
+
+// -k: the counts cover the input to done once the row of its line is tallied
+struct uuckpt ck;
+char *ckpath, *chunk, *done;    // input in memory, past the line being parsed
+uint64_t chunkoff;              // offset of chunk in the input
+volatile sig_atomic_t stop;
+
+struct {
+    long lines, apache, syslog, errors;
+    long status[6];     // by hundreds
+    long long bytes;
+} count;
+
+// terminal scanners, spans are returned through the result pointer:
+
+static inline bool
+spanned(char *lp, struct span *s)
+{
+    if (lp == uu.lpstart)
+        return fail(lp);
+    if (s) {
+        s->p = uu.lpstart;
+        s->len = lp - uu.lpstart;
+    }
+    return success(lp);
+}
+
+// run of non-space, stops at a quote
+UUDEFINE(_field_, struct span *s)
+{
+    while (*lp && !isspace(*lp) && *lp != '"')
+        ++lp;
+    return spanned(lp, s);
+}
+
+UUDEFINE(_int_)
+{
+    int val = 0;
+
+    if (!isdigit(*lp))
+        return fail(lp);
+
+    for (; isdigit(*lp); ++lp)
+        if (val > (INT_MAX - (*lp - '0')) / 10)
+            return fail(lp, "number too large");
+        else
+            val = val * 10 + *lp - '0';
+
+    uu.i = val;
+    return success(lp);
+}
+
+// [text], span excludes the brackets
+UUDEFINE(_bracketed_, struct span *s)
+{
+    char *cp;
+
+    if (*lp != '[' || (cp = strchr(lp, ']')) == NULL)
+        return fail(lp);
+    if (s) {
+        s->p = lp + 1;
+        s->len = cp - lp - 1;
+    }
+    return success(cp + 1);
+}
+
+// "text" with \" escapes, span excludes the quotes
+UUDEFINE(_quoted_, struct span *s)
+{
+    char *cp = lp + 1;
+
+    if (*lp != '"')
+        return fail(lp);
+    for (; *cp != '"'; ++cp)
+        if (*cp == '\0')
+            return fail(cp, "unterminated quote");
+        else if (*cp == '\\' && cp[1])
+            ++cp;
+    if (s) {
+        s->p = lp + 1;
+        s->len = cp - lp - 1;
+    }
+    return success(cp + 1);
+}
+
+UUDEFINE(_month_)
+{
+    static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+
+    for (int i = 0; i < 36; i += 3)
+        if (strncmp(lp, months + i, 3) == 0 && lp[3] == ' ') {
+            uu.i = i / 3 + 1;
+            return success(lp + 3);
+        }
+    return fail(lp);
+}
+
+// syslog tag, up to [pid] or the colon
+UUDEFINE(_tag_, struct span *s)
+{
+    while (*lp && *lp != '[' && *lp != ':' && !isspace(*lp))
+        ++lp;
+    return spanned(lp, s);
+}
+
+// remainder of line, may be empty
+UUDEFINE(_rest_, struct span *s)
+{
+    s->p = lp;
+    s->len = strlen(lp);
+    return success(lp + s->len);
+}
+
+// parser, fields are written to the columns of the current row:
+
+// span terminal t into string column col
+void
+str(int t, int col, char *msg)
+{
+    struct span s;
+
+    expect(t, &s, msg);
+    uusink_str(&sink, col, s.p, s.len);
+}
+
+// integer into column col
+void
+num(int col, char *msg)
+{
+    expect(_int_, NULL, msg);
+    uusink_int(&sink, col, uu.i);
+}
+
+void
+syslog_line()
+{
+    struct span msg;
+
+    uusink_int(&sink, KIND, SYSLOG);
+
+    if (accept(LT)) {
+        num(PRI, "expected priority");
+        expect(GT);
+    }
+
+    expect(_month_, NULL, "expected month");
+    uusink_int(&sink, MONTH, uu.i);
+    num(DAY, "expected day");
+    num(HH, "expected hour");
+    expect(COLON);
+    num(MM, "expected minutes");
+    expect(COLON);
+    num(SS, "expected seconds");
+
+    str(_field_, HOST, "expected host");
+    str(_tag_, TAG, "expected tag");
+    if (accept(LSQ)) {
+        num(PID, "expected pid");
+        expect(RSQ);
+    }
+    expect(COLON);
+    accept(_rest_, &msg);
+    uusink_str(&sink, MESSAGE, msg.p, msg.len);
+}
+
+void
+apache_line()
+{
+    struct span s;
+
+    uusink_int(&sink, KIND, APACHE);
+
+    str(_field_, HOST, "expected host");
+    str(_field_, IDENT, "expected ident");
+    str(_field_, USER, "expected user");
+    str(_bracketed_, TIME, "expected [time]");
+
+    expect(QUOTE);
+    str(_field_, METHOD, "expected method");
+    str(_field_, PATH, "expected path");
+    str(_field_, PROTOCOL, "expected protocol");
+    expect(QUOTE);
+
+    num(STATUS, "expected status");
+    if (accept(DASH))
+        uusink_int(&sink, SIZE, 0);
+    else
+        num(SIZE, "expected size");
+
+    if (accept(_quoted_, &s)) {
+        uusink_str(&sink, REFERER, s.p, s.len);
+        str(_quoted_, AGENT, "expected user agent");
+    }
+}
+
+void
+line()
+{
+    // syslog lines start with <pri> or the month
+    if (accept(LT) || accept(_month_)) {
+        uu.lp = uu.line;
+        syslog_line();
+    } else
+        apache_line();
+    expect(EOL, NULL, "expected end of line");
+    uusink_row(&sink);
+}
+
+// checkpoint of the counts to done: if the interval is up, or now
+void
+checkpoint(bool now)
+{
+    static bool failed;
+
+    if (!(now? uuckpt_write : uuckpt_commit)(&ck, chunk, chunkoff, done) && !failed) {
+        failed = true;  // once, the next ones are likely to fail the same way
+        fprintf(stderr, "logline: %s: %s\n", ckpath, strerror(errno));
+    }
+}
+
+void
+stopping(int sig)
+{
+    stop = 1;
+}
+
+// analysis, on each batch of columns as an Arrow struct array
+
+void
+tally(struct uusink *s)
+{
+    struct ArrowArray *batch;
+    struct ArrowSchema *schema;
+
+    uusink_arrow(s, &batch, &schema);
+
+    const int64_t *kind = batch->children[KIND]->buffers[1];
+    const int64_t *status = batch->children[STATUS]->buffers[1];
+    const int64_t *size = batch->children[SIZE]->buffers[1];
+
+    for (int64_t i = 0; i < batch->length; ++i)
+        if (kind[i] == SYSLOG)
+            ++count.syslog;
+        else {
+            ++count.apache;
+            ++count.status[status[i] / 100 % 6];
+            count.bytes += size[i];
+        }
+
+    batch->release(batch);
+    schema->release(schema);
+    if (ckpath)
+        checkpoint(false);
+}
+
+// sscanf() equivalent of line() for comparison
+
+int
+scanf_line(char *lp)
+{
+    char host[256], ident[64], user[64], time[64], method[16], path[2048], proto[16];
+    char tag[64], mon[4];
+    int n, status, size, day, hh, mm, ss;
+
+    if (lp[0] == '<' || (isupper(lp[0]) && lp[3] == ' ')) {
+        if (lp[0] == '<' && (lp = strchr(lp, '>')) == NULL)
+            return 0;
+        if (*lp == '>')
+            ++lp;
+        if (sscanf(lp, "%3s %d %d:%d:%d %255s %63[^[:]%n", mon, &day, &hh, &mm, &ss,
+                   host, tag, &n) < 7)
+            return 0;
+        ++count.syslog;
+    } else {
+        if (sscanf(lp, "%255s %63s %63s [%63[^]]] \"%15s %2047s %15[^\"]\" %d %d",
+                   host, ident, user, time, method, path, proto, &status, &size) < 8)
+            return 0;
+        ++count.apache;
+    }
+    return 1;
+}
+
+// input
+
+// next chunk of fp's whole lines, *len bytes NUL terminated: up to max (0:
+// all of the input), more if one line is longer; NULL at the end of input
+char *
+readchunk(FILE *fp, size_t max, size_t *len)
+{
+    static char *buf, saved;
+    static size_t sz, have, used;  // bytes in buf, of them in the last chunk
+    char *nl = NULL;
+    size_t n, want;
+
+    if (buf) {
+        buf[used] = saved;
+        memmove(buf, buf + used, have -= used);
+    }
+    for (;;) {
+        if (max && have >= max) {   // to the last newline within max, or the first after
+            for (nl = buf + max; nl > buf && nl[-1] != '\n'; --nl)
+                ;
+            if ((nl = nl > buf? nl - 1 : (char *)memchr(buf + max, '\n', have - max)) != NULL)
+                break;
+        }
+        if (have + 1 >= sz && (buf = realloc(buf, sz = sz? sz * 2 : max? max + 1 : 1 << 20)) == NULL) {
+            perror("logline");
+            exit(1);
+        }
+        want = sz - have - 1;
+        if (max && have < max && want > max - have)
+            want = max - have;
+        if ((n = fread(buf + have, 1, want, fp)) == 0)
+            break;
+        have += n;
+    }
+    if (nl == NULL && have == 0)
+        return NULL;
+    used = nl? (size_t)(nl + 1 - buf) : have;
+    saved = buf[used];
+    buf[used] = '\0';
+    *len = used;
+    return buf;
+}
+
+int
+main(int argc, char **argv)
+{
+    FILE *fp = stdin;
+    size_t len = 0, n, bytes = 0;
+    long nlines = 0;
+    char **lines = NULL, *buf;
+    static long i; // survives the uuerror longjmp
+    bool compare = false;
+    double t = 0, t0, interval = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "ck:K:")) != -1)
+        switch (opt) {
+        case 'c': compare = true; break;
+        case 'k': ckpath = optarg; break;
+        case 'K': interval = atof(optarg); break;
+        default:
+usage:
+            fprintf(stderr, "usage: logline [-c] [-k checkpoint [-K seconds]] [file]\n");
+            return 1;
+        }
+    if (compare && ckpath)
+        goto usage;     // -c times the whole input in memory
+    if (optind < argc && (fp = fopen(argv[optind], "r")) == NULL) {
+        perror(argv[optind]);
+        return 1;
+    }
+
+    if (ckpath) {
+        if (!uuckpt_init(&ck, ckpath, &count, sizeof count, interval)) {
+            perror(ckpath);
+            return 1;
+        }
+        switch (uuckpt_resume(&ck, fp)) {
+        case -1:
+            fprintf(stderr, "logline: %s: %s\n", ckpath, ck.error);
+            return 1;
+        case 1:
+            fprintf(stderr, "logline: resuming after line %ld, at byte %llu\n",
+                    count.lines, (unsigned long long)ck.offset);
+        }
+        chunkoff = ck.offset;
+        signal(SIGINT, stopping);
+        signal(SIGTERM, stopping);
+    }
+
+    while (!stop && (buf = readchunk(fp, ckpath? CHUNK : 0, &n)) != NULL) {
+        chunkoff += len;        // past the chunk before
+        chunk = done = buf;
+        len = n;
+        free(lines);
+        lines = splitlines(chunk, &nlines);
+        if (!uusink_init(&sink, cols, NCOLS, BATCH, chunk, len, tally)) {
+            perror("logline");
+            return 1;
+        }
+
+        t0 = now();
+        i = 0;
+        on_uuerror {
+            if (count.errors++ < 10)
+                fprintf(stderr, "logline: line %ld: %s\n", count.lines, uu.msg);
+            uusink_drop(&sink);
+            ++i;
+        }
+
+        for (; i < nlines && !stop; ++i) {
+            done = i + 1 < nlines? lines[i + 1] : chunk + len;
+            ++count.lines;
+            uu.lp = uu.line = lines[i];
+            line();
+        }
+        uusink_end(&sink);
+        t += now() - t0;
+        bytes += done - chunk;
+    }
+    if (ckpath) {
+        checkpoint(true);
+        fprintf(stderr, "logline: %ld checkpoints, the last at byte %llu\n", ck.writes,
+                (unsigned long long)ck.offset);
+    }
+
+    printf("%ld lines: %ld apache, %ld syslog, %ld errors; "
+           "status 2xx %ld 3xx %ld 4xx %ld 5xx %ld; %lld bytes sent\n",
+           count.lines, count.apache, count.syslog, count.errors,
+           count.status[2], count.status[3], count.status[4], count.status[5], count.bytes);
+    fprintf(stderr, "uuscan: %zu bytes in %.3fs, %.1f MB/s\n", bytes, t, t > 0? bytes / t / 1e6 : 0);
+
+    if (compare) {
+        long ok = 0;
+        t = now();
+        for (i = 0; i < nlines; ++i)
+            ok += scanf_line(lines[i]);
+        t = now() - t;
+        fprintf(stderr, "sscanf: %zu bytes in %.3fs, %.1f MB/s (%ld lines matched)\n",
+                bytes, t, bytes / t / 1e6, ok);
+    }
+
+    return count.errors != 0;
+}
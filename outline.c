@@ -0,0 +1,181 @@
+// outline.c - indentation-structured input with INDENT, DEDENT and NEWLINE
+// compile: cc -O2 -o outline outline.c
+//
+// outline [-n mbytes] [file]
+//
+// parses a Python-style outline of keys, each either with a value on its line
+// or opening a block of deeper indented entries, counts entries, blocks and
+// the deepest nesting and reports the throughput (best of 5). without a file,
+// -n megabytes (default 64) of outline are generated, nested up to 16 deep at
+// 4 spaces a level, so most of a line is indentation.
+
+// file:
+//      { NEWLINE } { entry }
+// entry:
+//      key ":" value NEWLINE
+//      | key ":" NEWLINE INDENT entry { entry } DEDENT
+// value:
+//      text to end of line
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+
+#define UUINDENT
+#define UUTERMINALS X(_key_) X(_value_)
+
+#include "uuscan.h"
+#include "bench.h"
+
+#define COLON   CHAR(':')
+#define EOL     CHAR('\0')
+
+// terminal scanners:
+
+UUDEFINE(_key_)
+{
+    if (!isalpha(*lp) && *lp != '_')
+        return fail(lp);
+    while (isalnum(*lp) || *lp == '_' || *lp == '-' || *lp == '.')
+        ++lp;
+    return success(lp);
+}
+
+UUDEFINE(_value_)
+{
+    char *end = strchr(lp, '\n');
+
+    if (end == NULL)
+        end = lp + strlen(lp);
+    while (end > lp && isspace(end[-1]))
+        --end;
+    if (end == lp)
+        return fail(lp);
+    return success(end);
+}
+
+// parser:
+
+struct {
+    long entries, blocks;
+    int depth, maxdepth;
+} count;
+
+void
+entry()
+{
+    expect(_key_, NULL, "expected key");
+    expect(COLON);
+    ++count.entries;
+
+    if (accept(_value_)) {
+        expect(NEWLINE, NULL, "expected end of line");
+        return;
+    }
+
+    expect(NEWLINE, NULL, "expected value or end of line");
+    expect(INDENT, NULL, "expected indented block");
+    ++count.blocks;
+    if (++count.depth > count.maxdepth)
+        count.maxdepth = count.depth;
+    do
+        entry();
+    while (!accept(DEDENT));
+    --count.depth;
+}
+
+void
+file()
+{
+    while (accept(NEWLINE))
+        ;
+    while (!accept(EOL))
+        entry();
+}
+
+// input:
+
+// size bytes of outline
+char *
+generate(size_t size)
+{
+    static char *keys[] = {
+        "name", "port", "host", "timeout", "retries", "path", "user",
+        "enabled", "level", "format", "max-size", "backend.url",
+    };
+    char *buf = malloc(size + 256), *cp = buf;
+    int depth = 0;
+
+    if (buf == NULL) {
+        perror("outline");
+        exit(1);
+    }
+    while (cp < buf + size) {
+        cp += sprintf(cp, "%*s%s:", depth * 4, "", keys[rnd(sizeof keys / sizeof keys[0])]);
+        if (depth < 15 && rnd(3) == 0) {
+            *cp++ = '\n';
+            ++depth;
+            cp += sprintf(cp, "%*s%s: %u\n", depth * 4, "", keys[rnd(4)], rnd(10000));
+        } else
+            cp += sprintf(cp, " %u\n", rnd(100000));
+        if (rnd(8) == 0)
+            *cp++ = '\n';
+        if (depth > 0 && rnd(4) == 0)
+            depth -= 1 + rnd(depth);
+    }
+    *cp = '\0';
+    return buf;
+}
+
+int
+main(int argc, char **argv)
+{
+    size_t size = 64 << 20, len;
+    double best = 0;
+    char *buf;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:")) != -1)
+        switch (opt) {
+        case 'n': size = (size_t)atoi(optarg) << 20; break;
+        default:
+            fprintf(stderr, "usage: outline [-n mbytes] [file]\n");
+            return 1;
+        }
+    if (optind < argc) {
+        FILE *fp = fopen(argv[optind], "r");
+        if (fp == NULL) {
+            perror(argv[optind]);
+            return 1;
+        }
+        buf = readall(fp, &len);
+    } else {
+        buf = generate(size);
+        len = strlen(buf);
+    }
+
+    on_uuerror {
+        char *at = uu.lpfail > uu.lp? uu.lpfail : uu.lp;
+        int line = 1;
+        for (char *cp = uu.line; cp < at; ++cp)
+            line += *cp == '\n';
+        fprintf(stderr, "outline: line %d: %s\n", line, uu.msg);
+        return 1;
+    }
+
+    for (int run = 0; run < 5; ++run) {
+        double t = now();
+
+        memset(&count, 0, sizeof count);
+        uu.lp = uu.line = buf;
+        uuindentinit();
+        file();
+        t = now() - t;
+        keepbest(&best, t);
+    }
+
+    printf("%ld entries, %ld blocks, depth %d\n", count.entries, count.blocks, count.maxdepth);
+    printf("%zu bytes in %.3fs, %.1f MB/s\n", len, best, len / best / 1e6);
+    return 0;
+}
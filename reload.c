@@ -0,0 +1,365 @@
+// reload.c - parser threads looking names up in a table reloaded under them
+// compile: cc -O2 -pthread -o reload reload.c
+//
+// reload [-t threads] [-s seconds] [-i interval_us]
+//
+// each parser thread parses its own generated command lines, looking up every
+// command and function name in the command table, while a reload thread
+// builds and swaps in a new table every -i microseconds (default 100): the
+// same names with a new version number and a rotating set of extra commands.
+// three ways of sharing the table are run for -s seconds (default 1) each
+// with -t parser threads (default 4):
+//
+//      static      one table, never reloaded
+//      snapshot    uusnap.h: uusnap_get() per line, uusnap_quiescent() after it
+//      rwlock      read lock held over each line, write lock to swap
+//
+// every entry carries the version of its table and is overwritten before it
+// is freed, so a line that saw two tables, or a table after it was freed, is
+// counted as a mismatch.
+
+// line:
+//      command { arg }
+// arg:
+//      integer | name [ "(" [ arg { "," arg } ] ")" ]
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+
+#define UUTHREADS
+#define UUTERMINALS X(_name_) X(_int_)
+
+#include "uuscan.h"
+#include "bench.h"
+#include "uusnap.h"
+
+#define LPAREN  CHAR('(')
+#define RPAREN  CHAR(')')
+#define COMMA   CHAR(',')
+#define EOL     CHAR('\0')
+
+// terminal scanners:
+
+UUDEFINE(_name_)
+{
+    if (!isalpha(*lp))
+        return fail(lp);
+    while (isalnum(*lp) || *lp == '_')
+        ++lp;
+    uu.len = lp - uu.lpstart;
+    return success(lp);
+}
+
+UUDEFINE(_int_)
+{
+    if (*lp == '-')
+        ++lp;
+    if (!isdigit(*lp))
+        return fail(lp);
+    while (isdigit(*lp))
+        ++lp;
+    return success(lp);
+}
+
+// command table:
+
+enum { STATIC, SNAPSHOT, RWLOCK };
+
+struct entry {
+    unsigned long version;      // of its table; ~0 once freed
+    int function;               // a function, or a command
+};
+
+static const char *commands[] = {
+    "show", "set", "get", "add", "del", "list", "watch", "stop", "start",
+    "reload", "route", "filter", "limit", "log", "trace", "count",
+};
+static const char *functions[] = {
+    "min", "max", "abs", "len", "now", "env", "hash", "lower",
+};
+#define NCOMMANDS   (int)(sizeof commands / sizeof commands[0])
+#define NFUNCTIONS  (int)(sizeof functions / sizeof functions[0])
+#define NEXTRA      16          // of 64 extra commands, rotating
+
+static struct uusnap *table;
+static pthread_rwlock_t tablelock;
+static int stop;
+
+static void
+release(void *p)
+{
+    struct entry *e = p;
+
+    __atomic_store_n(&e->version, ~0ul, __ATOMIC_RELAXED);
+    free(e);
+}
+
+static struct uusnap *
+build(unsigned long version)
+{
+    struct uusnap_entry e[NCOMMANDS + NFUNCTIONS + NEXTRA];
+    char extra[NEXTRA][16];
+    struct uusnap *s;
+    int n = 0;
+
+    for (int i = 0; i < NCOMMANDS + NFUNCTIONS + NEXTRA; ++i) {
+        struct entry *v = malloc(sizeof *v);
+
+        if (v == NULL) {
+            perror("reload");
+            exit(1);
+        }
+        v->version = version;
+        v->function = i >= NCOMMANDS && i < NCOMMANDS + NFUNCTIONS;
+        if (i < NCOMMANDS)
+            e[n].name = commands[i];
+        else if (v->function)
+            e[n].name = functions[i - NCOMMANDS];
+        else {
+            sprintf(extra[n - NCOMMANDS - NFUNCTIONS], "cmd%lu",
+                    (version * NEXTRA + n) % 64);
+            e[n].name = extra[n - NCOMMANDS - NFUNCTIONS];
+        }
+        e[n++].value = v;
+    }
+    if ((s = uusnap_build(e, n, release)) == NULL) {
+        perror("reload");
+        exit(1);
+    }
+    return s;
+}
+
+// parser, one per thread:
+
+static _Thread_local struct uusnap *snap;       // this line's table
+static _Thread_local unsigned long version;     // and its version, 0 until the first lookup
+static _Thread_local long mismatches;
+
+static void
+lookup(int function)
+{
+    struct entry *e = uusnap_find(snap, uu.lpstart, uu.len);
+
+    if (e == NULL || e->function != function)
+        uuerror("unknown %s at pos %d", function? "function" : "command",
+                (int)(uu.lpstart - uu.line));
+    if (version == 0)
+        version = e->version;
+    else if (e->version != version)
+        ++mismatches;
+}
+
+void
+arg()
+{
+    if (accept(_int_))
+        return;
+    expect(_name_, NULL, "argument");
+    if (!accept(LPAREN))
+        return;
+    lookup(1);
+    if (!accept(RPAREN)) {
+        do
+            arg();
+        while (accept(COMMA));
+        expect(RPAREN);
+    }
+}
+
+void
+line()
+{
+    expect(_name_, NULL, "command");
+    lookup(0);
+    while (!accept(EOL))
+        arg();
+}
+
+// input:
+
+#define NLINES  4096
+
+// NLINES NUL terminated lines, then an empty one
+static char *
+generate()
+{
+    char *buf = malloc(NLINES * 128 + 1), *cp = buf;
+
+    if (buf == NULL) {
+        perror("reload");
+        exit(1);
+    }
+    for (int i = 0; i < NLINES; ++i) {
+        cp += sprintf(cp, "%s", commands[rnd(NCOMMANDS)]);
+        for (int nargs = 1 + rnd(4); nargs > 0; --nargs)
+            switch (rnd(3)) {
+            case 0: cp += sprintf(cp, " %u", rnd(100000)); break;
+            case 1: cp += sprintf(cp, " host%u", rnd(100)); break;
+            case 2: {
+                const char *f = functions[rnd(NFUNCTIONS)];
+                cp += sprintf(cp, " %s(x, %s(%u))", f, functions[rnd(NFUNCTIONS)], rnd(10));
+                break;
+            }
+            }
+        *cp++ = '\0';
+    }
+    *cp = '\0';
+    return buf;
+}
+
+struct worker {
+    pthread_t tid;
+    int mode;
+    char *input;
+    long lines, errors, mismatches;
+};
+
+static void *
+parse(void *arg)
+{
+    struct worker *w = arg;
+    char *volatile cp = w->input;
+    volatile int locked = 0;
+
+    if (w->mode == SNAPSHOT && !uusnap_register()) {
+        fprintf(stderr, "reload: too many readers\n");
+        exit(1);
+    }
+
+    on_uuerror {
+        ++w->errors;
+        if (locked)
+            pthread_rwlock_unlock(&tablelock);
+        locked = 0;
+        goto next;
+    }
+
+    while (!__atomic_load_n(&stop, __ATOMIC_RELAXED)) {
+        version = 0;
+        switch (w->mode) {
+        case STATIC:   snap = table; break;
+        case SNAPSHOT: snap = uusnap_get(&table); break;
+        case RWLOCK:   pthread_rwlock_rdlock(&tablelock); locked = 1; snap = table; break;
+        }
+        uu.lp = uu.line = cp;
+        line();
+        if (locked)
+            pthread_rwlock_unlock(&tablelock);
+        locked = 0;
+        ++w->lines;
+next:
+        if (w->mode == SNAPSHOT)
+            uusnap_quiescent();
+        cp += strlen(cp) + 1;
+        if (*cp == '\0')
+            cp = w->input;
+    }
+    w->mismatches = mismatches;
+    if (w->mode == SNAPSHOT)
+        uusnap_unregister();
+    return NULL;
+}
+
+// reloads until stop, returns the number of tables published
+static long
+reloader(int mode, long interval, long *freed)
+{
+    struct timespec ts = { interval / 1000000, interval % 1000000 * 1000 };
+    unsigned long v = 1;
+
+    while (!__atomic_load_n(&stop, __ATOMIC_RELAXED)) {
+        struct uusnap *s = build(++v), *old;
+
+        if (mode == SNAPSHOT)
+            *freed += uusnap_publish(&table, s);
+        else {
+            pthread_rwlock_wrlock(&tablelock);
+            old = table;
+            table = s;
+            pthread_rwlock_unlock(&tablelock);
+            uusnap_free(old);
+            ++*freed;
+        }
+        nanosleep(&ts, NULL);
+    }
+    return v - 1;
+}
+
+static void *
+timer(void *arg)
+{
+    usleep(*(long *)arg);
+    __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+int
+main(int argc, char **argv)
+{
+    static const char *modes[] = { "static", "snapshot", "rwlock" };
+    int nthreads = 4, opt;
+    long seconds = 1, interval = 100;
+
+    while ((opt = getopt(argc, argv, "t:s:i:")) != -1)
+        switch (opt) {
+        case 't': nthreads = atoi(optarg); break;
+        case 's': seconds = atol(optarg); break;
+        case 'i': interval = atol(optarg); break;
+        default:
+            fprintf(stderr, "usage: reload [-t threads] [-s seconds] [-i interval_us]\n");
+            return 1;
+        }
+    if (nthreads < 1 || nthreads > UUSNAP_READERS - 1 || seconds < 1 || interval < 1) {
+        fprintf(stderr, "reload: bad option\n");
+        return 1;
+    }
+
+    // writers first, or a stream of readers keeps the reloads out
+    pthread_rwlockattr_t attr;
+    pthread_rwlockattr_init(&attr);
+    pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    pthread_rwlock_init(&tablelock, &attr);
+
+    struct worker *w = calloc(nthreads, sizeof *w);
+    for (int i = 0; i < nthreads; ++i)
+        w[i].input = generate();
+
+    printf("%d threads, %lds per mode, reload every %ldus\n", nthreads, seconds, interval);
+    for (int mode = STATIC; mode <= RWLOCK; ++mode) {
+        long lines = 0, errors = 0, mismatch = 0, reloads = 0, freed = 0;
+        long usec = seconds * 1000000;
+        pthread_t t;
+
+        __atomic_store_n(&stop, 0, __ATOMIC_RELAXED);
+        table = build(1);
+        for (int i = 0; i < nthreads; ++i) {
+            w[i].mode = mode;
+            w[i].lines = w[i].errors = w[i].mismatches = 0;
+            pthread_create(&w[i].tid, NULL, parse, &w[i]);
+        }
+        pthread_create(&t, NULL, timer, &usec);
+        if (mode == STATIC)
+            pthread_join(t, NULL);
+        else {
+            reloads = reloader(mode, interval, &freed);
+            pthread_join(t, NULL);
+        }
+        for (int i = 0; i < nthreads; ++i) {
+            pthread_join(w[i].tid, NULL);
+            lines += w[i].lines;
+            errors += w[i].errors;
+            mismatch += w[i].mismatches;
+        }
+        if (mode == SNAPSHOT)
+            freed += uusnap_synchronize();
+        uusnap_free(table);
+
+        printf("%-8s  %6.2f Mlines/s  %6ld reloads  %6ld freed  %ld errors  %ld mismatches\n",
+               modes[mode], lines / (double)seconds / 1e6, reloads, freed, errors, mismatch);
+    }
+    return 0;
+}
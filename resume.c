@@ -0,0 +1,357 @@
+// resume.c - a long filter validated at every keystroke, resumed from checkpoints
+// compile: cc -O2 -o resume resume.c
+//
+// resume [-n chars]
+//
+// a filter of about -n chars (default 4096) is typed one keystroke at a
+// time, with a mistyped char and a backspace now and then, and the line is
+// validated after each keystroke as an editor would under the cursor: parsed
+// from the start with uuparse(), and with uuresume() from the last checkpoint
+// before the keystroke. the rules build the filter's tree in an arena whose
+// top is uu.arena, so a resumed parse drops what was built past its
+// checkpoint. the status, message and tree of every keystroke are compared
+// between the two; the mean time per keystroke is reported by line length,
+// best of 3. then the line is edited at random points and compared again.
+
+// filter:
+//      "where" cond
+// cond:
+//      conjunct { "or" conjunct }
+// conjunct:
+//      factor { "and" factor }
+// factor:
+//      "not" factor | "(" cond ")" | name op value
+// op:
+//      "<=" | ">=" | "!=" | "=" | "<" | ">"
+// value:
+//      integer | string | name
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+
+#define UURESUME
+#define UUTERMINALS X(_name_) X(_int_) X(_string_)
+
+#include "uuscan.h"
+#include "bench.h"
+
+#define LPAREN  CHAR('(')
+#define RPAREN  CHAR(')')
+
+// terminal scanners:
+
+UUDEFINE(_name_)
+{
+    if (!isalpha(*lp))
+        return fail(lp);
+    while (isalnum(*lp) || *lp == '_' || *lp == '.')
+        ++lp;
+    return success(lp);
+}
+
+UUDEFINE(_int_)
+{
+    if (*lp == '-')
+        ++lp;
+    if (!isdigit(*lp))
+        return fail(lp);
+    while (isdigit(*lp))
+        ++lp;
+    return success(lp);
+}
+
+UUDEFINE(_string_)
+{
+    if (*lp != '"')
+        return fail(lp);
+    for (++lp; *lp != '"'; ++lp)
+        if (*lp == '\0')
+            return fail(lp, "unterminated string");
+    return success(lp + 1);
+}
+
+// the tree, in an arena: nodes past uu.arena are free
+
+enum { OR, AND, NOT, CMP };
+
+struct node {
+    int kind;
+    int a, b;                   // operands; CMP: field and value offsets
+    int op;                     // CMP: index in ops
+};
+
+#define MAXNODES    8192
+
+static struct node *arena;      // the parse's: one for each way of parsing
+
+static int
+node(int kind, int a, int b)
+{
+    if (uu.arena == MAXNODES)
+        uuerror("filter too long at pos %d", (int)(uu.lp - uu.line) + 1);
+    arena[uu.arena] = (struct node){ kind, a, b, 0 };
+    return uu.arena++;
+}
+
+// the grammar:
+
+static const char *ops[] = { "<=", ">=", "!=", "=", "<", ">" };
+
+int cond();
+
+int
+factor()
+{
+    int n, field;
+
+    if (accept("not"))
+        return node(NOT, factor(), -1);
+    if (accept(LPAREN)) {
+        n = cond();
+        expect(RPAREN);
+        return n;
+    }
+    expect(_name_, NULL, "field");
+    field = uu.lpstart - uu.line;
+    for (int i = 0; ; ++i)
+        if (i == (int)(sizeof ops / sizeof ops[0]))
+            uuerror("expected comparison at pos %d", uuerrorpos());
+        else if (accept(ops[i])) {
+            n = node(CMP, field, 0);
+            arena[n].op = i;
+            break;
+        }
+    if (!accept(_int_) && !accept(_string_))
+        expect(_name_, NULL, "value");
+    arena[n].b = uu.lpstart - uu.line;
+    return n;
+}
+
+int
+conjunct()
+{
+    int n = factor();
+
+    while (accept("and"))
+        n = node(AND, n, factor());
+    return n;
+}
+
+int
+cond()
+{
+    int n = conjunct();
+
+    while (accept("or"))
+        n = node(OR, n, conjunct());
+    return n;
+}
+
+bool
+filter(void *res)
+{
+    if (!accept("where"))
+        return false;
+    *(int *)res = cond();
+    return true;
+}
+
+static unsigned long
+hash(int n)
+{
+    const struct node *p = &arena[n];
+    unsigned long h = p->kind * 31 + p->op;
+
+    if (p->kind == CMP)
+        return h * 1000003 + p->a * 7919 + p->b;
+    h = h * 1000003 + hash(p->a);
+    return p->kind == NOT? h : h * 1000003 + hash(p->b);
+}
+
+// input:
+
+static const char *fields[] = {
+    "status", "host", "user.name", "latency_ms", "region", "bytes", "path",
+    "method", "code", "client.ip", "retries", "tier",
+};
+static const char *words[] = {
+    "\"GET\"", "\"/api/v2/items\"", "eu_west", "\"timeout\"", "gold", "200",
+    "404", "-1", "1500", "\"alice\"", "idle", "65536",
+};
+#define NFIELDS (int)(sizeof fields / sizeof fields[0])
+#define NWORDS  (int)(sizeof words / sizeof words[0])
+
+static char *
+gencond(char *cp, int depth)
+{
+    int n = 1 + rnd(3);
+
+    for (int i = 0; i < n; ++i) {
+        if (i)
+            cp += sprintf(cp, rnd(3)? " and " : " or ");
+        if (rnd(5) == 0)
+            cp += sprintf(cp, "not ");
+        if (depth < 4 && rnd(3) == 0) {
+            *cp++ = '(';
+            cp = gencond(cp, depth + 1);
+            *cp++ = ')';
+        } else
+            cp += sprintf(cp, "%s %s %s", fields[rnd(NFIELDS)], ops[rnd(6)], words[rnd(NWORDS)]);
+    }
+    return cp;
+}
+
+static char *
+generate(int chars)
+{
+    char *buf = malloc(chars + 1024), *cp = buf;
+
+    if (buf == NULL) {
+        perror("resume");
+        exit(1);
+    }
+    cp += sprintf(cp, "where ");
+    while (cp - buf < chars) {
+        if (cp - buf > 6)
+            cp += sprintf(cp, " and ");
+        cp = gencond(cp, 0);
+    }
+    *cp = '\0';
+    return buf;
+}
+
+static struct node fullnodes[MAXNODES], resumenodes[MAXNODES];
+static struct uuresume *r;
+static int root;
+static long validations, mismatches;
+
+// the line both ways; times in t[0] (uuparse) and t[1] (uuresume)
+static void
+validate(const char *line, int len, double *t)
+{
+    char msg[2][80];
+    int status[2];
+    unsigned long h[2] = { 0, 0 };
+    double t0;
+
+    arena = fullnodes;
+    uu.arena = 0;
+    t0 = now();
+    status[0] = uuparse(msg[0], line, len, filter, &root);
+    t[0] = now() - t0;
+    if (status[0] == UUPARSE_OK || status[0] == UUPARSE_TRAILING)
+        h[0] = hash(root);
+
+    arena = resumenodes;
+    t0 = now();
+    status[1] = uuresume(r, msg[1], line, len);
+    t[1] = now() - t0;
+    if (status[1] == UUPARSE_OK || status[1] == UUPARSE_TRAILING)
+        h[1] = hash(root);
+
+    ++validations;
+    if (status[0] != status[1] || h[0] != h[1]
+            || (status[0] == UUPARSE_ERROR && strcmp(msg[0], msg[1]) != 0)) {
+        if (mismatches++ < 5)
+            printf("differ at %d chars: %d %s / %d %s\n", len, status[0],
+                   status[0] == UUPARSE_ERROR? msg[0] : "", status[1],
+                   status[1] == UUPARSE_ERROR? msg[1] : "");
+    }
+}
+
+#define NBUCKETS    16          // by line length, 256 chars each
+
+static double sum[2][NBUCKETS];
+static int count[NBUCKETS], keys, resumed;
+
+static void
+keystroke(const char *line, int len)
+{
+    int b = len / 256 < NBUCKETS? len / 256 : NBUCKETS - 1;
+    double t[2];
+
+    validate(line, len, t);
+    sum[0][b] += t[0];
+    sum[1][b] += t[1];
+    ++count[b];
+    resumed += r->from > 0;
+    ++keys;
+}
+
+int
+main(int argc, char **argv)
+{
+    int chars = 4096, opt;
+    double best[2][NBUCKETS];
+    char *target, *line;
+
+    while ((opt = getopt(argc, argv, "n:")) != -1)
+        switch (opt) {
+        case 'n': chars = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: resume [-n chars]\n");
+            return 1;
+        }
+
+    target = generate(chars);
+    chars = strlen(target);
+    if ((line = malloc(chars + 2)) == NULL || (r = uuresume_new(filter, &root)) == NULL) {
+        perror("resume");
+        return 1;
+    }
+
+    for (int run = 0; run < 3; ++run) {
+        unsigned long long seed = rng;
+
+        memset(sum, 0, sizeof sum);
+        memset(count, 0, sizeof count);
+        keys = resumed = 0;
+        for (int len = 0; len < chars; ) {
+            if (len > 0 && rnd(20) == 0) {
+                line[len] = 'a' + rnd(26);      // a typo, then backspace
+                keystroke(line, len + 1);
+                keystroke(line, len);
+            }
+            line[len] = target[len];
+            keystroke(line, ++len);
+        }
+        for (int b = 0; b < NBUCKETS; ++b)
+            for (int i = 0; i < 2; ++i)
+                if (run == 0 || sum[i][b] < best[i][b])
+                    best[i][b] = sum[i][b];
+        rng = seed;
+    }
+
+    printf("%d chars, %d keystrokes, %d resumed, best of 3\n", chars, keys, resumed);
+    printf("  length     uuparse    uuresume\n");
+    for (int b = 0; b < NBUCKETS; ++b)
+        if (count[b])
+            printf("%5d-%-5d %7.2fus %9.2fus\n", b * 256, b * 256 + 255,
+                   best[0][b] / count[b] * 1e6, best[1][b] / count[b] * 1e6);
+    printf("%d checkpoints, %zu bytes of stack kept (%zu each)\n", r->n, r->used,
+           r->n? r->used / r->n : 0);
+
+    // edits anywhere in the line: a char replaced, inserted or deleted
+    memcpy(line, target, chars + 1);
+    for (int i = 0, len = chars; i < 2000; ++i) {
+        int at = rnd(len), what = rnd(3);
+        double t[2];
+
+        if (what == 0)
+            line[at] = target[rnd(chars)];
+        else if (what == 1 && len <= chars) {
+            memmove(line + at + 1, line + at, len - at + 1);
+            line[at] = target[rnd(chars)];
+            ++len;
+        } else if (len > 1) {
+            memmove(line + at, line + at + 1, len - at);
+            --len;
+        }
+        validate(line, len, t);
+    }
+    printf("%ld of %ld validations differ\n", mismatches, validations);
+    uuresume_free(r);
+    return mismatches != 0;
+}
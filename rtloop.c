@@ -0,0 +1,388 @@
+// rtloop.c - plant commands parsed in a control loop, with no heap and bounded work
+// compile: cc -O2 -o rtloop rtloop.c
+//
+// rtloop [-n lines]
+//
+// uuscan.h is compiled with -DUUSTATIC: its keyword tries, conversion cache
+// and action queue are fixed pools, and malloc, calloc, realloc and free are
+// poisoned before it is included, so a heap call left in it would not
+// compile. they are also wrapped here to count the calls made while the loop
+// runs, by anything, which must be none. the loop parses -n generated lines
+// (default 200000) with uuparse(), one a tick: each is a few commands to the
+// plant, queued as actions and applied once the line has parsed. some lines
+// overflow the action queue or the line buffer and must fail the same way
+// each time. each line is timed, and its time per input byte; then each
+// primitive is timed on inputs that cost it the most per byte.
+
+// line:
+//      command { ";" command }
+// command:
+//      "set" device index "position" number
+//    | "ramp" device index "to" number "over" integer
+//    | "stop" ( device index | "all" )
+//    | "hold" integer
+// device:
+//      "valve" | "pump" | "heater" | "fan" | "damper"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "bench.h"      // before the poison: its readall() and splitlines() allocate,
+                        // but the loop calls neither
+
+// every heap call in the process, counted
+
+extern void *__libc_malloc(size_t);
+extern void *__libc_calloc(size_t, size_t);
+extern void *__libc_realloc(void *, size_t);
+extern void __libc_free(void *);
+
+static long heapcalls;
+
+void *malloc(size_t n)              { ++heapcalls; return __libc_malloc(n); }
+void *calloc(size_t n, size_t size) { ++heapcalls; return __libc_calloc(n, size); }
+void *realloc(void *p, size_t n)    { ++heapcalls; return __libc_realloc(p, n); }
+void free(void *p)                  { heapcalls += p != NULL; __libc_free(p); }
+
+#pragma GCC poison malloc calloc realloc free
+
+#define UUSTATIC
+#define UUSTATIC_ACTIONS    64
+#define UUSTATIC_LINE       512
+#define UUDEFER
+#define UUCACHE             256
+#define UUTERMINALS X(_index_) X(_number_)
+
+#define UUVAL struct { int i; double d; }
+
+#include "uuscan.h"
+
+#define SEMI    CHAR(';')
+
+// terminal scanners: at most 9 integer and 6 fraction digits, so the
+// conversion is bounded and needs no strtod()
+
+UUDEFINE(_index_)
+{
+    int n = 0;
+
+    if (!isdigit(*lp))
+        return fail(lp);
+    for (int i = 0; isdigit(*lp); ++i, ++lp)
+        if (i == 2)
+            return fail(lp, "index over 99");
+        else
+            n = n * 10 + *lp - '0';
+    uu.i = n;
+    return success(lp);
+}
+
+UUDEFINE(_number_)
+{
+    char *end = lp;
+    double v = 0, scale = 1;
+    int digits;
+
+    for (digits = 0; isdigit(*end); ++end)
+        if (++digits > 9)
+            return fail(end, "too many digits");
+    if (digits == 0)
+        return fail(lp);
+    if (*end == '.') {
+        for (digits = 0, ++end; isdigit(*end); ++end)
+            if (++digits > 6)
+                return fail(end, "too many decimals");
+    }
+    if (uucache_get(_number_, lp, end - lp, &uu.d, sizeof uu.d))
+        return success(end);
+    for (; lp < end && *lp != '.'; ++lp)
+        v = v * 10 + *lp - '0';
+    if (lp < end)
+        while (++lp < end)
+            v += (*lp - '0') * (scale /= 10);
+    uu.d = v;
+    uucache_put(_number_, uu.lpstart, end - uu.lpstart, &uu.d, sizeof uu.d);
+    return success(end);
+}
+
+// the grammar:
+
+static struct uukeyword verbwords[] = {
+    { "set" }, { "ramp" }, { "stop" }, { "hold" },
+};
+static struct uukeyword devicewords[] = {
+    { "valve" }, { "pump" }, { "heater" }, { "fan" }, { "damper" },
+};
+static struct uukeys verbs = UUKEYS("command", verbwords);
+static struct uukeys devices = UUKEYS("device", devicewords);
+
+enum { SET, RAMP, STOP, HOLD };
+#define NDEVICES    5
+
+// the plant
+static double position[NDEVICES][100], target[NDEVICES][100];
+static long holdms, stops;
+
+// a command, kept for its action by the queue position it takes
+struct command {
+    int verb, device, index;
+    double v;
+    int ms;
+};
+static struct command pending[UUSTATIC_ACTIONS];
+
+static void
+apply(void *p, long n)
+{
+    struct command *c = p;
+
+    switch (c->verb) {
+    case SET: position[c->device][c->index] = c->v; break;
+    case RAMP: target[c->device][c->index] = c->v; holdms += c->ms; break;
+    case STOP:
+        if (c->device < 0)
+            ++stops;
+        else
+            target[c->device][c->index] = position[c->device][c->index];
+        break;
+    case HOLD: holdms += c->ms; break;
+    }
+}
+
+static void
+command()
+{
+    struct command c = { 0, -1, 0, 0, 0 };
+
+    expect(&verbs, &c.verb);
+    if (c.verb != HOLD && (c.verb != STOP || !accept("all"))) {
+        expect(&devices, &c.device);
+        expect(_index_, NULL, "expected index");
+        c.index = uu.i;
+    }
+    switch (c.verb) {
+    case SET:
+        expect("position");
+        expect(_number_, NULL, "expected number");
+        c.v = uu.d;
+        break;
+    case RAMP:
+        expect("to");
+        expect(_number_, NULL, "expected number");
+        c.v = uu.d;
+        expect("over");
+        /* fall through */
+    case HOLD:
+        expect(_index_, NULL, "expected milliseconds");
+        c.ms = uu.i;
+        break;
+    }
+    if (uu.nactions < UUSTATIC_ACTIONS)
+        pending[uu.nactions] = c;
+    uudefer(apply, &pending[uu.nactions], 0);
+}
+
+bool
+line(void *res)
+{
+    do
+        command();
+    while (accept(SEMI));
+    return true;
+}
+
+// input:
+
+#define MAXLINES    1000000
+
+static char input[64 << 20];
+static char *lines[MAXLINES];
+static int lens[MAXLINES];
+static double lat[MAXLINES], perbyte[MAXLINES];
+
+static const char *verbabbrev[] = { "set", "se", "ramp", "ra", "stop", "st", "hold", "h" };
+static const char *deviceabbrev[] = { "valve", "v", "pump", "pu", "heater", "h", "fan", "f", "damper", "d" };
+
+static int
+generate(char *cp, int i)
+{
+    char *start = cp;
+    int n = 1 + rnd(4);
+
+    if (i % 5000 == 4999) {                     // more actions than the queue holds
+        for (int c = 0; c <= UUSTATIC_ACTIONS; ++c)
+            cp += sprintf(cp, c? ";h %u" : "h %u", rnd(10));
+        n = 0;
+    }
+    for (int c = 0; c < n; ++c) {
+        int verb = rnd(4);
+
+        if (c)
+            cp += sprintf(cp, rnd(2)? "; " : ";");
+        cp += sprintf(cp, "%s", verbabbrev[verb * 2 + rnd(2)]);
+        if (verb == HOLD) {
+            cp += sprintf(cp, " %u", rnd(100));
+            continue;
+        }
+        if (verb == STOP && rnd(4) == 0) {
+            cp += sprintf(cp, " all");
+            continue;
+        }
+        cp += sprintf(cp, " %s %u", deviceabbrev[rnd(NDEVICES) * 2 + rnd(2)], rnd(100));
+        if (verb == SET)
+            cp += sprintf(cp, " position %u.%u", rnd(100), rnd(1000));
+        else if (verb == RAMP)
+            cp += sprintf(cp, " to %u over %u", rnd(100), rnd(100));
+    }
+    if (i % 5000 == 2499) {
+        memset(cp, ' ', UUSTATIC_LINE);         // longer than the line buffer
+        cp += UUSTATIC_LINE;
+    }
+    if (i % 1000 == 777)
+        cp += sprintf(cp, "; ramp fan 3 to");   // an error of the grammar's
+    *cp = '\0';
+    return cp - start;
+}
+
+static int
+cmp(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y? -1 : x > y;
+}
+
+// the errors seen, distinct but for their position
+static char errors[8][80];
+static long errorcount[8];
+static int nerrors;
+
+static void
+tally(char *msg)
+{
+    char *at = strstr(msg, " at pos");
+    int i;
+
+    if (at)
+        *at = '\0';
+    for (i = 0; i < nerrors; ++i)
+        if (strcmp(errors[i], msg) == 0)
+            break;
+    if (i == nerrors && nerrors < 8)
+        strcpy(errors[nerrors++], msg);
+    if (i < 8)
+        ++errorcount[i];
+}
+
+// the primitives, each on the input that costs it the most per byte: ns
+// per byte, best and worst over samples of 64 scans
+#define REPS    4000
+
+static char spaces[UUSTATIC_LINE];
+
+static void
+primitive(const char *what, const char *in, int bytes, bool (*scan)(void))
+{
+    double best = 1e9, worst = 0;
+
+    for (int r = 0; r < REPS; ++r) {
+        double t = now();
+
+        for (int i = 0; i < 64; ++i) {
+            uu.lp = uu.line = (char *)in;
+            scan();
+        }
+        t = (now() - t) / 64 / bytes * 1e9;
+        if (t < best)
+            best = t;
+        if (t > worst)
+            worst = t;
+    }
+    printf("  %-30s %4d bytes %7.2f ns/byte best %8.2f worst\n", what, bytes, best, worst);
+}
+
+static bool sp(void)      { skipspace(uu.lp); return true; }
+static bool ch(void)      { return accept(SEMI); }
+static bool lit(void)     { return accept("position"); }
+static bool key(void)     { int i; return accept(&devices, &i); }
+static bool num(void)     { return accept(_number_); }
+static bool err(void)     { char m[80]; return uuparse(m, uu.line, strlen(uu.line), line, NULL); }
+
+int
+main(int argc, char **argv)
+{
+    int n = 200000, opt, ok = 0;
+    long bytes = 0, calls;
+    double total = 0;
+
+    while ((opt = getopt(argc, argv, "n:")) != -1)
+        switch (opt) {
+        case 'n': n = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: rtloop [-n lines]\n");
+            return 1;
+        }
+    if (n < 1 || n > MAXLINES) {
+        fprintf(stderr, "rtloop: 1 to %d lines\n", MAXLINES);
+        return 1;
+    }
+
+    // initialization: the tries are built from their pool here, not on the
+    // first line that uses them
+    if (!uukeys_init(&verbs) || !uukeys_init(&devices)) {
+        fprintf(stderr, "rtloop: keyword pool too small\n");
+        return 1;
+    }
+    for (int i = 0; i < n; ++i) {
+        lines[i] = i? lines[i - 1] + lens[i - 1] + 1 : input;
+        if (lines[i] + 1024 > input + sizeof input) {
+            n = i;
+            break;
+        }
+        bytes += lens[i] = generate(lines[i], i);
+    }
+    printf("%d lines, %ld bytes\n", n, bytes);
+
+    calls = heapcalls;
+    for (int i = 0; i < n; ++i) {
+        char msg[80];
+        double t = now();
+
+        if (uuparse(msg, lines[i], lens[i], line, NULL) == UUPARSE_OK) {
+            uurun();
+            ++ok;
+        } else
+            tally(msg);
+        t = now() - t;
+        total += lat[i] = t;
+        perbyte[i] = t / lens[i];
+    }
+    calls = heapcalls - calls;
+
+    qsort(lat, n, sizeof *lat, cmp);
+    qsort(perbyte, n, sizeof *perbyte, cmp);
+    printf("%d ok, %ld heap calls while parsing\n", ok, calls);
+    for (int i = 0; i < nerrors; ++i)
+        printf("  %6ld x %s\n", errorcount[i], errors[i]);
+    printf("per line: mean %.2fus  p50 %.2fus  p99.9 %.2fus  max %.2fus\n",
+           total / n * 1e6, lat[n / 2] * 1e6, lat[n / 1000 * 999] * 1e6, lat[n - 1] * 1e6);
+    printf("per byte: mean %.2fns  p50 %.2fns  p99.9 %.2fns  max %.2fns\n",
+           total / bytes * 1e9, perbyte[n / 2] * 1e9, perbyte[n / 1000 * 999] * 1e9,
+           perbyte[n - 1] * 1e9);
+    printf("plant: %ld ms held, %ld stops, valve 1 at %.3f\n", holdms, stops, position[0][1]);
+
+    printf("primitives:\n");
+    memset(spaces, ' ', sizeof spaces - 2);
+    spaces[sizeof spaces - 2] = 'x';
+    primitive("skipspace", spaces, sizeof spaces - 1, sp);
+    primitive("char", ";", 1, ch);
+    primitive("literal, last char differs", "positioX", 8, lit);
+    primitive("keyword, longest", "heater", 6, key);
+    primitive("keyword, abbreviated", "h", 1, key);
+    primitive("number, cached", "12.5", 4, num);
+    primitive("number, 16 chars, cached", "123456789.123456", 16, num);
+    primitive("uuerror at the end", "set valve 1 position", 20, err);
+    return calls != 0;
+}
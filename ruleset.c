@@ -0,0 +1,500 @@
+// ruleset.c - a set of example.c expressions as one DAG of shared subexpressions
+// compile: cc -O2 -o ruleset ruleset.c
+//
+// ruleset [-n expressions] [-t ticks] [file]
+//
+// parses every expression, one per line, with the example.c grammar and
+// hash-conses them into a single DAG: equal subexpressions, like the
+// max(a, b) * c in many alert formulas, become one node. each tick gives the
+// variables new values and evaluates every distinct node once, in
+// topological order, then reads off the value of each expression. the same
+// tick is also evaluated expression by expression, walking each one's own
+// tree, and the two must agree on every value and error. without a file,
+// -n expressions (default 20000) are generated from a pool of common terms
+// over 200 variables.
+//
+// errors are those of example.c: a node that divides by zero or overflows
+// fails, and an expression fails with the first failing node in its own
+// evaluation order. rand() calls are never shared; expressions calling it
+// are evaluated but not compared. operands are not reordered, so a + b and
+// b + a are different nodes.
+
+#define main example_main
+#include "example.c"
+#include "bench.h"
+#undef main
+
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+
+enum { N_NUM, N_VAR, N_NEG, N_ADD, N_SUB, N_MUL, N_DIV, N_CALL }; // node ops
+enum { ERR_DIVZERO = 1, ERR_OVERFLOW };
+
+struct node {
+    unsigned char op;
+    unsigned char argc;     // call
+    fnptr_t fn;             // call
+    int a, b;               // operands; number value, variable slot, call first of args[]
+};
+
+struct node *nodes;
+int nnodes, maxnodes;
+int *args, nargs, maxargs;  // call operands, argc node ids each
+
+int *table;                 // hash-consing: node id + 1, 0 for empty
+int tablesz;
+
+struct expr {
+    char *text;
+    int root;
+    int *seq, nseq;         // its own tree, in postorder with repeats
+    bool impure;            // calls rand()
+} *exprs;
+int nexprs;
+
+// variables: a slot per identifier; each tick sets them
+
+#define MAXVARS 1024
+
+char varname[MAXVARS][MAXIDENTLEN+1];
+calc_t vars[MAXVARS];
+int nvars;
+
+int
+var(char *p, int n)
+{
+    char id[MAXIDENTLEN+1];
+
+    strncpy(id, p, n = n>MAXIDENTLEN? MAXIDENTLEN : n);
+    id[n] = '\0';
+    for (int i = 0; i < nvars; ++i)
+        if (strcmp(varname[i], id) == 0)
+            return i;
+    if (nvars == MAXVARS)
+        uuerror("more than %d variables", MAXVARS);
+    strcpy(varname[nvars], id);
+    return nvars++;
+}
+
+//{{{ DAG construction
+
+void *
+grow(void *p, int *max, int need, size_t size)
+{
+    if (need <= *max)
+        return p;
+    while (*max < need)
+        *max = *max? *max * 2 : 1024;
+    if ((p = realloc(p, *max * size)) == NULL) {
+        perror("ruleset");
+        exit(1);
+    }
+    return p;
+}
+
+unsigned
+hashnode(struct node *n, int *av)
+{
+    uint64_t h = n->op * 0x9e3779b97f4a7c15ULL;
+
+    h = (h ^ (uint32_t)n->a) * 0xff51afd7ed558ccdULL;
+    h = (h ^ (uint32_t)n->b) * 0xc4ceb9fe1a85ec53ULL;
+    h ^= (uintptr_t)n->fn;
+    for (int i = 0; i < n->argc; ++i)
+        h = (h ^ (uint32_t)av[i]) * 0xff51afd7ed558ccdULL;
+    return h ^ h >> 32;
+}
+
+bool
+samenode(struct node *m, struct node *n, int *av)
+{
+    if (m->op != n->op || m->fn != n->fn || m->argc != n->argc)
+        return false;
+    if (n->op == N_CALL)
+        return memcmp(&args[m->a], av, n->argc * sizeof *av) == 0;
+    return m->a == n->a && m->b == n->b;
+}
+
+void
+rehash()
+{
+    free(table);
+    tablesz = tablesz? tablesz * 2 : 1 << 16;
+    if ((table = calloc(tablesz, sizeof *table)) == NULL) {
+        perror("ruleset");
+        exit(1);
+    }
+    for (int i = 0; i < nnodes; ++i) {
+        struct node *n = &nodes[i];
+        unsigned h = hashnode(n, n->op == N_CALL? &args[n->a] : NULL);
+        while (table[h & (tablesz - 1)])
+            ++h;
+        table[h & (tablesz - 1)] = i + 1;
+    }
+}
+
+// the node equal to n, made if there is none; a call's operands are av
+int
+node(struct node n, int *av)
+{
+    unsigned h;
+    int *e;
+
+    if (n.op != N_CALL)
+        n.argc = 0, n.fn = NULL;
+    else if (n.fn == fn_rand)
+        n.b = nnodes; // never equal to another
+    if (nnodes * 2 >= tablesz)
+        rehash();
+
+    for (h = hashnode(&n, av); *(e = &table[h & (tablesz - 1)]); ++h)
+        if (samenode(&nodes[*e - 1], &n, av))
+            return *e - 1;
+
+    nodes = grow(nodes, &maxnodes, nnodes + 1, sizeof *nodes);
+    if (n.op == N_CALL) {
+        args = grow(args, &maxargs, nargs + n.argc, sizeof *args);
+        memcpy(&args[nargs], av, n.argc * sizeof *av);
+        n.a = nargs;
+        nargs += n.argc;
+    }
+    nodes[nnodes] = n;
+    *e = nnodes + 1;
+    return nnodes++;
+}
+
+// postorder of the tree under id, repeats and all, appended to x->seq
+void
+flatten(struct expr *x, int id, int *max)
+{
+    struct node *n = &nodes[id];
+
+    switch (n->op) {
+    case N_NEG:
+        flatten(x, n->a, max);
+        break;
+    case N_ADD: case N_SUB: case N_MUL: case N_DIV:
+        flatten(x, n->a, max);
+        flatten(x, n->b, max);
+        break;
+    case N_CALL:
+        for (int i = 0; i < n->argc; ++i)
+            flatten(x, args[n->a + i], max);
+        x->impure |= n->fn == fn_rand;
+        break;
+    }
+    x->seq = grow(x->seq, max, x->nseq + 1, sizeof *x->seq);
+    x->seq[x->nseq++] = id;
+}
+
+// the parsed actions of x, run over node ids instead of values
+void
+build(struct expr *x, struct uuaction *a, int n)
+{
+    int stk[MAXSTACK], depth = 0, max = 0;
+
+    for (int i = 0; i < n; ++i) {
+        struct node nd = { 0 };
+        void (*fn)(void *, long) = a[i].fn;
+
+        if (fn == push || fn == env) {
+            if (depth == MAXSTACK)
+                uuerror("expression too deep");
+            nd.op = fn == push? N_NUM : N_VAR;
+            nd.a = fn == push? a[i].n : var(a[i].p, a[i].n);
+            stk[depth++] = node(nd, NULL);
+        } else if (fn == neg) {
+            nd.op = N_NEG;
+            nd.a = stk[depth-1];
+            stk[depth-1] = node(nd, NULL);
+        } else if (fn == call) {
+            nd.op = N_CALL;
+            nd.argc = a[i].n;
+            nd.fn = ((struct fn_list *)a[i].p)->fn;
+            depth -= a[i].n;
+            if (depth == MAXSTACK)
+                uuerror("expression too deep");
+            stk[depth] = node(nd, &stk[depth]);
+            ++depth;
+        } else {
+            nd.op = fn == add? N_ADD : fn == sub? N_SUB : fn == mul? N_MUL : N_DIV;
+            nd.a = stk[depth-2];
+            nd.b = stk[depth-1];
+            stk[--depth - 1] = node(nd, NULL);
+        }
+    }
+    x->root = stk[0];
+    flatten(x, x->root, &max);
+}
+//}}}
+//{{{ evaluation
+
+// one operation: l op r, or fn over av; returns an ERR_ code or 0
+static inline int
+apply(struct node *n, calc_t l, calc_t r, calc_t *av, calc_t *v)
+{
+    switch (n->op) {
+    case N_NUM: *v = n->a; break;
+    case N_VAR: *v = vars[n->a]; break;
+    case N_NEG: *v = -l; break;
+    case N_ADD: *v = l + r; break;
+    case N_SUB: *v = l - r; break;
+    case N_MUL: *v = l * r; break;
+    case N_DIV:
+        if (r == 0)
+            return ERR_DIVZERO;
+        if (r == -1 && l == INT_MIN)
+            return ERR_OVERFLOW;
+        *v = l / r;
+        break;
+    case N_CALL: *v = n->fn(n->argc, av); break;
+    }
+    return 0;
+}
+
+calc_t *val;
+unsigned char *err;
+
+// every distinct node once; node ids are already in topological order
+void
+evaldag(calc_t *res, unsigned char *rerr)
+{
+    calc_t av[MAXARGS];
+
+    for (int i = 0; i < nnodes; ++i) {
+        struct node *n = &nodes[i];
+        calc_t l = 0, r = 0;
+        int e = 0;
+
+        switch (n->op) {
+        case N_NEG:
+            e = err[n->a];
+            l = val[n->a];
+            break;
+        case N_ADD: case N_SUB: case N_MUL: case N_DIV:
+            // the left operand fails first, as it is evaluated first
+            if (!(e = err[n->a]))
+                e = err[n->b];
+            l = val[n->a];
+            r = val[n->b];
+            break;
+        case N_CALL:
+            for (int j = 0; j < n->argc && !e; ++j) {
+                e = err[args[n->a + j]];
+                av[j] = val[args[n->a + j]];
+            }
+            break;
+        }
+        err[i] = e? e : apply(n, l, r, av, &val[i]);
+    }
+
+    for (int x = 0; x < nexprs; ++x) {
+        res[x] = val[exprs[x].root];
+        rerr[x] = err[exprs[x].root];
+    }
+}
+
+// each expression on its own, walking its tree with a value stack
+void
+evalsep(calc_t *res, unsigned char *rerr)
+{
+    calc_t stk[MAXSTACK + MAXARGS];
+
+    for (int x = 0; x < nexprs; ++x) {
+        struct expr *ex = &exprs[x];
+        calc_t *sp = stk;
+        int e = 0;
+
+        for (int i = 0; i < ex->nseq && !e; ++i) {
+            struct node *n = &nodes[ex->seq[i]];
+
+            switch (n->op) {
+            case N_NUM: case N_VAR:
+                e = apply(n, 0, 0, NULL, sp++);
+                break;
+            case N_NEG:
+                e = apply(n, sp[-1], 0, NULL, &sp[-1]);
+                break;
+            case N_CALL:
+                sp -= n->argc;
+                e = apply(n, 0, 0, sp, sp);
+                ++sp;
+                break;
+            default:
+                --sp;
+                e = apply(n, sp[-1], sp[0], NULL, &sp[-1]);
+                break;
+            }
+        }
+        res[x] = e? 0 : stk[0];
+        rerr[x] = e;
+    }
+}
+//}}}
+//{{{ input
+
+// a random term over variables v0..v199
+char *
+maketerm(char *cp)
+{
+    int a = rnd(200), b = rnd(200), c = rnd(200);
+
+    switch (rnd(7)) {
+    case 0: return cp + sprintf(cp, "max(v%d, v%d) * v%d", a, b, c);
+    case 1: return cp + sprintf(cp, "min(v%d, v%d)", a, b);
+    case 2: return cp + sprintf(cp, "(v%d - v%d)", a, b);
+    case 3: return cp + sprintf(cp, "v%d * %d", a, 1 + rnd(10));
+    case 4: return cp + sprintf(cp, "(v%d + v%d) / %d", a, b, 1 + rnd(100));
+    case 5: return cp + sprintf(cp, "max(v%d, v%d, v%d)", a, b, c);
+    default: return cp + sprintf(cp, "v%d / (v%d - v%d)", a, b, c);
+    }
+}
+
+// n expressions of two to four terms from a pool of common ones
+char *
+generate(int n)
+{
+    enum { POOL = 2000 };
+    static char *pool[POOL];
+    char *buf = malloc((size_t)n * 160 + 1), *cp = buf, tmp[64];
+
+    if (buf == NULL) {
+        perror("ruleset");
+        exit(1);
+    }
+    for (int i = 0; i < POOL; ++i) {
+        *maketerm(tmp) = '\0';
+        pool[i] = strdup(tmp);
+    }
+    for (int i = 0; i < n; ++i) {
+        int terms = 2 + rnd(3);
+
+        // a few popular terms lead many formulas, as in real rule sets
+        cp += sprintf(cp, "%s", pool[rnd(4) == 0? rnd(20) : rnd(POOL)]);
+        for (int t = 1; t < terms; ++t)
+            cp += sprintf(cp, " %c %s", "+-*"[rnd(3)], pool[rnd(POOL)]);
+        cp += sprintf(cp, " - %d\n", rnd(1000));
+    }
+    *cp = '\0';
+    return buf;
+}
+
+// one expression per line into exprs, parsed and built into the DAG
+void
+compile(char *buf)
+{
+    static int i, maxexprs; // survive the uuerror longjmp
+    char *nl;
+
+    for (char *cp = buf; *cp; cp = nl + 1) {
+        if ((nl = strchr(cp, '\n')) == NULL)
+            nl = cp + strlen(cp) - 1;
+        else
+            *nl = '\0';
+        exprs = grow(exprs, &maxexprs, nexprs + 1, sizeof *exprs);
+        memset(&exprs[nexprs], 0, sizeof *exprs);
+        exprs[nexprs++].text = cp;
+    }
+
+    i = 0;
+    on_uuerror {
+        fprintf(stderr, "ruleset: line %d: %s\n", i + 1, uu.msg);
+        exit(1);
+    }
+    for (; i < nexprs; ++i) {
+        struct uuaction *a;
+        int n;
+
+        uu.lp = uu.line = exprs[i].text;
+        expr();
+        a = uudetach(&n);
+        build(&exprs[i], a, n);
+        free(a);
+    }
+}
+//}}}
+
+int
+main(int argc, char **argv)
+{
+    int n = 20000, ticks = 100, opt;
+    long treenodes = 0, compared = 0;
+    double tsep = 0, tdag = 0;
+    char *buf;
+
+    while ((opt = getopt(argc, argv, "n:t:")) != -1)
+        switch (opt) {
+        case 'n': n = atoi(optarg); break;
+        case 't': ticks = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: ruleset [-n expressions] [-t ticks] [file]\n");
+            return 1;
+        }
+    if (optind < argc) {
+        FILE *fp = fopen(argv[optind], "r");
+        if (fp == NULL) {
+            perror(argv[optind]);
+            return 1;
+        }
+        buf = readall(fp, NULL);
+    } else
+        buf = generate(n);
+
+    uuterms[_eol_].name = "end of line";
+    compile(buf);
+    if (nexprs == 0) {
+        fprintf(stderr, "ruleset: no expressions\n");
+        return 1;
+    }
+
+    val = malloc(nnodes * sizeof *val);
+    err = malloc(nnodes);
+    calc_t *res[2] = { malloc(nexprs * sizeof(calc_t)), malloc(nexprs * sizeof(calc_t)) };
+    unsigned char *rerr[2] = { malloc(nexprs), malloc(nexprs) };
+    if (!val || !err || !res[0] || !res[1] || !rerr[0] || !rerr[1]) {
+        perror("ruleset");
+        return 1;
+    }
+    for (int x = 0; x < nexprs; ++x)
+        treenodes += exprs[x].nseq;
+
+    for (int t = 0; t < ticks; ++t) {
+        double t0;
+
+        // a new snapshot; small values so that divisions by zero turn up
+        for (int v = 0; v < nvars; ++v)
+            vars[v] = (calc_t)rnd(41) - 20;
+
+        // alternated so drift affects both alike
+        for (int k = 0; k < 2; ++k) {
+            t0 = now();
+            if ((t + k) % 2) {
+                evaldag(res[1], rerr[1]);
+                tdag += now() - t0;
+            } else {
+                evalsep(res[0], rerr[0]);
+                tsep += now() - t0;
+            }
+        }
+
+        for (int x = 0; x < nexprs; ++x) {
+            if (exprs[x].impure)
+                continue;
+            if (rerr[0][x] != rerr[1][x] || (!rerr[0][x] && res[0][x] != res[1][x])) {
+                fprintf(stderr, "ruleset: tick %d line %d \"%s\": dag %d err %d, "
+                        "separate %d err %d\n", t, x + 1, exprs[x].text,
+                        res[1][x], rerr[1][x], res[0][x], rerr[0][x]);
+                return 1;
+            }
+            ++compared;
+        }
+    }
+
+    printf("%d expressions, %d variables: %ld tree nodes, %d distinct (%.1f%%)\n",
+           nexprs, nvars, treenodes, nnodes, 100.0 * nnodes / treenodes);
+    printf("separate %8.1f us/tick\n", tsep / ticks * 1e6);
+    printf("dag      %8.1f us/tick, %.2fx, %ld results compared\n",
+           tdag / ticks * 1e6, tsep / tdag, compared);
+    return 0;
+}
@@ -0,0 +1,260 @@
+// scaling.c - measure how uuscan primitives and the example.c grammar scale
+// compile: cc -O2 -o scaling scaling.c -lm
+//
+// scaling [-m maxkbytes] [-t seconds] [case ...]
+//
+// each case builds a pathological input of 1K, 4K, ... maxkbytes (default 16M),
+// times the parse and fits the exponent k of time ~ size^k. a case whose fitted
+// exponent exceeds its declared bound fails and the exit status is 1.
+// sizes stop growing once one run takes more than -t seconds (default 2), so
+// a quadratic path shows up without taking hours.
+
+#define main example_main
+#include "example.c"
+#include "bench.h"
+#undef main
+
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+
+// input under test; cases write into it, parse functions read it
+char *buf;
+
+// parse functions, each scans the whole of buf
+
+void
+lit_repeat()
+{
+    while (accept("ab"))
+        ;
+}
+
+void
+lit_nearmiss()
+{
+    while (!accept("abce") && accept(_ident_))
+        ;
+}
+
+void
+char_list()
+{
+    while (accept(_int_) && accept(COMMA))
+        ;
+}
+
+void
+one_term()
+{
+    accept(_ident_);
+}
+
+void
+alt_chain()
+{
+    static char *alts[] = {
+        "a", "b", "c", "d", "e", "f", "g", "h", "i", "j",
+        "k", "l", "m", "n", "o", "p", "q", "r", "s", "t",
+    };
+
+    do
+        for (int i = 0; i < NELEMS(alts); ++i)
+            if (accept(alts[i]))
+                break;
+    while (accept(_ident_));
+}
+
+// the line's deferred evaluation is dropped, only the parse is measured
+void
+grammar()
+{
+    struct uumark m = uumark();
+
+    expr();
+    uurollback(m);
+}
+
+// input builders: fill buf with n bytes
+
+void
+fill(char *s, int n)
+{
+    int len = strlen(s);
+    for (int i = 0; i < n; i += len)
+        memcpy(buf + i, s, n - i < len? n - i : len);
+    buf[n] = '\0';
+}
+
+// whole copies of an "<operand>+" unit, final + dropped
+void
+fillexpr(char *s, int n)
+{
+    int len = strlen(s);
+    fill(s, n - n % len);
+    buf[n - n % len - 1] = '\0';
+}
+
+void
+sum(int n)
+{
+    fill("1+", n);
+    buf[n-1] = '1';
+}
+
+void
+nested(int n)
+{
+    // repeated moderately deep subexpressions
+    fillexpr("((((((((((1))))))))))+", n);
+}
+
+void
+deep(int n)
+{
+    int d = (n - 1) / 2;
+    memset(buf, '(', d);
+    buf[d] = '1';
+    memset(buf + d + 1, ')', d);
+    buf[2*d + 1] = '\0';
+}
+
+void
+calls(int n)
+{
+    fillexpr("max(1,2,min(3,4))+", n);
+}
+
+void
+longident(int n)
+{
+    memset(buf, 'a', n);
+    buf[n] = '\0';
+}
+
+void
+spaces(int n)
+{
+    memset(buf, ' ', n - 1);
+    buf[n-1] = '1';
+    buf[n] = '\0';
+}
+
+void
+ab(int n)       { fill("ab ", n); }
+void
+abcd(int n)     { fill("abcd ", n); }
+void
+ints(int n)     { fill("1,", n); }
+void
+zs(int n)       { fill("z ", n); }
+
+struct {
+    char *name;
+    void (*build)(int);
+    void (*parse)();
+    double bound;       // declared scaling exponent
+    int maxsize;        // 0 for no limit below -m
+} cases[] = {
+    "literal-repeat",   ab,         lit_repeat,     1.0,    0,
+    "literal-nearmiss", abcd,       lit_nearmiss,   1.0,    0,
+    "char-list",        ints,       char_list,      1.0,    0,
+    "long-terminal",    longident,  one_term,       1.0,    0,
+    "long-space",       spaces,     one_term,       1.0,    0,
+    "alt-chain",        zs,         alt_chain,      1.0,    0,
+    "grammar-sum",      sum,        grammar,        1.0,    0,
+    "grammar-nested",   nested,     grammar,        1.0,    0,
+    "grammar-calls",    calls,      grammar,        1.0,    0,
+    // recursion depth is bounded by the C stack, which outgrows the caches
+    // near the largest size
+    "grammar-deep",     deep,       grammar,        1.1,    1 << 16,
+};
+
+// measurement noise allowance on top of the declared exponent
+#define SLACK 0.15
+
+// seconds per parse of buf, repeating short runs for resolution
+// an untimed first run faults in the input and stack pages
+double
+timeparse(void (*parse)())
+{
+    int reps = 0;
+    double t0, t;
+
+    uu.lp = uu.line = buf;
+    parse();
+    t0 = now();
+
+    do {
+        uu.lp = uu.line = buf;
+        parse();
+        ++reps;
+    } while ((t = now() - t0) < 0.01);
+
+    return t / reps;
+}
+
+int
+main(int argc, char **argv)
+{
+    int maxbytes = 16 << 20, opt, failed = 0;
+    double limit = 2;
+
+    while ((opt = getopt(argc, argv, "m:t:")) != -1)
+        switch (opt) {
+        case 'm': maxbytes = atoi(optarg) << 10; break;
+        case 't': limit = atof(optarg); break;
+        default:
+            fprintf(stderr, "usage: scaling [-m maxkbytes] [-t seconds] [case ...]\n");
+            return 1;
+        }
+
+    if ((buf = malloc(maxbytes + 1)) == NULL) {
+        perror("scaling");
+        return 1;
+    }
+
+    on_uuerror {
+        printf("parse error: %s\n", uu.msg);
+        return 1;
+    }
+
+    for (int c = 0; c < NELEMS(cases); ++c) {
+        double sx = 0, sy = 0, sxx = 0, sxy = 0, k, t = 0;
+        int m = 0, max = cases[c].maxsize && cases[c].maxsize < maxbytes?
+                         cases[c].maxsize : maxbytes;
+
+        if (optind < argc) {
+            int i;
+            for (i = optind; i < argc && strcmp(argv[i], cases[c].name); ++i)
+                ;
+            if (i == argc)
+                continue;
+        }
+
+        printf("%-18s", cases[c].name);
+        fflush(stdout);
+
+        for (int n = 1 << 10; n <= max && t < limit; n <<= 2, ++m) {
+            cases[c].build(n);
+            t = timeparse(cases[c].parse);
+            sx += log(n);
+            sy += log(t);
+            sxx += log(n) * log(n);
+            sxy += log(n) * log(t);
+            printf(" %6.2f", t / n * 1e9);
+            fflush(stdout);
+        }
+
+        if (m < 2) {    // no slope from one size
+            printf("  too few sizes timed, raise -m or -t\n");
+            failed = 1;
+            continue;
+        }
+        k = (m * sxy - sx * sy) / (m * sxx - sx * sx);
+        printf("  ns/byte  k=%.2f %s\n", k, k > cases[c].bound + SLACK? "SUPERLINEAR" : "ok");
+        failed |= k > cases[c].bound + SLACK;
+    }
+
+    return failed;
+}
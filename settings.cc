@@ -0,0 +1,297 @@
+// settings.cc - uuscan.h from C++: settings lines into a std::map
+// compile: c++ -std=c++17 -O2 -Wall -o settings settings.cc
+//
+// settings [file]
+//
+// reads name = value lines and prints the settings they make, sorted, with
+// the lines that do not parse reported by number. without a file a built-in
+// sample is read and the result checked against what it must give.
+//
+// uuerror() is a longjmp, so the rules keep no std::string or container
+// live: each line is parsed with uuparse() into a plain struct, whose spans
+// are offsets into the line (uuparse() parses a copy of it, freed on
+// return), and the line's value is made into C++ objects after it parsed.
+
+// setting:
+//      name "=" value
+// value:
+//      integer [ "ms" | "s" | "m" | "h" ]
+//      | flag
+//      | string
+//      | "[" [ name { "," name } ] "]"
+// flag:
+//      "on" | "off" | "yes" | "no" | "true" | "false", or a unique prefix
+
+#include <cstdio>
+#include <climits>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <variant>
+#include <vector>
+
+#define UUTERMINALS X(_name_) X(_int_) X(_string_)
+
+#include "uuscan.h"
+
+#define MAXITEMS    16
+
+struct span {
+    int off, len;               // into the line
+};
+
+struct setting {
+    struct span name;
+    enum { NUMBER, FLAG, STRING, LIST } kind;
+    long n;                     // a duration in ms
+    bool on;
+    struct span str;
+    struct span items[MAXITEMS];
+    int nitems;
+};
+
+static struct uukeyword flagwords[] = {
+    { "on" }, { "off" }, { "yes" }, { "no" }, { "true" }, { "false" },
+};
+static struct uukeys flags = UUKEYS("flag", flagwords);
+
+// terminal scanners:
+
+static bool
+spanned(char *lp, struct span *s)
+{
+    if (s) {
+        s->off = uu.lpstart - uu.line;
+        s->len = lp - uu.lpstart;
+    }
+    return success(lp);
+}
+
+UUDEFINE(_name_, struct span *s)
+{
+    if (!uuisalpha(*lp))
+        return fail(lp);
+    while (uuisalnum(*lp) || *lp == '_' || *lp == '-' || *lp == '.')
+        ++lp;
+    return spanned(lp, s);
+}
+
+UUDEFINE(_int_, long *v)
+{
+    long n = 0;
+
+    if (!uuisdigit(*lp))
+        return fail(lp);
+    for (; uuisdigit(*lp); ++lp)
+        if (n > (LONG_MAX - (*lp - '0')) / 10)
+            return fail(lp, "number too large");
+        else
+            n = n * 10 + *lp - '0';
+    if (v)
+        *v = n;
+    return success(lp);
+}
+
+// "..." with no escapes, the span without the quotes
+UUDEFINE(_string_, struct span *s)
+{
+    if (*lp != '"')
+        return fail(lp);
+    while (*++lp != '"')
+        if (*lp == '\0')
+            return fail(lp, "unterminated string");
+    if (s) {
+        s->off = uu.lpstart + 1 - uu.line;
+        s->len = lp - uu.lpstart - 1;
+    }
+    return success(lp + 1);
+}
+
+// the grammar:
+
+static long
+unit()
+{
+    if (accept("ms"))
+        return 1;
+    if (accept('s'))
+        return 1000;
+    if (accept('m'))
+        return 60 * 1000;
+    if (accept('h'))
+        return 60 * 60 * 1000;
+    return 1;
+}
+
+static bool
+setting(void *res)
+{
+    struct setting *s = (struct setting *)res;
+    int flag;
+
+    expect(_name_, &s->name, "setting name expected");
+    expect('=');
+    if (accept(_int_, &s->n)) {
+        long u = unit();
+        if (s->n > LONG_MAX / u)
+            uuerror("duration too long");
+        s->n *= u;
+        s->kind = setting::NUMBER;
+    } else if (uu.failmsg)  // malformed rather than not a number
+        uuerror("%s at pos %d", uu.failmsg, uuerrorpos());
+    else if (accept(_string_, &s->str))
+        s->kind = setting::STRING;
+    else if (uu.failmsg)
+        uuerror("%s at pos %d", uu.failmsg, uuerrorpos());
+    else if (accept(&flags, &flag)) {
+        s->on = flag % 2 == 0;
+        s->kind = setting::FLAG;
+    } else if (accept('[')) {
+        s->kind = setting::LIST;
+        s->nitems = 0;
+        if (!accept(']')) {
+            do {
+                if (s->nitems == MAXITEMS)
+                    uuerror("more than %d items", MAXITEMS);
+                expect(_name_, &s->items[s->nitems++], "list item expected");
+            } while (accept(','));
+            expect(']');
+        }
+    } else
+        uuerror("value expected at pos %d", uuerrorpos());
+    return true;
+}
+
+// the settings, out of the parse:
+
+using value = std::variant<long, bool, std::string, std::vector<std::string>>;
+
+static std::string
+text(const std::string &line, struct span s)
+{
+    return line.substr(s.off, s.len);
+}
+
+static value
+valueof(const std::string &line, const struct setting &s)
+{
+    switch (s.kind) {
+    case setting::NUMBER:
+        return s.n;
+    case setting::FLAG:
+        return s.on;
+    case setting::STRING:
+        return text(line, s.str);
+    default:
+        std::vector<std::string> items;
+        for (int i = 0; i < s.nitems; ++i)
+            items.push_back(text(line, s.items[i]));
+        return items;
+    }
+}
+
+static std::string
+show(const value &v)
+{
+    std::ostringstream out;
+
+    if (auto n = std::get_if<long>(&v))
+        out << *n;
+    else if (auto on = std::get_if<bool>(&v))
+        out << (*on? "on" : "off");
+    else if (auto str = std::get_if<std::string>(&v))
+        out << '"' << *str << '"';
+    else {
+        const char *sep = "";
+        out << '[';
+        for (const auto &item : std::get<std::vector<std::string>>(v)) {
+            out << sep << item;
+            sep = ", ";
+        }
+        out << ']';
+    }
+    return out.str();
+}
+
+// every line of in into settings, a later line replacing an earlier one;
+// the errors go to err
+static std::map<std::string, value>
+parse(std::istream &in, std::ostream &err)
+{
+    std::map<std::string, value> settings;
+    std::string line;
+    char msg[80];
+
+    for (int n = 1; std::getline(in, line); ++n) {
+        struct setting s;
+
+        if (line.find_first_not_of(" \t") == std::string::npos || line[0] == '#')
+            continue;
+        switch (uuparse(msg, line.data(), line.size(), setting, &s)) {
+        case UUPARSE_OK:
+            settings[text(line, s.name)] = valueof(line, s);
+            break;
+        case UUPARSE_TRAILING:
+            err << "line " << n << ": extra input after the value\n";
+            break;
+        default:
+            err << "line " << n << ": " << msg << "\n";
+            break;
+        }
+    }
+    return settings;
+}
+
+static const char sample[] =
+    "# a sample\n"
+    "timeout = 30s\n"
+    "retry.delay = 250ms\n"
+    "workers = 8\n"
+    "verbose = y\n"
+    "compress = off\n"
+    "banner = \"hello, world\"\n"
+    "hosts = [alpha, beta, gamma]\n"
+    "empty = []\n"
+    "timeout = 2m\n"
+    "bad = \n"
+    "worse = [alpha,]\n"
+    "open = \"never closed\n";
+
+static const char expected[] =
+    "banner = \"hello, world\"\n"
+    "compress = off\n"
+    "empty = []\n"
+    "hosts = [alpha, beta, gamma]\n"
+    "retry.delay = 250\n"
+    "timeout = 120000\n"
+    "verbose = on\n"
+    "workers = 8\n";
+
+int
+main(int argc, char **argv)
+{
+    std::ostringstream out, err;
+
+    if (argc > 1) {
+        std::ifstream in(argv[1]);
+        if (!in) {
+            perror(argv[1]);
+            return 1;
+        }
+        for (const auto &[name, v] : parse(in, std::cerr))
+            std::cout << name << " = " << show(v) << "\n";
+        return 0;
+    }
+
+    std::istringstream in(sample);
+    for (const auto &[name, v] : parse(in, err))
+        out << name << " = " << show(v) << "\n";
+    std::cout << out.str() << err.str();
+    if (out.str() != expected) {
+        std::cout << "not the settings expected:\n" << expected;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,241 @@
+// tiny.c - cost of parsing 8 to 64 byte inputs with and without uuparse()
+// compile: cc -O2 -o tiny tiny.c
+//
+// tiny [-n inputs]
+//
+// parses Cache-Control style header values ("no-cache", "max-age=600, public")
+// of about 8, 16, 32 and 64 bytes, one in ten malformed, four ways:
+//
+//      loop        uu.lp set per input, one on_uuerror for the whole run;
+//                  the lower bound, setup is amortised away
+//      on_uuerror  an on_uuerror block per call, messages formatted
+//      uuparse     uuparse() with no message
+//      uuparse+msg uuparse() with a message buffer
+//
+// and reports ns per input. the difference to loop is the fixed setup cost.
+
+// value:
+//      directive { "," directive }
+// directive:
+//      token [ "=" ( integer | quoted | token ) ]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+
+#define UUTERMINALS X(_token_) X(_int_) X(_quoted_)
+
+#include "uuscan.h"
+#include "bench.h"
+
+#define EQ      CHAR('=')
+#define COMMA   CHAR(',')
+#define EOL     CHAR('\0')
+
+#define NELEMS(x)   (sizeof(x)/sizeof(x[0]))
+
+// terminal scanners:
+
+UUDEFINE(_token_)
+{
+    while (isalnum(*lp) || *lp == '-' || *lp == '_')
+        ++lp;
+    if (lp == uu.lpstart)
+        return fail(lp);
+    return success(lp);
+}
+
+UUDEFINE(_int_)
+{
+    while (isdigit(*lp))
+        ++lp;
+    if (lp == uu.lpstart || isalpha(*lp))
+        return fail(lp);
+    return success(lp);
+}
+
+UUDEFINE(_quoted_)
+{
+    char *cp = strchr(lp + 1, '"');
+
+    if (*lp != '"' || cp == NULL)
+        return fail(lp);
+    return success(cp + 1);
+}
+
+// parser, counts directives into *res
+
+bool
+value(void *res)
+{
+    int *n = res;
+
+    *n = 0;
+    do {
+        expect(_token_, NULL, "expected directive");
+        if (accept(EQ) && !accept(_int_) && !accept(_quoted_))
+            expect(_token_, NULL, "expected value");
+        ++*n;
+    } while (accept(COMMA));
+    return true;
+}
+
+// one call with its own uuerror target, as a caller would write it today
+int
+classic(char *s)
+{
+    int n;
+
+    on_uuerror
+        return -1;
+    uu.lp = uu.line = s;
+    value(&n);
+    if (!accept(EOL))
+        return -1;
+    return n;
+}
+
+// inputs
+
+// a value of about size bytes at cp, returns its length
+int
+makevalue(char *cp, int size)
+{
+    static char *names[] = {
+        "no-cache", "no-store", "public", "private", "max-age", "s-maxage",
+        "must-revalidate", "immutable", "stale-while-revalidate", "x",
+    };
+    char *start = cp;
+
+    do {
+        if (cp > start)
+            cp += sprintf(cp, ", ");
+        cp += sprintf(cp, "%s", names[rnd(NELEMS(names))]);
+        switch (rnd(3)) {
+        case 0: cp += sprintf(cp, "=%u", rnd(100000)); break;
+        case 1: cp += sprintf(cp, "=\"%c%c\"", 'a' + rnd(26), 'a' + rnd(26)); break;
+        }
+    } while (cp - start < size * 3 / 4);
+
+    if (rnd(10) == 0) // malformed: dangling = or ,
+        *cp++ = "=,"[rnd(2)];
+    *cp = '\0';
+    return cp - start;
+}
+
+// one timed pass of method h over the n inputs, returns seconds
+double
+run(int h, char **in, int *len, long n)
+{
+    static long i, sum, errors; // survive the uuerror longjmp
+    char msg[80];
+    int count;
+    double t = now();
+
+    sum = errors = 0;
+    switch (h) {
+    case 0:
+        i = 0;
+        on_uuerror {
+            ++errors;
+            ++i;
+        }
+        for (; i < n; ++i) {
+            uu.lp = uu.line = in[i];
+            value(&count);
+            if (accept(EOL))
+                sum += count;
+            else
+                ++errors;
+        }
+        break;
+    case 1:
+        for (i = 0; i < n; ++i)
+            if ((count = classic(in[i])) < 0)
+                ++errors;
+            else
+                sum += count;
+        break;
+    case 2:
+    case 3:
+        for (i = 0; i < n; ++i)
+            if (uuparse(h == 3? msg : NULL, in[i], len[i], value, &count) == UUPARSE_OK)
+                sum += count;
+            else
+                ++errors;
+        break;
+    }
+    t = now() - t;
+
+    // every method must see the same inputs the same way
+    static long check[2];
+    if (h == 0) {
+        check[0] = sum;
+        check[1] = errors;
+    } else if (sum != check[0] || errors != check[1]) {
+        fprintf(stderr, "tiny: %ld directives %ld errors, expected %ld %ld\n",
+                sum, errors, check[0], check[1]);
+        exit(1);
+    }
+    return t;
+}
+
+int
+main(int argc, char **argv)
+{
+    static int sizes[] = { 8, 16, 32, 64 };
+    static char *how[] = { "loop", "on_uuerror", "uuparse", "uuparse+msg" };
+    static double best[NELEMS(how)][NELEMS(sizes)];
+    long n = 100000;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:")) != -1)
+        switch (opt) {
+        case 'n': n = atol(optarg); break;
+        default:
+            fprintf(stderr, "usage: tiny [-n inputs]\n");
+            return 1;
+        }
+    if (n < 1) {
+        fprintf(stderr, "tiny: -n must be positive\n");
+        return 1;
+    }
+
+    char **in = malloc(n * sizeof *in), *buf = malloc(n * 128);
+    int *len = malloc(n * sizeof *len);
+    if (!in || !buf || !len) {
+        perror("tiny");
+        return 1;
+    }
+
+    for (int s = 0; s < NELEMS(sizes); ++s) {
+        char *cp = buf;
+
+        // contiguous, as a batch of requests would be
+        for (long k = 0; k < n; ++k) {
+            in[k] = cp;
+            len[k] = makevalue(cp, sizes[s]);
+            cp += len[k] + 1;
+        }
+
+        // interleaved so drift affects all methods alike
+        for (int rep = 0; rep < 5; ++rep)
+            for (int h = 0; h < NELEMS(how); ++h) {
+                double t = run(h, in, len, n);
+                keepbest(&best[h][s], t);
+            }
+    }
+
+    printf("%-12s", "bytes");
+    for (int s = 0; s < NELEMS(sizes); ++s)
+        printf("%8d", sizes[s]);
+    printf("   ns/input, best of 5 over %ld inputs\n", n);
+    for (int h = 0; h < NELEMS(how); ++h) {
+        printf("%-12s", how[h]);
+        for (int s = 0; s < NELEMS(sizes); ++s)
+            printf("%8.1f", best[h][s] / n * 1e9);
+        printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,337 @@
+// uuckpt.h - checkpoints for long parses of a file or stream, to go on after a restart
+// the committed input offset, the app's statistics and state are written to a
+// file atomically; a restarted parse reads it and skips to where it left off
+// github.com/spinau/uuscan
+
+/*{{{ uuckpt.h exports
+Types
+  struct uuckpt                         checkpoint file, what goes in it and how often
+
+Functions
+  bool uuckpt_init(struct uuckpt *, const char *path, void *stats, size_t size,
+                   double interval)
+  bool uuckpt_state(struct uuckpt *, size_t (*save)(void *, char *, size_t),
+                    bool (*restore)(void *, const char *, size_t), void *arg, size_t room)
+                                        app state written by save() with each checkpoint
+  int uuckpt_resume(struct uuckpt *, FILE *)
+                                        restore the last checkpoint, skip the input to it;
+                                        1 resumed, 0 no checkpoint, -1 error (ck->error)
+  bool uuckpt_commit(struct uuckpt *, const char *base, uint64_t baseoff, const char *end)
+                                        input committed to end: write if interval is up
+  bool uuckpt_write(struct uuckpt *, const char *base, uint64_t baseoff, const char *end)
+                                        write now, at the end or on a stop
+  uuckpt_free(struct uuckpt *)
+}}}*/
+/*{{{ notes
+A parse that runs for hours over a log or a stream keeps statistics, and
+maybe other state, that are consistent with the input up to some point: the
+end of the last batch of rows taken into the counts, say. At such points the
+driver commits:
+
+    struct uuckpt ck;
+    uuckpt_init(&ck, "ingest.ckpt", &count, sizeof count, 1.0);
+    if (uuckpt_resume(&ck, fp) < 0)             // count restored, fp moved on
+        ... ck.error ...
+    while (... chunk of input in buf, at offset off of the input ...) {
+        ... parse, and after each batch is counted:
+        uuckpt_commit(&ck, buf, off, end of the last line counted);
+    }
+    uuckpt_write(&ck, buf, off, end);           // at the end, or on SIGTERM
+
+base is the input buffered in memory and baseoff its offset in the input,
+so the committed offset is baseoff + (end - base). uuckpt_commit() writes
+a checkpoint when interval seconds have passed since the last one, and is
+otherwise a clock read: a driver that commits every few thousand lines
+spends a write and an fsync per interval on it, whatever the input rate.
+interval 0 writes at every commit.
+
+A checkpoint is written to path.tmp, synced, and renamed over path, with
+the directory synced after, so path holds either the last checkpoint or
+the one before it, whole; a torn or damaged file fails its checksum. It
+holds the committed offset, the stats struct as is (same build, same
+layout: a size mismatch is refused), and up to room bytes from the save()
+callback, if there is one, given back to restore() on resume.
+
+uuckpt_resume() reads path. If there is none it returns 0 and the input is
+untouched. Else it restores the stats and state and moves the input to the
+committed offset: fseeko() on a file, reading and dropping the bytes on a
+pipe. The last 64 bytes before the offset are hashed at commit and checked
+on resume, so a log rotated or truncated under the checkpoint is refused
+rather than parsed from the middle of a line. The hash reads NUL as
+newline: the driver may split its buffer into lines in place.
+
+A line is taken into the statistics once if the driver stops through
+uuckpt_write() (at the end of input, or on SIGTERM after finishing the
+line in hand and flushing its counts). After a crash the lines since the
+last checkpoint are parsed again, and their counts come again from the
+checkpoint's, so they are counted once there too; what the app did outside
+the checkpoint with those lines is done twice.
+}}}*/
+//{{{ includes
+#ifndef _STDIO_H
+#include <stdio.h>
+#endif
+#ifndef _STDLIB_H
+#include <stdlib.h>
+#endif
+#ifndef _STDINT_H
+#include <stdint.h>
+#endif
+#ifndef _STDDEF_H
+#include <stddef.h>
+#endif
+#ifndef _STRING_H
+#include <string.h>
+#endif
+#ifndef _STDBOOL_H
+#include <stdbool.h>
+#endif
+#ifndef _ERRNO_H
+#include <errno.h>
+#endif
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+//}}}
+
+#define _UUCKPT_TAIL    64      // input bytes before the offset that must match
+
+struct uuckpt {
+    char *path, *tmp;
+    int dir;                    // the directory of path, synced after a rename
+    void *stats;
+    size_t size;                // of stats
+    double interval, last;      // seconds between writes, time of the last
+    size_t (*save)(void *, char *, size_t);
+    bool (*restore)(void *, const char *, size_t);
+    void *arg;                  // for save() and restore()
+    size_t room;                // most bytes save() may write
+    char *buf;                  // the checkpoint as written
+    uint64_t offset;            // committed, as last written or resumed
+    long writes;
+    const char *error;          // why uuckpt_resume() failed
+};
+
+// checkpoint file layout, stats and state follow
+struct _uuckpt_head {
+    char magic[8];
+    uint64_t offset;
+    uint64_t tail;              // hash of the taillen bytes before offset
+    uint32_t taillen;
+    uint32_t size, statelen;
+    uint32_t pad;
+    uint64_t sum;               // of all of it, with sum 0
+};
+
+static const char _uuckpt_magic[8] = "uuckpt1";
+
+// FNV-1a, NUL as newline when lines
+static uint64_t
+_uuckpt_hash(uint64_t h, const char *p, size_t n, bool lines)
+{
+    for (size_t i = 0; i < n; ++i)
+        h = (h ^ (unsigned char)(lines && p[i] == '\0'? '\n' : p[i])) * 0x100000001b3ULL;
+    return h;
+}
+
+static double
+_uuckpt_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static __attribute__((unused)) bool
+uuckpt_init(struct uuckpt *ck, const char *path, void *stats, size_t size, double interval)
+{
+    size_t len = strlen(path);
+    const char *slash = strrchr(path, '/');
+    char *dir;
+
+    memset(ck, 0, sizeof *ck);
+    ck->stats = stats;
+    ck->size = size;
+    ck->interval = interval;
+    ck->last = _uuckpt_now();
+    ck->dir = -1;
+    if ((ck->path = strdup(path)) == NULL || (ck->tmp = (char *)malloc(len + 5)) == NULL
+            || (ck->buf = (char *)malloc(sizeof(struct _uuckpt_head) + size)) == NULL)
+        return false;
+    memcpy(ck->tmp, path, len);
+    memcpy(ck->tmp + len, ".tmp", 5);
+
+    if ((dir = strndup(path, slash? (size_t)(slash - path) + 1 : 0)) == NULL)
+        return false;
+    ck->dir = open(*dir? dir : ".", O_RDONLY);
+    free(dir);
+    return ck->dir >= 0;
+}
+
+static __attribute__((unused)) bool
+uuckpt_state(struct uuckpt *ck, size_t (*save)(void *, char *, size_t),
+             bool (*restore)(void *, const char *, size_t), void *arg, size_t room)
+{
+    char *buf = (char *)realloc(ck->buf, sizeof(struct _uuckpt_head) + ck->size + room);
+
+    if (buf == NULL)
+        return false;
+    ck->buf = buf;
+    ck->save = save;
+    ck->restore = restore;
+    ck->arg = arg;
+    ck->room = room;
+    return true;
+}
+
+static __attribute__((unused)) void
+uuckpt_free(struct uuckpt *ck)
+{
+    if (ck->dir >= 0)
+        close(ck->dir);
+    free(ck->path);
+    free(ck->tmp);
+    free(ck->buf);
+}
+
+// whole of fd into buf[0..n), false at a short read
+static bool
+_uuckpt_read(int fd, char *buf, size_t n)
+{
+    ssize_t r;
+
+    for (; n > 0; buf += r, n -= r)
+        if ((r = read(fd, buf, n)) <= 0) {
+            if (r < 0 && errno == EINTR) {
+                r = 0;
+                continue;
+            }
+            return false;
+        }
+    return true;
+}
+
+static bool
+_uuckpt_writeall(int fd, const char *buf, size_t n)
+{
+    ssize_t w;
+
+    for (; n > 0; buf += w, n -= w)
+        if ((w = write(fd, buf, n)) < 0) {
+            if (errno != EINTR)
+                return false;
+            w = 0;
+        }
+    return true;
+}
+
+static __attribute__((unused)) bool
+uuckpt_write(struct uuckpt *ck, const char *base, uint64_t baseoff, const char *end)
+{
+    struct _uuckpt_head h;
+    size_t tail = end - base < _UUCKPT_TAIL? end - base : _UUCKPT_TAIL, len;
+    uint64_t sum;
+    int fd;
+
+    memset(&h, 0, sizeof h);
+    memcpy(h.magic, _uuckpt_magic, sizeof h.magic);
+    h.offset = baseoff + (end - base);
+    h.taillen = tail;
+    h.tail = _uuckpt_hash(0xcbf29ce484222325ULL, end - tail, tail, true);
+    h.size = ck->size;
+    if (ck->save) {
+        if ((len = ck->save(ck->arg, ck->buf + sizeof h + ck->size, ck->room)) > ck->room) {
+            errno = EOVERFLOW;
+            return false;
+        }
+        h.statelen = len;
+    }
+    memcpy(ck->buf, &h, sizeof h);
+    memcpy(ck->buf + sizeof h, ck->stats, ck->size);
+    len = sizeof h + ck->size + h.statelen;
+    sum = _uuckpt_hash(0xcbf29ce484222325ULL, ck->buf, len, false);
+    memcpy(ck->buf + offsetof(struct _uuckpt_head, sum), &sum, sizeof sum);
+
+    if ((fd = open(ck->tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0)
+        return false;
+    if (!_uuckpt_writeall(fd, ck->buf, len) || fsync(fd) < 0) {
+        close(fd);
+        return false;
+    }
+    if (close(fd) < 0 || rename(ck->tmp, ck->path) < 0 || fsync(ck->dir) < 0)
+        return false;
+    ck->offset = h.offset;
+    ck->last = _uuckpt_now();
+    ++ck->writes;
+    return true;
+}
+
+static __attribute__((unused)) bool
+uuckpt_commit(struct uuckpt *ck, const char *base, uint64_t baseoff, const char *end)
+{
+    if (_uuckpt_now() - ck->last < ck->interval)
+        return true;
+    return uuckpt_write(ck, base, baseoff, end);
+}
+
+static __attribute__((unused)) int
+uuckpt_resume(struct uuckpt *ck, FILE *in)
+{
+    struct _uuckpt_head h;
+    char tail[_UUCKPT_TAIL], *state = ck->buf + sizeof h + ck->size;
+    uint64_t sum, skip;
+    size_t n;
+    int fd;
+    bool ok;
+
+    memset(&h, 0, sizeof h);
+    if ((fd = open(ck->path, O_RDONLY)) < 0) {
+        if (errno == ENOENT)
+            return 0;
+        ck->error = strerror(errno);
+        return -1;
+    }
+    ok = _uuckpt_read(fd, (char *)&h, sizeof h) && memcmp(h.magic, _uuckpt_magic, sizeof h.magic) == 0
+         && h.size == ck->size && h.statelen <= ck->room && h.taillen <= _UUCKPT_TAIL
+         && _uuckpt_read(fd, ck->buf + sizeof h, h.size + h.statelen);
+    close(fd);
+    if (!ok) {
+        ck->error = memcmp(h.magic, _uuckpt_magic, sizeof h.magic) == 0 && h.size != ck->size?
+                    "checkpoint is of other stats" : "checkpoint damaged";
+        return -1;
+    }
+    sum = h.sum;
+    h.sum = 0;
+    memcpy(ck->buf, &h, sizeof h);
+    if (_uuckpt_hash(0xcbf29ce484222325ULL, ck->buf, sizeof h + h.size + h.statelen, false) != sum) {
+        ck->error = "checkpoint damaged";
+        return -1;
+    }
+
+    // the input up to the offset, its tail read and checked
+    skip = h.offset - h.taillen;
+    if (fseeko(in, skip, SEEK_CUR) < 0)       // a pipe: read it
+        for (char drop[65536]; skip > 0; skip -= n) {
+            n = skip < sizeof drop? skip : sizeof drop;
+            if (fread(drop, 1, n, in) != n) {
+                ck->error = "input shorter than the checkpoint";
+                return -1;
+            }
+        }
+    if (fread(tail, 1, h.taillen, in) != h.taillen) {
+        ck->error = "input shorter than the checkpoint";
+        return -1;
+    }
+    if (_uuckpt_hash(0xcbf29ce484222325ULL, tail, h.taillen, true) != h.tail) {
+        ck->error = "input differs from the checkpoint's";
+        return -1;
+    }
+
+    memcpy(ck->stats, ck->buf + sizeof h, h.size);
+    if (ck->restore && !ck->restore(ck->arg, state, h.statelen)) {
+        ck->error = "state not restored";
+        return -1;
+    }
+    ck->offset = h.offset;
+    return 1;
+}
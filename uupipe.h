@@ -0,0 +1,235 @@
+// uupipe.h - tokens scanned ahead on a lexer thread, parsed on another
+// a single producer, single consumer ring of tokens with backtracking over
+// the tokens still held in it
+// github.com/spinau/uuscan
+
+/*{{{ uupipe.h exports
+Types
+  struct uupipe                         the ring and both ends' positions
+  struct uutoken                        { kind, len, pos, v }: one token
+
+Functions
+  bool uupipe_init(struct uupipe *, int size, void (*fill)(struct uupipe *))
+  uupipe_free(struct uupipe *)
+lexer:
+  struct uutoken *uupipe_slot(struct uupipe *)   next slot to fill, waits for room
+  uupipe_put(struct uupipe *)                    hand the filled slot over
+  uupipe_flush(struct uupipe *)                  hand over what is put, at the end
+  bool uupipe_full(struct uupipe *)              no slot free without waiting
+parser:
+  struct uutoken *uupipe_peek(struct uupipe *)   next token, waits for it; NULL
+                                                 if the backtrack window is full
+  uupipe_next(struct uupipe *)                   consume it
+  size_t uupipe_mark(struct uupipe *)            backtrack point
+  uupipe_rollback(struct uupipe *, size_t)       back to the mark, drop it
+  uupipe_commit(struct uupipe *)                 keep going, drop the last mark
+}}}*/
+/*{{{ notes
+uuscan picks the scanner to run from the grammar, one accept() at a time, so
+scanning and parsing are one thread of control. When the tokens of a
+language can be told apart without the parser's help (JSON, most
+expression and config languages), the scanning can run ahead instead: a
+lexer thread runs the UUDEFINE scanners in a loop over the whole input and
+puts each token in the ring, and the rules on the parser thread look at
+token kinds only. Lexing and parsing then overlap, and number conversion,
+string validation and space skipping come off the parser's path.
+
+    lexer thread                          parser thread
+    while (more) {                        struct uutoken *t = uupipe_peek(&p);
+        struct uutoken *t = uupipe_slot(&p);  if (t->kind == T_LBRACE) {
+        t->kind = ...; t->pos = ...;          uupipe_next(&p);
+        uupipe_put(&p);                       ...
+    }
+    uupipe_flush(&p);
+
+The lexer must end the stream with a token the grammar stops at (an end of
+input or error kind). Each side caches the other's position and publishes
+its own every UUPIPE_BATCH (default 64) tokens, so the cache line holding a
+position moves between the cores once a batch, not once a token.
+
+The parser can backtrack: uupipe_mark() returns its position, and until
+the mark is rolled back or committed no token from it on is released to
+the lexer. The window is the ring: a parse that looks more than size
+tokens past its oldest mark gets NULL from uupipe_peek(), which the grammar
+should report with uuerror(). Marks nest.
+
+With a fill function the ring runs on one thread: uupipe_peek() calls
+fill() when the ring is empty, which should lex up to a batch of tokens,
+stopping early if uupipe_full(). This is the same code path without the
+overlap, for comparison and for machines with one CPU. A waiting side
+spins briefly and then yields.
+
+uuscan.h must be compiled with -DUUTHREADS for the lexer thread to have a
+uu of its own. size is a power of 2.
+}}}*/
+//{{{ includes
+#ifndef _STDLIB_H
+#include <stdlib.h>
+#endif
+#ifndef _STRING_H
+#include <string.h>
+#endif
+#ifndef _STDBOOL_H
+#include <stdbool.h>
+#endif
+#ifndef _SCHED_H
+#include <sched.h>
+#endif
+//}}}
+
+#ifndef UUPIPE_BATCH
+#define UUPIPE_BATCH    64
+#endif
+
+struct uutoken {
+    int kind;                   // app-defined
+    int len;                    // input bytes
+    size_t pos;                 // input offset
+    union {
+        double d;
+        long i;
+        const void *p;
+    } v;                        // converted value
+};
+
+struct uupipe {
+    struct uutoken *ring;
+    size_t mask;                // slots - 1
+    void (*fill)(struct uupipe *);
+
+    // lexer's: head is read by the parser
+    size_t head __attribute__((aligned(64)));  // tokens handed over
+    size_t put;                 // tokens filled
+    size_t tailseen;            // the parser's tail when last read
+
+    // parser's: tail is read by the lexer
+    size_t tail __attribute__((aligned(64)));  // tokens released
+    size_t next;                // next token to read
+    size_t headseen;            // the lexer's head when last read
+    int marks;                  // nesting of uupipe_mark()
+};
+
+static void
+_uupipe_pause(int spins)
+{
+    if (spins < 64) {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    } else
+        sched_yield();
+}
+
+// false if out of memory
+static bool
+uupipe_init(struct uupipe *p, int size, void (*fill)(struct uupipe *))
+{
+    memset(p, 0, sizeof *p);
+    p->ring = (struct uutoken *)malloc(size * sizeof *p->ring);
+    p->mask = size - 1;
+    p->fill = fill;
+    return p->ring != NULL;
+}
+
+static void
+uupipe_free(struct uupipe *p)
+{
+    free(p->ring);
+    p->ring = NULL;
+}
+
+//{{{ lexer
+static void
+uupipe_flush(struct uupipe *p)
+{
+    __atomic_store_n(&p->head, p->put, __ATOMIC_RELEASE);
+}
+
+static inline struct uutoken *
+uupipe_slot(struct uupipe *p)
+{
+    if (p->put - p->tailseen > p->mask) {
+        uupipe_flush(p);        // the parser may be waiting on these
+        for (int spins = 0; p->put - (p->tailseen =
+                    __atomic_load_n(&p->tail, __ATOMIC_ACQUIRE)) > p->mask; ++spins)
+            _uupipe_pause(spins);
+    }
+    return &p->ring[p->put & p->mask];
+}
+
+static inline bool
+uupipe_full(struct uupipe *p)
+{
+    return p->put - (p->tailseen = __atomic_load_n(&p->tail, __ATOMIC_ACQUIRE)) > p->mask;
+}
+
+static inline void
+uupipe_put(struct uupipe *p)
+{
+    if (++p->put - p->head >= UUPIPE_BATCH)
+        uupipe_flush(p);
+}
+//}}}
+//{{{ parser
+static inline void
+_uupipe_release(struct uupipe *p)
+{
+    __atomic_store_n(&p->tail, p->next, __ATOMIC_RELEASE);
+}
+
+static struct uutoken *
+_uupipe_wait(struct uupipe *p)
+{
+    if (p->marks == 0)
+        _uupipe_release(p);
+    else if (p->next - p->tail > p->mask)
+        return NULL;            // the lexer has no room left to write into
+
+    if (p->fill) {
+        p->fill(p);
+        uupipe_flush(p);
+        p->headseen = p->head;
+    } else
+        for (int spins = 0; (p->headseen =
+                    __atomic_load_n(&p->head, __ATOMIC_ACQUIRE)) == p->next; ++spins)
+            _uupipe_pause(spins);
+    return p->next == p->headseen? NULL : &p->ring[p->next & p->mask];
+}
+
+static inline struct uutoken *
+uupipe_peek(struct uupipe *p)
+{
+    if (p->next == p->headseen)
+        return _uupipe_wait(p);
+    return &p->ring[p->next & p->mask];
+}
+
+static inline void
+uupipe_next(struct uupipe *p)
+{
+    if (++p->next - p->tail >= UUPIPE_BATCH && p->marks == 0)
+        _uupipe_release(p);
+}
+
+// the window starts at the outermost mark: what is before it is released
+static inline size_t
+uupipe_mark(struct uupipe *p)
+{
+    if (p->marks++ == 0)
+        _uupipe_release(p);
+    return p->next;
+}
+
+static inline void
+uupipe_rollback(struct uupipe *p, size_t m)
+{
+    p->next = m;
+    --p->marks;
+}
+
+static inline void
+uupipe_commit(struct uupipe *p)
+{
+    --p->marks;
+}
+//}}}
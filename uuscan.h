@@ -1,5 +1,5 @@
 // uuscan.h - light-weight helper functions for recursive descent parsing
-// uses _Generic selector, requires C11 or later
+// uses _Generic selector, requires C11 or later; C++17 or later selects by overload
 // github.com/spinau/uuscan
 
 /*{{{ uuscan.h exports; names beginning with underscore not meant for app use
@@ -18,14 +18,66 @@ Macros
   UUTERMINALS X(t1) X(t2) ...           declare terminals
   UUDEFINE(t)                           define scan function to terminal t
   UUDEFINE(t, <type> *v)                with return value ptr
+  UUSTATE(s)                            define state function s of a terminal
+  uunext(s, lp)                         tail call to state s at lp
   CHAR(x)                               same as (char)x for use in accept/expect
+  UUKEYS(name, words)                   keyword set: accept(&set, &i) takes a keyword
+                                        or a unique prefix of one, i its index
+  UURULE                                first in a rule: push it on the rule stack
+                                        (UUPROF)
+  INDENT DEDENT NEWLINE                 built-in indentation terminals (UUINDENT)
+  uuisspace(c) uuisalpha(c) uuisdigit(c) ctype tests that stay inline in C++;
+  uuisalnum(c) uuisxdigit(c)            same as isspace(c) etc. in C
 
 Functions
   uudebug(char *fmt, ...)               stderr messages if UUDEBUG defined
   char *skipspace(char *)               advances over front space
+  struct uumark m = uumark()            save point: input position and queued actions
+  uurollback(m)                         backtrack to m, drop actions queued since
+  uudefer(fn, p, n)                     queue fn(p, n) to run after the parse (UUDEFER)
+  uurun()                               run the queued actions, empty the queue (UUDEFER)
+  struct uuaction *uudetach(int *n)     take the queued actions to keep and run again
+                                        (UUDEFER, not UUSTATIC)
+  uuindentinit()                        reset the indentation stack for new input
+                                        (UUINDENT)
+  int uuparse(msg, ptr, len, rule, res) one-shot parse of a short string,
+                                        returns UUPARSE_*
+  bool uukeys_init(struct uukeys *)     build a keyword set's trie now, not at first use
+  bool uucache_get(t, p, len, val, size)
+                                        cached conversion of span p for terminal t
+                                        (UUCACHE)
+  uucache_put(t, p, len, val, size)     remember conversion of span p (UUCACHE)
+  uucache_report(FILE *)                lookups and hit ratio per terminal (UUCACHE)
+  STAP_PROBE*(uuscan, ...)              USDT probes in the scanners and errors (UUSDT)
+  bool uuprof_start(int hz)             sample the rule stack hz times a CPU second
+                                        (UUPROF)
+  uuprof_stop()                         stop sampling (UUPROF)
+  uuprof_report(FILE *)                 write the samples as folded stacks (UUPROF)
+  int uubatch(jobs, n, k, rule)         parse n jobs, k at a time interleaved (UUBATCH)
+  long uubatch_yields()                 switches between parses in the last
+                                        uubatch() (UUBATCH)
+  int uucomplete(ptr, len, rule, res, c, max)
+                                        what the rule tries at the last word (UUCOMPLETE)
+  struct uuresume *uuresume_new(rule, res)
+                                        a parse to resume after an edit (UURESUME)
+  int uuresume(r, msg, ptr, len)        parse ptr as uuparse() would, from the last
+                                        checkpoint before the edit (UURESUME)
+  uuresume_free(r)                      free it (UURESUME)
+  bool uuskip(open, close, flags, &t)   skip a balanced block into thunk t (UULAZY)
+  int uuforce(msg, &t, rule, res)       parse t's block with rule, first call only
+                                        (UULAZY)
+  uutrace_line()                        begin traced line, writes its shape (UUTRACE)
+  char *uureplay(FILE *, char *, int)   read next traced line as synthetic input (UUTRACE)
 
 Struct
   uu                                    uuscan internals; app must set uu.line and uu.lp
+  struct uujob                          { line, res, msg, status }: one uubatch() input
+  struct uukeyword                      { word, min }: one keyword of a UUKEYS set
+  struct uucandidate                    { text, len, kind }: one uucomplete() result
+  struct uuresume                       a line, its parse's stack and checkpoints
+                                        (UURESUME)
+  struct uuthunk                        { line, start, end, status }: a skipped
+                                        block (UULAZY)
 }}}*/
 /*{{{ notes
 To set up for uu scanning:
@@ -109,10 +161,43 @@ or
         return success(lp); // return true and update uu.lp to next char of input
     }
 
+A terminal with many cases (sign, digits, fraction, exponent) can be written as
+a state machine instead of nested if/while: each state is a small function that
+looks at one or two chars and moves on with uunext(), a guaranteed tail call
+where the compiler has musttail (clang, gcc 15) and an ordinary sibling call,
+compiled to a jump at -O2, elsewhere. lp and res stay in argument registers
+from state to state and the states thread into one another:
+
+    UUSTATE(digits);
+    UUDEFINE(T, void *res) { if (isdigit(*lp)) uunext(digits, lp); return fail(lp); }
+    UUSTATE(digits)        { if (isdigit(*lp)) uunext(digits, lp+1); return success(lp); }
+
 "terminal" is loosely defined. Scanning for a terminal usually means scanning a 
 single lexical element, but there is nothing preventing a scanner from processing
 more complex forms.
 
+Command languages that take abbreviated keywords ("sh int br" for "show
+interface brief") declare each set of keywords that can appear at one point
+of the grammar, with the shortest abbreviation of each (0 for any unique
+prefix), and accept or expect the set like a terminal:
+
+    static struct uukeyword showwords[] = {
+        { "interface" }, { "ip" }, { "inventory", 3 }, { "version" },
+    };
+    static struct uukeys show = UUKEYS("show target", showwords);
+    ...
+    int i;
+    expect(&show, &i);          // "int" and "interface" give 0, "ip" 1
+
+A word (alnum, '-' and '_') is taken whole and matches the keyword it
+spells out, or else the one keyword it is a prefix of that allows an
+abbreviation that short. A prefix of two or more fails with uu.failmsg
+"ambiguous", one that is too short with "abbreviation too short"; expect()
+reports "expected show target at pos 6 (ambiguous)". The set is a trie,
+built on first use: each node knows the keyword its prefix picks out, so a
+word costs one step per char whatever the size of the set. Keywords are
+case sensitive, at most 32767 per set.
+
 Syntax and conversion error handling is done with uuerror() with normal printf()
 style formatting. uuerror() formats the message string and does a longjmp to the
 on_uuerror { ... } block where the error message can be printed or dealt with.
@@ -126,8 +211,310 @@ is best suited to a single-source file for a particular parsing job, at least
 the part requiring the accept/expect's. This file-separation also allows multiple
 parsing each with different terminal sets to coexist within one executable.
 
+For many small independent inputs (tokens, header values, short filters) the
+one-shot entry point needs no on_uuerror block and no setup at the call site:
+
+    bool number(void *res) { return accept(integer, res); }
+    ...
+    switch (uuparse(NULL, s, n, number, &i)) {
+    case UUPARSE_OK:            // rule succeeded and only space is left
+    case UUPARSE_NOMATCH:       // rule returned false
+    case UUPARSE_TRAILING:      // rule succeeded but input is left over
+    case UUPARSE_ERROR:         // uuerror() or a failed expect() in the rule
+    }
+
+s need not be NUL terminated; it is copied, onto the stack when short. With a
+NULL msg no error message is formatted, otherwise msg (at least 80 chars)
+receives it. All of uu but the on_uuerror target errjmp, which it does not
+touch, is restored on return (the UUVAL fields too), as is the indentation
+stack, so uuparse() can also be used from inside a scanner or a parse; only
+the actions queued by a rule that succeeded are kept. The save and restore
+are two copies of the 72 bytes of uu outside errjmp (more with UUVAL and
+some options): a call costs a few ns more than the same parse under an
+on_uuerror set up once.
+
+If compiled with -DUUDEFER a rule can queue its semantic actions (lookups,
+calls, output) instead of running them while the parse may still backtrack or
+fail. Actions are calls fn(p, n), kept in a queue that grows as needed; uurun()
+runs them in order once the top-level parse has succeeded and empties it:
+
+    void call(void *p, long n) { ... }
+    ...
+    if (accept(name) && accept(LPAREN)) {
+        ... args ...
+        uudefer(call, fn, nargs);
+    }
+    ...
+    expr();
+    uurun();
+
+A backtracking rule saves and restores with uumark() and uurollback(), which
+restore uu.lp and drop the actions queued after the mark; acceptall() does the
+same when a term fails. uuerror() and a failed expect() discard the queue, so
+on_uuerror starts with it empty. uuparse() drops the actions its rule queued
+unless it returns UUPARSE_OK, when they are left for the caller's uurun(). p is
+usually a pointer into uu.line, valid until uurun() if the line is not replaced
+before; but under uuparse() uu.line is its copy of the input, freed when it
+returns, so actions queued there must point at the app's own memory. uudetach()
+hands the queue to the app instead, to keep a parsed line as a list of actions
+and run it again without parsing. An action may call uuerror(). uumark() and
+uurollback() are also there without UUDEFER, saving only uu.lp.
+
+If compiled with -DUUINDENT the input can be a whole file with Python-style
+blocks. Three terminals are added to the app's UUTERMINALS, and skipspace()
+(so every accept and expect) stops at '\n' instead of skipping it:
+
+    NEWLINE     one or more '\n', with the blank lines after them
+    INDENT      the line at uu.lp is indented deeper than the current block
+    DEDENT      the line at uu.lp closes the current block; one per level
+
+    block:  name ":" NEWLINE INDENT { stmt } DEDENT
+
+INDENT and DEDENT consume nothing and only succeed at the first non-blank of
+a line. The block widths are kept on a stack (at most _UUINDENT_MAX deep);
+a tab advances the width to the next multiple of UUTABSIZE (default 8). A
+line that dedents to a width matching no enclosing block is reported through
+uuerror() with uu.lpfail at its first non-blank. At the end of the input
+DEDENT closes every open block, and NEWLINE matches there once unless the
+input ends with '\n'. Call uuindentinit() with each new input. The width of
+a line is measured once, 16 bytes at a time with SSE2, when NEWLINE moves to
+it; INDENT, DEDENT and any repeated DEDENTs there reuse it. uumark() and
+uurollback() save and restore the stack depth, but not blocks closed and
+reopened at another width after the mark.
+
+If compiled with -DUUTHREADS, uu and the rest of the scanner state (message
+buffer, action queue, indentation stack) are thread local, so threads can
+each parse their own input with the same grammar; every thread sets up its
+own uu.line, uu.lp and on_uuerror. Terminal tables and UUCACHE tables are
+shared. A thread's queued actions are not freed when it exits.
+
+If compiled with -DUUSDT, accept() and expect() carry USDT probes (uusdt.h,
+or the system's <sys/sdt.h> if included first) for perf, bpftrace or
+systemtap to attach to in a running program, provider uuscan:
+
+    term_entry  term, name, lp, line       before a terminal's scanner
+    term_exit   term, ok, uu.lp, line      after it
+    char        char, ok, lp, line         after a char scan
+    literal     literal, ok, lp, line      after a literal scan
+    expect_fail term, what, lpfail, line   a failed expect(), before its uuerror;
+                term -1: what is the literal, -2: the char, -3: the
+                keyword set's name
+    error       msg, lpfail, line          uuerror(), msg formatted (or NULL)
+
+lp is where the scan began, before space is skipped; the input offset is
+lp - line. Each probe is a nop with its arguments left where they already
+are. termlat.bt (per-terminal latency histograms) and uuerrors.bt (failed
+expects and errors by position) are bpftrace scripts for these probes.
+
+If compiled with -DUUPROF the rules can be profiled by sampling. A rule
+that starts with UURULE pushes a static entry for itself on a per-thread
+shadow stack, and pops it on return (a cleanup attribute); a terminal's
+scanner marks the terminal while it runs. UURULE expands to nothing without
+UUPROF, so it can stay in the grammar:
+
+    void term() { UURULE; factor(); ... }
+
+uuprof_start(1000) sets a SIGPROF timer; at each tick the signal handler
+copies the rule stack of the thread it interrupted (the innermost 32 of up to
+UUPROF_DEPTH, default 64, rules) and counts it in a fixed table, without
+locks or allocation. uuprof_report() writes one line per distinct stack,
+root first, with the terminal being scanned as the leaf, in the folded
+format that flamegraph.pl reads:
+
+    expr;term;factor;primary;_int_ 41
+
+Stacks sampled outside any rule are [no rule]. A uuerror() jump unwinds the
+stack to the depth at on_uuerror or uuparse(). The cost between samples is a
+few stores per rule call and per terminal scan.
+
+If compiled with -DUUBATCH, many short inputs scattered over memory (records
+found through a hash table or an index) can be parsed k at a time on one
+thread, so that their cache misses overlap instead of queueing. Each of the
+k parses is a coroutine with its own stack (UUBATCH_STACK, default 64K) that
+takes the next job and runs the rule on it as uuparse() would:
+
+    struct uujob jobs[n];       // { line, res, msg }: NUL terminated input
+    ...
+    uubatch(jobs, n, 8, record);
+    ... jobs[i].status is UUPARSE_OK, _NOMATCH, _TRAILING or _ERROR ...
+
+Every accept() and expect() compares where it is about to scan with how far
+this parse has prefetched. At a new input, or within 32 bytes of the end of
+what was fetched, it prefetches the next 192 bytes and switches to the next
+parse, which by then may have its own bytes in cache. A switch saves six
+registers and copies uu out and in; a parse that stays within fetched input
+pays one compare per scan. The rule sees uu as usual and may use uuerror()
+and uuparse(). Without a batch the same scan points only prefetch. x86-64
+only; not with UUDEFER, UUINDENT or UUPROF, whose stacks the parses would
+share. k = 1 is the same parse without the overlap. uubatch_yields() is the
+number of switches the last uubatch() made.
+
+If compiled with -DUUCOMPLETE the grammar can complete a partial line. The
+rule is run over the line by uucomplete(), as by uuparse() but with no
+message, and every accept() and expect() that would scan at the last word
+of the line (the text after the last space, empty if the line ends with a
+space) records what it was looking for:
+
+    struct uucandidate c[64];
+    int n = uucomplete(line, len, command, NULL, c, 64);
+    for (int i = 0; i < n && i < 64; ++i)
+        ... c[i].text: the literal, char, keyword or terminal name ...
+
+A literal or keyword is a candidate if the last word is a prefix of it, a
+char if the word is empty or that char, and a terminal whenever it is tried
+there (UUCAND_TERM: the app shows its name as a placeholder or expands it).
+A keyword set gives all its keywords under the word's prefix, from the
+trie. Candidates come in the order tried, each once; the return counts them
+all, even past max. Scans past the cursor word record nothing, and the run
+ends where the rule returns or fails, so the rule need not know it is
+completing. uu and the indentation stack are restored as by uuparse(), and
+the actions the rule queued are dropped. Outside uucomplete() each scan
+costs one more compare.
+
+If compiled with -DUURESUME a line that is edited a keystroke at a time
+(validated under the cursor, or as the user types a long command) can be
+reparsed from just before the edit instead of from the start:
+
+    struct uuresume *r = uuresume_new(filter, &res);
+    ...
+    switch (uuresume(r, msg, line, len)) {     // after each keystroke
+    case UUPARSE_OK: ...                       // as uuparse()
+    }
+
+The parse runs on a stack of its own (UURESUME_STACK, default 64K). At
+each scan past the furthest position scanned so far, it takes a checkpoint:
+uu, how far into the line the scans before it have read, and a copy of its
+stack, rules' locals and all (about 700 bytes in resume.c). uuresume()
+finds the first byte where the line differs from the one r parsed last,
+copies the last checkpoint that read nothing from there back onto the
+stack and returns into it; the rules go on from that scan as if the line
+had always been the new one. Appending to a line costs the last token or
+two and a copy of one checkpoint, whatever the length. A scan is taken to
+read up to where it stopped or failed, a literal its length, a keyword set
+the whole word.
+
+The rules' effects outside the parse are not undone: what they build
+should be in their locals, uu (UUVAL) or an arena whose top is uu.arena,
+which a checkpoint saves and a resume restores (0 at the start of a line),
+with the result stored through res at the end. Rules must decide only on
+scans, not by reading uu.lp themselves; a uuparse() inside the rule is not
+tracked. x86-64 only; not with UUDEFER, UUINDENT or UUPROF.
+
+If compiled with -DUUSTATIC uuscan makes no heap calls, for control loops
+and other code that may not allocate: what would grow is a fixed pool, and
+a full pool fails the parse, with the same error every time:
+
+    UUSTATIC_KEYNODES  4096  trie nodes of all UUKEYS sets, one per keyword
+                             char and one per set; full: uukeys_init() is
+                             false and a scan of the set raises uuerror()
+    UUSTATIC_KEYWORDS  1024  keywords in one set
+    UUSTATIC_ACTIONS   256   UUDEFER queue, per thread; full: uudefer()
+                             raises "more than 256 deferred actions"
+    UUSTATIC_LINE      1024  uuparse() and uucomplete() copy on the stack;
+                             longer: UUPARSE_ERROR, "input longer than 1023
+                             chars"
+
+UUCACHE tables are static (a table of UUCACHE 56-byte entries per
+terminal). Tries are cut from the pool and never freed, and only
+uukeys_init() builds one, under a lock: call it for each set at startup,
+as a scan of a set it did not build raises uuerror() rather than waiting.
+uudetach() is not there, and neither UUBATCH nor UURESUME can be used. The
+message buffer, indentation stack and UUPROF tables are static anyway;
+UUTRACE writes through stdio, which should be given a buffer with setvbuf().
+
+The work per input byte is bounded, with no loop that waits or retries:
+
+    skipspace()     one test per space
+    char            one compare
+    literal         at most its length + 1 compares, whatever the input
+    keyword set     per char of the word, a scan of at most 64 children
+    UUCACHE         a hash of at most 24 bytes and a compare; a get or
+                    put that meets another put misses instead of waiting
+    uudefer()       a few stores
+    uuerror()       formatting at most 80 chars, and a longjmp
+    terminal        the app's scanner
+
+A parse reads each byte once per scan that reaches it: a grammar that
+tries k alternatives at a point, or rolls back over it, reads its bytes up
+to k times, and that k is the grammar's to bound. rtloop.c times each
+primitive on its costliest input and counts heap calls while parsing.
+
+If compiled with -DUULAZY a rule can skip a bracketed block instead of
+parsing it, and parse it when it is first wanted, so loading a large
+config costs the blocks used and a fast scan of the rest:
+
+    struct uuthunk body;
+    if (!uuskip('{', '}', UUSKIP_HASH, &body))    // at uu.lp, like accept()
+        ...
+    if (uuforce(msg, &body, block, &res) != UUPARSE_OK) // later, when used
+        ... msg ...
+
+uuskip() finds the close that balances the open, past brackets in "..."
+strings (with backslash escapes) and, by flags, in '...' strings
+(UUSKIP_SQUOTE), # comments (UUSKIP_HASH) and // and block comments
+(UUSKIP_SLASH). With SSE2 it takes 16 bytes a compare: the brackets before
+the first quote or comment start are counted with popcount, and walked one
+at a time only where the closes could balance; a string or comment is
+jumped with a vectorized search for its end. A missing close fails it with
+uu.failmsg "unterminated block". uuforce() runs rule at the block's open,
+in place, as uuparse() would: positions in msg count from t->line, the
+input the block was skipped in, which must be kept. The status is kept in
+t and later calls return it without parsing. lazy.c loads a 16MB config in
+about a third of the time of a full parse, 2.7 times as fast as skipping a
+byte at a time.
+
 If compiled with -DUUDEBUG then uudebugf() output is activated when environment
-variabe UUDEBUG is defined.
+variabe UUDEBUG is defined (looked up once, at the first debug message).
+
+If compiled with -DUUTRACE then setting uu.trace to an open FILE * records the
+shape of each parse: one record per accept/expect primitive with the terminal,
+char or literal scanned, start and end offsets into uu.line and the outcome.
+Call uutrace_line() after setting uu.line to write a content-free fingerprint
+of the line (letters become x/X, digits 1, punctuation and space kept) ahead of
+its records. uureplay() reads a trace back and rebuilds each line from its
+fingerprint with the matched literals and chars restored, so the same grammar
+can be run on the synthetic line to reproduce the scan sequence and its costs
+without the original input:
+
+    while (uureplay(fp, buf, sizeof buf)) {
+        uu.lp = uu.line = buf;
+        ...
+    }
+
+Terminals whose cost depends on the value of the bytes rather than their
+class (overflow checks, symbol lookups) may follow a different path on replay.
+
+If compiled with -DUUCACHE=n a terminal can keep the values it converted in a
+table of n (a power of 2) entries, so repeated spans (timeouts, thresholds,
+addresses) skip the conversion. The scanner finds the span first, looks it up
+and converts only on a miss:
+
+    UUDEFINE(T)
+    {
+        char *end = <end of span at lp>;
+        if (uucache_get(T, lp, end - lp, &uu.d, sizeof uu.d))
+            return success(end);
+        uu.d = <convert>;
+        uucache_put(T, lp, end - lp, &uu.d, sizeof uu.d);
+        return success(end);
+    }
+
+Spans over 24 bytes and values over 16 bytes are not cached, nor should values
+that point into the line. A table is allocated on the first put for its
+terminal and is a direct mapped cache, bounded by n. Entries are seqlocked:
+lookups take no lock and a put that meets another put skips, so one table can
+be shared between threads. uucache_report() prints lookups and hits.
+
+The header also compiles as C++17. accept/expect then select the scanner by
+overload instead of _Generic, acceptall is a variadic template, and literal
+length and boundary classes are constexpr so they fold at each call site
+(literal bytes are classified as in the C locale). A UUDEFINE(T, <type> *res)
+scanner gets a void * wrapper that casts back to its declared type, and
+terminals are dispatched by switch rather than through uuterms[].fn, so a
+scanner called with a constant terminal can be inlined. Char literals are
+char in C++, so accept('x') scans the char without CHAR(). uuerror() is a
+longjmp: objects with destructors must not be live in the rule functions
+between on_uuerror and the jump.
 
 Sep22-SP simplified from a previous version
 Dec23-SP 2nd arg method of value returns; uu.val retired
@@ -148,16 +535,40 @@ Dec23-SP 2nd arg method of value returns; uu.val retired
 #ifndef _STRING_H
 #include <string.h>
 #endif
+#ifndef _STDDEF_H
+#include <stddef.h>
+#endif
 #ifndef _STDARG_H
 #include <stdarg.h>
 #endif
+#ifndef _STDLIB_H
+#include <stdlib.h>
+#endif
+#ifndef _STDINT_H
+#include <stdint.h>
+#endif
+#if (defined(UUINDENT) || defined(UULAZY)) && defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#ifdef UUPROF
+#include <signal.h>
+#include <sys/time.h>
+#endif
+#ifdef UUSDT
+#include "uusdt.h"
+#define _uusdt(...)         __VA_ARGS__
+#else
+#define _uusdt(...)         /**/
+#endif
 
+#ifdef __clang__
 #pragma clang diagnostic ignored "-Wformat-extra-args"
 #pragma clang diagnostic ignored "-Wparentheses"
 #pragma clang diagnostic ignored "-Wdeprecated-non-prototype"
 #pragma clang diagnostic ignored "-Wmain-return-type"
 // UUDEFINE(t)/UUDEFINE(t,&v) optional 2nd arg triggers warning:
 #pragma clang diagnostic ignored "-Wc2x-extensions"
+#endif
 //}}}
 
 // *** declare terminals in application prior to including uuscan.h: ***
@@ -165,9 +576,18 @@ Dec23-SP 2nd arg method of value returns; uu.val retired
 #error define UUTERMINALS with 1 or more terminal names using X(..)
 #endif
 
+// the app's terminals and the built-in ones
+#ifdef UUINDENT
+#define _UUTERMS    UUTERMINALS X(INDENT) X(DEDENT) X(NEWLINE)
+#else
+#define _UUTERMS    UUTERMINALS
+#endif
+
+#ifndef __cplusplus
 #ifndef inline
 #define inline __always_inline
 #endif
+#endif
 
 //{{{ VA_COUNT macro
 // this is a hack to count number of arguments in a variadic macro
@@ -181,26 +601,82 @@ Dec23-SP 2nd arg method of value returns; uu.val retired
 #define VA_COUNT(...) _ARGC(_, ##__VA_ARGS__, _ARGSEQ)
 #endif
 //}}}
+//{{{ code placement
+// error reporting and debug output sit in cold, out of line functions so the
+// accept/expect expansions in grammar rules stay small; failure is unlikely
+#define _uucold             __attribute__((cold, noinline))
+#define _uunoreturn         __attribute__((noreturn))
+#define _uuunlikely(x)      __builtin_expect(!!(x), 0)
+#define _uuinline           inline __attribute__((always_inline))
+// on the static API functions, of which an app calls only some
+#define _uuunused           __attribute__((unused))
+
+// with UUTHREADS the scanner state is per thread
+#if !defined(UUTHREADS)
+#define _uutls
+#elif defined(__cplusplus)
+#define _uutls              thread_local
+#else
+#define _uutls              _Thread_local
+#endif
+
+// glibc's ctype.h gives C table lookup macros but C++ a function call per
+// char; uuisspace() etc. read the same table directly in C++
+#if defined(__cplusplus) && defined(__GLIBC__)
+#define _uuctype(c,m)       ((*__ctype_b_loc())[(int)(c)] & (unsigned short)(m))
+#define uuisspace(c)        _uuctype(c, _ISspace)
+#define uuisalpha(c)        _uuctype(c, _ISalpha)
+#define uuisdigit(c)        _uuctype(c, _ISdigit)
+#define uuisalnum(c)        _uuctype(c, _ISalnum)
+#define uuisxdigit(c)       _uuctype(c, _ISxdigit)
+#else
+#define uuisspace(c)        isspace(c)
+#define uuisalpha(c)        isalpha(c)
+#define uuisdigit(c)        isdigit(c)
+#define uuisalnum(c)        isalnum(c)
+#define uuisxdigit(c)       isxdigit(c)
+#endif
+//}}}
+//{{{ UUSTATIC pools
+// no heap: what would grow is a fixed pool, and a full pool is an error
+#ifdef UUSTATIC
+#if defined(UUBATCH) || defined(UURESUME)
+#error UUBATCH and UURESUME allocate a stack for each parse: not with UUSTATIC
+#endif
+#ifndef UUSTATIC_KEYNODES
+#define UUSTATIC_KEYNODES   4096    // trie nodes of all UUKEYS sets together
+#endif
+#ifndef UUSTATIC_KEYWORDS
+#define UUSTATIC_KEYWORDS   1024    // keywords in the largest set
+#endif
+#ifndef UUSTATIC_ACTIONS
+#define UUSTATIC_ACTIONS    256     // UUDEFER actions queued at once, per thread
+#endif
+#ifndef UUSTATIC_LINE
+#define UUSTATIC_LINE       1024    // longest uuparse() input + 1, copied to the stack
+#endif
+#endif
+//}}}
 //{{{ UUDEBUG
 #ifdef UUDEBUG
+// UUDEBUG environment variable is looked up on first use
+static int _uudebug = -1;
 #define uudebugf(...) do{                                      \
-        if (getenv("UUDEBUG") == NULL) break;                  \
-        fprintf(stderr, "uuscan: %s %d: ", uu.fn, uu.linenum); \
-        fprintf(stderr, __VA_ARGS__);                          \
-        fprintf(stderr, " lp=[");                              \
-        for (char *cp = uu.lp; *cp; ++cp)                      \
-            if (isprint(*cp))                                  \
-                fputc(*cp, stderr);                            \
-            else                                               \
-                fprintf(stderr, "\\%03o", *cp);                \
-        fputc(']', stderr);                                    \
-        fputc('\n', stderr); }while(0)
+        if (_uudebug < 0) _uudebug = getenv("UUDEBUG") != NULL;\
+        if (_uudebug) _uudebugf(__VA_ARGS__); }while(0)
 #else
 #define uudebugf(...) /**/
 #endif
 //}}}
 
-static struct uuscan {
+#ifdef UUDEBUG
+struct uusite {
+    const char *fn;
+    int linenum;
+};
+#endif
+
+static _uutls struct uuscan {
     char *line;         // ptr to current line being scanned
     char *lp;           // advancing ptr into line updated after scan by accept(),expect()
     char *lpstart;      // start of current input scan
@@ -208,16 +684,36 @@ static struct uuscan {
     int len;            // length of successfully scanned element
     char ch;            // saves last char literal scanned
     char *msg;          // ptr to message for on_error target; usually local _uumsgbuf
-    char *failmsg;      // additional fail message:
+    const char *failmsg;// additional fail message:
                         // appended to expect() fail uuerror message
                         // could also be used after failed accept() by caller
     void (*callback)(); // if non NULL, callback is called before uuerror() jump is made
                         // allows for clean-up code prior to uuerror message
                         // uuerror() will reset to NULL
     jmp_buf errjmp;     // uuerror() jump target: on_uuerror
+    jmp_buf *jmp;       // current target, &errjmp or uuparse()'s
+#ifdef UUDEFER
+    int nactions;       // deferred actions queued
+#endif
+#ifdef UUINDENT
+    int indents;        // open blocks on the indentation stack
+    char *indentat;     // first non-blank of the last measured line
+    int indentw;        // and its indentation width
+#endif
 #ifdef UUDEBUG
-    const char *fn;
-    int linenum;
+    const struct uusite *site; // accept() call site, one store per call
+#endif
+#ifdef UUTRACE
+    FILE *trace;        // if non NULL, scan records are written here
+#endif
+#ifdef UUBATCH
+    char *ahead;        // end of the input prefetched, NULL at a new input
+#endif
+#ifdef UUCOMPLETE
+    char *cw;           // uucomplete(): the word at the cursor, else NULL
+#endif
+#ifdef UURESUME
+    size_t arena;       // app's: saved at each checkpoint, restored on resume
 #endif
 #ifdef UUVAL
     UUVAL;              // converted terminal value temporaries, examples:
@@ -225,17 +721,163 @@ static struct uuscan {
                         // #define UUVAL union { int i; char *str; }
 #endif
 } uu;
-static char _uumsgbuf[80];
+static _uutls char _uumsgbuf[80];
+
+// all of uu but errjmp: a nested parse, or one on its own stack, has its
+// error target elsewhere, through uu.jmp, and errjmp is most of uu
+static _uuinline void
+_uucopy(struct uuscan *to, const struct uuscan *from)
+{
+    size_t a = offsetof(struct uuscan, errjmp), b = offsetof(struct uuscan, jmp);
+
+    memcpy(to, from, a);
+    memcpy((char *)to + b, (const char *)from + b, sizeof uu - b);
+}
+
+//{{{ UUPROF rule stack
+#ifdef UUPROF
+#ifndef UUPROF_DEPTH
+#define UUPROF_DEPTH    64
+#endif
+
+struct uurule {
+    const char *name;
+};
+
+// the rules entered, pushed and popped by UURULE; depth can exceed
+// UUPROF_DEPTH, frames past it are not kept. volatile so that the stores
+// happen in program order as the sampling signal handler sees them
+static _uutls struct {
+    volatile int depth;
+    volatile int term;              // terminal being scanned, -1 if none
+    int base;                       // depth at the uuerror target
+    const struct uurule *volatile frame[UUPROF_DEPTH];
+} _uuprof_stack = { 0, -1 };
+
+static _uuinline int
+_uuprof_push(const struct uurule *r)
+{
+    int d = _uuprof_stack.depth;
+
+    if (d < UUPROF_DEPTH)
+        _uuprof_stack.frame[d] = r;
+    _uuprof_stack.depth = d + 1;
+    return d;
+}
+
+static _uuinline void
+_uuprof_pop(int *d)
+{
+    _uuprof_stack.depth = *d;
+}
+
+#define UURULE                                                          \
+    static const struct uurule _uurule = { __func__ };                  \
+    __attribute__((cleanup(_uuprof_pop))) int _uurule_depth = _uuprof_push(&_uurule)
+#define _uuprofbase()       (_uuprof_stack.base = _uuprof_stack.depth)
+#define _uuprofunwind()     \
+    (_uuprof_stack.depth = _uuprof_stack.base, _uuprof_stack.term = -1)
+#else
+#define UURULE              /**/
+#define _uuprofbase()       (void)0
+#define _uuprofunwind()     (void)0
+#endif
+//}}}
+
+// a point to backtrack to: the input position and the actions queued up to it
+struct uumark {
+    char *lp;
+#ifdef UUDEFER
+    int nactions;
+#endif
+#ifdef UUINDENT
+    int indents;
+#endif
+};
+
+static _uuinline struct uumark
+uumark(void)
+{
+    struct uumark m;
+
+    m.lp = uu.lp;
+#ifdef UUDEFER
+    m.nactions = uu.nactions;
+#endif
+#ifdef UUINDENT
+    m.indents = uu.indents;
+#endif
+    return m;
+}
+
+static _uuinline void
+uurollback(struct uumark m)
+{
+    uu.lp = m.lp;
+#ifdef UUDEFER
+    uu.nactions = m.nactions;
+#endif
+#ifdef UUINDENT
+    uu.indents = m.indents;
+#endif
+}
+
+#ifdef UUDEBUG
+static _uucold void
+_uudebugf(const char *fmt, ...)
+{
+    va_list ap;
+
+    fprintf(stderr, "uuscan: %s %d: ", uu.site->fn, uu.site->linenum);
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fprintf(stderr, " lp=[");
+    for (char *cp = uu.lp; *cp; ++cp)
+        if (isprint(*cp))
+            fputc(*cp, stderr);
+        else
+            fprintf(stderr, "\\%03o", *cp);
+    fputc(']', stderr);
+    fputc('\n', stderr);
+}
+#endif
 
 #define UUDEFINE(...)      _uudefine(VA_COUNT(__VA_ARGS__), __VA_ARGS__)
 #define _uudefine(n,...)   CONCAT(_uudefine,n)(__VA_ARGS__)
 #define _uudefine0(...)    ;
 #define _uudefine1(x)      static bool _scan_##x(char *lp, void *)
+#ifndef __cplusplus
 #define _uudefine2(x,res)  static bool _scan_##x(char *lp, res)
+#else
+// _scan_T takes void * like every scanner; the app's body becomes _uuscan_T
+// with the declared result type, recovered from its own signature
+template <class F> struct _uuresult;
+template <class T> struct _uuresult<bool(char *, T)> { typedef T type; };
+
+#define _uudefine2(x,res)  static bool _uuscan_##x(char *lp, res);              \
+    static _uuinline bool _scan_##x(char *lp, void *r)                          \
+    { return _uuscan_##x(lp, (_uuresult<decltype(_uuscan_##x)>::type)r); }      \
+    static bool _uuscan_##x(char *lp, res)
+#endif
+
+// state functions share the scanner signature so that uunext() is a tail
+// call the compiler can make a jump; musttail makes it a guarantee
+#ifdef __has_attribute
+#if __has_attribute(musttail)
+#define _uumusttail         __attribute__((musttail))
+#endif
+#endif
+#ifndef _uumusttail
+#define _uumusttail         /* sibling call, a jump at -O2 */
+#endif
+#define UUSTATE(s)          static bool s(char *lp, void *res)
+#define uunext(s,p)         _uumusttail return s(p, res)
 
+#ifndef __cplusplus
 // autobuild terminal enum constants:
 #define X(t)  t=__COUNTER__,
-static enum { UUTERMINALS } terms;
+static _uuunused enum { _UUTERMS } terms;
 #undef X
 
 // enum must be used to save current __COUNTER__ value
@@ -243,18 +885,43 @@ enum { UUTERMCOUNT = __COUNTER__ };
 
 // autobuild forward decl of _scan_T_() functions:
 #define X(t)  static bool _scan_##t();
-UUTERMINALS
+_UUTERMS
 #undef X
 
 // autobuild list of ptrs to scanning functions:
 static struct uuterm {
     bool (*fn)();
-    char *name;
+    const char *name;
 } uuterms[UUTERMCOUNT] = {
 #define X(t)  [t]={_scan_##t, #t},
-    UUTERMINALS
+    _UUTERMS
+};
+#undef X
+#else
+// no designated array initialisers in C++: terminals count from 0 so the
+// table can be filled in order
+#define X(t)  t,
+static _uuunused enum { _UUTERMS } terms;
+#undef X
+
+#define X(t)  +1
+enum { UUTERMCOUNT = 0 _UUTERMS };
+#undef X
+
+#define X(t)  static bool _scan_##t(char *, void *);
+_UUTERMS
+#undef X
+
+// fn is kept for the app; __scan_term calls the scanners directly
+static struct uuterm {
+    bool (*fn)(char *, void *);
+    const char *name;
+} uuterms[UUTERMCOUNT] = {
+#define X(t)  {_scan_##t, #t},
+    _UUTERMS
 };
 #undef X
+#endif
 
 // accept() does nothing
 // accept(t) call scanner t depending on type selection
@@ -266,22 +933,27 @@ static struct uuterm {
 #define _accept1(x)      __accept(x, NULL)
 #define _accept2(x,res)  __accept(x, res)
 
-#if UUDEBUG
-#define __accept(x,res)                                   \
-    (uu.fn=__FUNCTION__, uu.linenum=__LINE__, _Generic(x, \
-    const char*: __scan_literal,                          \
-    char*: __scan_literal,                                \
-    char: __scan_char,                                    \
-    int: __scan_term,                                     \
-    default: __unknown3) (x, uu.lp, res))
-#else
-#define __accept(x,res)                    \
+#ifndef __cplusplus
+#define _uuscanner(x)                      \
     _Generic(x,                            \
     const char*: __scan_literal,           \
     char*: __scan_literal,                 \
     char: __scan_char,                     \
     int: __scan_term,                      \
-    default: __unknown3) (x, uu.lp, res)
+    struct uukeys*: __scan_keys,           \
+    default: __unknown3)
+#else
+#define _uuscanner(x)   _uuscan     // overloaded below
+#endif
+
+#if UUDEBUG
+#define _uusite() ({                                           \
+    static const struct uusite _site = { __func__, __LINE__ }; \
+    uu.site = &_site; })
+
+#define __accept(x,res)     (_uusite(), _uuscanner(x)(x, uu.lp, res))
+#else
+#define __accept(x,res)     _uuscanner(x)(x, uu.lp, res)
 #endif
 
 #define CONCAT(a,b)         a ## b
@@ -295,13 +967,17 @@ static struct uuterm {
 
 // acceptall will call accept() on each argument until failure or all accepted
 // acceptall scans only, does not save scan result (result 2nd arg is null)
-// if any term fails then uu.lp is unchanged
+// if any term fails then uu.lp and the deferred actions are unchanged
 
+#ifndef __cplusplus
 #define acceptall(t,...)                                               \
-        ({ char *savelp = uu.lp; bool r=false;                         \
+        ({ struct uumark savem = uumark(); bool r=false;               \
         if (_ACCEPTALL(VA_COUNT(__VA_ARGS__), t, __VA_ARGS__)) r=true; \
-        else uu.lp = savelp;                                           \
+        else uurollback(savem);                                        \
         r; })
+#else
+#define acceptall(...)      _uuacceptall(__VA_ARGS__)   // defined below
+#endif
 
 #define uuerrorpos()        (int)((uu.lpfail - uu.line) + 1)
 
@@ -330,37 +1006,69 @@ static struct uuterm {
 #define _expect2(x,res)     __expect(x, res, NULL)
 #define _expect3(x,res,msg) __expect(x, res, msg)
 
-#define __expect(x,res,msg) do {        \
-    if (accept(x,res)==false) {         \
-        _expect_msg(x,msg);             \
-        longjmp(uu.errjmp,1); }         \
+// a failed expect() calls one out of line function that formats the
+// message and makes the uuerror jump
+#define __expect(x,res,msg) do {            \
+    if (_uuunlikely(accept(x,res)==false))  \
+        _expect_msg(x,msg);                 \
     }while(0)
 
+#ifndef __cplusplus
 #define _expect_msg(x, msg) _Generic(x, \
     const char*: _msg_str,              \
     char*: _msg_str,                    \
     char: _msg_char,                    \
     int: _msg_term,                     \
+    struct uukeys*: _msg_keys,          \
     default: __unknown2)(x, msg)
+#else
+#define _expect_msg(x, msg) _uumsg(x, msg)
+#endif
 
-#define on_uuerror  uu.msg = _uumsgbuf; if (setjmp(uu.errjmp))
+// every uuerror() jump discards the deferred actions and unwinds the rule
+// stack to the target's depth (UUPROF)
+#ifdef UUDEFER
+#define _uujump()           (uu.nactions = 0, _uuprofunwind(), longjmp(*uu.jmp, 1))
+#else
+#define _uujump()           (_uuprofunwind(), longjmp(*uu.jmp, 1))
+#endif
+
+#define on_uuerror  \
+    uu.msg = _uumsgbuf; uu.jmp = &uu.errjmp; _uuprofbase(); if (setjmp(uu.errjmp))
+
+// leading NULL lets uuerror() take no arguments; the trailing "" is the
+// format when there are none
+#define uuerror(...)    _uuerror(NULL,## __VA_ARGS__, "")
 
-#define uuerror(...) do{                                  \
-    sprintf(uu.msg,## __VA_ARGS__, "");                   \
-    if (uu.callback) { uu.callback(); uu.callback=NULL; } \
-    longjmp(uu.errjmp,1);                                 \
-    } while(0)
+static _uuunused _uucold _uunoreturn void
+_uuerror(void *unused, const char *fmt, ...)
+{
+    va_list ap;
+
+    if (uu.msg) { // NULL from uuparse() when no message is wanted
+        va_start(ap, fmt);
+        vsprintf(uu.msg, fmt, ap);
+        va_end(ap);
+    }
+    _uusdt(STAP_PROBE3(uuscan, error, uu.msg, uu.lpfail, uu.line));
+    if (uu.callback) { uu.callback(); uu.callback=NULL; }
+    _uujump();
+}
 
-inline static inline char *
+static _uuinline char *
 skipspace(char *cp)
 {
-    while (isspace(*cp))
+#ifdef UUINDENT
+    while (uuisspace(*cp) && *cp != '\n') // line breaks are NEWLINE
+#else
+    while (uuisspace(*cp))
+#endif
         ++cp;
     return cp;
 }
 
 // scan for a single char
-inline static inline bool
+static _uuinline bool
 __scan_char(char wanted, char *lp, void *res)
 {
 #if UUDEBUG
@@ -370,7 +1078,7 @@ __scan_char(char wanted, char *lp, void *res)
         uudebugf("scan_char '\\%03o'", wanted);
 #endif
 
-    if (isspace(wanted) && isspace(*lp)) {
+    if (uuisspace(wanted) && uuisspace(*lp)) {
         ++lp;
         if (res)
             *(char *)res = wanted;
@@ -391,45 +1099,92 @@ __scan_char(char wanted, char *lp, void *res)
     return fail(lp);
 }
 
+#ifndef __cplusplus
+#define _uuscanfn(x,lp,res) (uuterms[x].fn)(lp, res)
+#else
+// a constant x selects one direct call, which the compiler can inline
+static _uuinline bool
+_uuscanfn(int x, char *lp, void *res)
+{
+    switch (x) {
+#define X(t)  case t: return _scan_##t(lp, res);
+    _UUTERMS
+#undef X
+    }
+    return false;
+}
+#endif
+
 // scan for an app-defined terminal index x
-static inline bool
+static _uuinline bool
 __scan_term(int x, char *lp, void *res) 
 {
     lp = skipspace(lp);
     uu.lpfail = uu.lpstart = lp;
     uu.failmsg = NULL;
     uu.len = 0;
+#ifdef UUPROF
+    int outer = _uuprof_stack.term; // a scanner may scan other terminals
+    _uuprof_stack.term = x;
+#endif
+    bool ret = _uuscanfn(x, lp, res);
+#ifdef UUPROF
+    _uuprof_stack.term = outer;
+#endif
 #if UUDEBUG
-    bool ret = (uuterms[x].fn)(lp, res);
     uudebugf("scan_term %s: %s\n", uuterms[x].name, ret? "success" : "fail");
+#endif
     return ret;
+}
+
+// literal classes: starts with space (no space skip), ends alpha or digit
+// (must not run into another alpha or digit)
+enum { _UULIT_SPACE = 1, _UULIT_ALPHA = 2, _UULIT_DIGIT = 4 };
+
+#ifndef __cplusplus
+#define _uulitlen(s)        strlen(s)
+#define _uulitfn            static inline
+#define _uulitspace(c)      isspace(c)
+#define _uulitalpha(c)      isalpha(c)
+#define _uulitdigit(c)      isdigit(c)
 #else
-    return (uuterms[x].fn)(lp, res);
+// constexpr and locale free, so a literal's length and classes are compile
+// time constants at each accept()
+#define _uulitfn            static constexpr
+static constexpr int _uulitlen(const char *s) { return __builtin_strlen(s); }
+static constexpr bool _uulitspace(char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+static constexpr bool _uulitalpha(char c) { return (c|32) >= 'a' && (c|32) <= 'z'; }
+static constexpr bool _uulitdigit(char c) { return c >= '0' && c <= '9'; }
 #endif
+
+_uulitfn int
+_uulitclass(const char *s, int l)
+{
+    return (_uulitspace(*s)? _UULIT_SPACE : 0)
+         | (l && _uulitalpha(s[l-1])? _UULIT_ALPHA : 0)
+         | (l && _uulitdigit(s[l-1])? _UULIT_DIGIT : 0);
 }
 
-// scan for literal text
-static bool
-__scan_literal(const char *wanted, char *lp, void *res)
+// scan for literal text of length l and classes cls
+static _uuinline bool
+_uulit(const char *wanted, int l, int cls, char *lp, void *res)
 {
     uudebugf("scan_literal \"%s\"", wanted);
 
     if (*lp == '\0')
         return *wanted=='\0'? success(lp) : fail(lp); // allows for accept("")
 
-    if (!isspace(*wanted)) // if not looking for space, skip over it
+    if (!(cls & _UULIT_SPACE)) // if not looking for space, skip over it
         lp = skipspace(lp);
 
-    int l = strlen(wanted);
     uu.lpstart = lp;
 
-    if (strlen(lp) < l)
-        return fail(lp);
-
+    // strncmp stops at the end of lp, so a match implies lp[l] is in bounds;
+    // measuring strlen(lp) first would cost the rest of the line on every call
     if (strncmp(wanted, lp, l) == 0) {
-        if (isalpha(wanted[l-1]) && isalpha(lp[l]))
+        if ((cls & _UULIT_ALPHA) && uuisalpha(lp[l]))
             return fail(lp);
-        else if (isdigit(wanted[l-1]) && isdigit(lp[l]))
+        else if ((cls & _UULIT_DIGIT) && uuisdigit(lp[l]))
             return fail(lp);
         else // punctuation (not alpha or digit) is a single char match
             lp += l;
@@ -446,57 +1201,2050 @@ __scan_literal(const char *wanted, char *lp, void *res)
     return success(lp);
 }
 
-// these are never called, they catch unknown type selector in the _Generic(..)
-// accept() with unknown type is a compile error
-static void __unknown3(void *a, void *b, void *c) {}
-static void __unknown2(void *a, void *b) {}
+#ifndef __cplusplus
+static bool
+__scan_literal(const char *wanted, char *lp, void *res)
+{
+    int l = _uulitlen(wanted);
+    return _uulit(wanted, l, _uulitclass(wanted, l), lp, res);
+}
+#else
+static bool
+_uuscan_literal(const char *wanted, int l, int cls, char *lp, void *res)
+{
+    return _uulit(wanted, l, cls, lp, res);
+}
 
-// literal, char, and user-term messages for failed expect()
+// inlined so the constexpr length and classes of a literal fold
+static _uuinline bool
+__scan_literal(const char *wanted, char *lp, void *res)
+{
+    int l = _uulitlen(wanted);
+    return _uuscan_literal(wanted, l, _uulitclass(wanted, l), lp, res);
+}
+#endif
+
+//{{{ keyword sets
+// a keyword set is a trie built on first use: the children of a node are
+// contiguous, and each node knows the keyword, if any, that its prefix
+// picks out, so a word is resolved in one pass over its chars
+struct uukeyword {
+    const char *word;   // alnum, '-' and '_'
+    int min;            // shortest abbreviation accepted, 0 for any unique prefix
+};
+
+struct _uukeynode {
+    unsigned char c;    // the char into this node
+    unsigned char nchild;
+    short exact;        // keyword ending here, or -1
+    short only;         // the one keyword this prefix abbreviates, or -1
+    short nabbrev;      // keywords this prefix abbreviates, at most 2
+    int child;          // first child
+};
+
+struct uukeys {
+    const char *name;   // what expect() reports as expected
+    const struct uukeyword *words;
+    int n;
+    struct _uukeynode *trie;
+};
+
+#define UUKEYS(name, words) { name, words, (int)(sizeof words / sizeof words[0]), NULL }
+
+#define _uukeychar(c)       (uuisalnum(c) || (c) == '-' || (c) == '_')
+
+struct _uukeyrun {
+    int lo, hi;         // keywords under a node being built, in sorted order
+};
+
+#ifndef UUSTATIC
+static _uutls const struct uukeyword *_uukeybase;
 
-static void 
-_msg_str(char *s, char *msg)
+static int
+_uukeycmp(const void *a, const void *b)
 {
-    if (msg == NULL)
-        sprintf(uu.msg, "expected \"%s\" at pos %d", s, uuerrorpos());
-    else
-        sprintf(uu.msg, "%s at pos %d", msg, uuerrorpos());
+    return strcmp(_uukeybase[*(const short *)a].word, _uukeybase[*(const short *)b].word);
 }
 
-static void 
-_msg_char(char c, char *msg)
+static void
+_uukeysort(const struct uukeys *k, short *order)
 {
-    if (msg)
-        sprintf(uu.msg, "%s at pos %d", msg, uuerrorpos());
-    else {
-        if (isprint(c))
-            sprintf(uu.msg, "expected '%c' at pos %d", c, uuerrorpos());
-        else
-            sprintf(uu.msg, "expected '\\%03o' at pos %d", c, uuerrorpos());
+    _uukeybase = k->words;      // qsort has no context argument
+    qsort(order, k->n, sizeof *order, _uukeycmp);
+}
+
+// a trie of nodes, and the scratch to build it; false if out of memory
+static bool
+_uukeyget(const struct uukeys *k, int nodes, struct _uukeynode **t,
+          struct _uukeyrun **run, short **order)
+{
+    *t = (struct _uukeynode *)calloc(nodes, sizeof **t);
+    *run = (struct _uukeyrun *)malloc(nodes * sizeof **run);
+    *order = (short *)malloc((k->n + 1) * sizeof **order);
+    if (*t == NULL || *run == NULL || *order == NULL) {
+        free(*t);
+        free(*run);
+        free(*order);
+        return false;
     }
+    return true;
 }
 
-static void 
-_msg_term(int t, char *msg)
+static void
+_uukeyput(struct _uukeyrun *run, short *order)
 {
-    sprintf(uu.msg, "%s%s at pos %d", 
-            msg==NULL? "expected " : "",
-            msg==NULL? uuterms[t].name : msg, uuerrorpos());
+    free(run);
+    free(order);
+}
 
-    if (uu.failmsg) {
-        strcat(uu.msg, " (");
-        strcat(uu.msg, uu.failmsg);
-        strcat(uu.msg, ")");
+static void
+_uukeydrop(struct _uukeynode *t)
+{
+    free(t);
+}
+#else
+// tries are cut from one pool and never freed, and built only by
+// uukeys_init(), which holds the lock and the scratch: a scan does not wait
+static struct _uukeynode _uukeypool[UUSTATIC_KEYNODES];
+static struct _uukeyrun _uukeyruns[UUSTATIC_KEYNODES];
+static short _uukeyorder[UUSTATIC_KEYWORDS + 1];
+static int _uukeyused, _uukeylock;
+
+// insertion sort: qsort() may allocate
+static void
+_uukeysort(const struct uukeys *k, short *order)
+{
+    for (int i = 1; i < k->n; ++i) {
+        short o = order[i];
+        int j;
+
+        for (j = i; j > 0 && strcmp(k->words[order[j - 1]].word, k->words[o].word) > 0;
+             --j)
+            order[j] = order[j - 1];
+        order[j] = o;
     }
 }
 
-// accept('x') -- a char constant is promoted to int and would select
-// __scan_term in _Generic, so casting to char is required for char literals:
-// accept((char)'x'), or use convenience macros:
+// under _uukeylock
+static bool
+_uukeyget(const struct uukeys *k, int nodes, struct _uukeynode **t,
+          struct _uukeyrun **run, short **order)
+{
+    if (k->n > UUSTATIC_KEYWORDS || nodes > UUSTATIC_KEYNODES - _uukeyused)
+        return false;
+    *t = &_uukeypool[_uukeyused];
+    _uukeyused += nodes;
+    *run = _uukeyruns;
+    *order = _uukeyorder;
+    return true;
+}
 
-#define CHAR(x) (char)x
+static void
+_uukeyput(struct _uukeyrun *run, short *order)
+{
+}
+#endif
 
-// e.g.
-// #define EQ  CHAR('=')
-// ...
-// accept(CHAR('*'));
-// expect(EQ);
+// the nodes are laid out breadth first over the keywords sorted, so the
+// keywords under a node are a run of the sorted order
+static struct _uukeynode *
+_uukeybuild(const struct uukeys *k)
+{
+    struct _uukeynode *t;
+    struct _uukeyrun *run;      // keywords under each node
+    short *order;
+    int nodes = 1, used = 1;
+
+    for (int i = 0; i < k->n; ++i)
+        nodes += strlen(k->words[i].word);
+    if (!_uukeyget(k, nodes, &t, &run, &order))
+        return NULL;
+    for (int i = 0; i < k->n; ++i)
+        order[i] = i;
+    _uukeysort(k, order);
+
+    t[0].exact = t[0].only = -1;
+    run[0].lo = 0;
+    run[0].hi = k->n;
+    for (int v = 0, depth = 0, level = 1; v < used; ++v) {
+        int lo = run[v].lo, hi = run[v].hi;
+
+        if (v == level) {       // first node of the next level
+            ++depth;
+            level = used;
+        }
+        t[v].child = used;
+        while (lo < hi) {
+            const char *w = k->words[order[lo]].word;
+            int i = lo, c;
+
+            if (w[depth] == '\0') {     // sorts first: ends at this node
+                if (t[v].exact < 0)
+                    t[v].exact = order[lo];
+                ++lo;
+                continue;
+            }
+            for (c = w[depth]; i < hi && k->words[order[i]].word[depth] == c; ++i)
+                ;
+            struct _uukeynode *n = &t[used];
+            n->c = c;
+            n->exact = n->only = -1;
+            for (int j = lo; j < i; ++j)
+                if (k->words[order[j]].min <= depth + 1) {
+                    n->only = n->nabbrev? -1 : order[j];
+                    if (n->nabbrev < 2)
+                        ++n->nabbrev;
+                }
+            run[used].lo = lo;
+            run[used++].hi = i;
+            ++t[v].nchild;
+            lo = i;
+        }
+    }
+    _uukeyput(run, order);
+    return t;
+}
+
+// k's trie, built at its first use by any thread; NULL if out of memory.
+// under UUSTATIC it is only looked up: NULL if uukeys_init() did not build it
+static struct _uukeynode *
+_uukeytrie(struct uukeys *k)
+{
+    struct _uukeynode *t = __atomic_load_n(&k->trie, __ATOMIC_ACQUIRE);
+#ifndef UUSTATIC
+    struct _uukeynode *none = NULL;
+
+    if (t == NULL && (t = _uukeybuild(k)) != NULL
+            && !__atomic_compare_exchange_n(&k->trie, &none, t, false,
+                __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        _uukeydrop(t);          // another thread's is in
+        t = none;
+    }
+#endif
+    return t;
+}
+
+// build k's trie now rather than at its first scan; false if out of memory
+// (under UUSTATIC, out of pool, and a scan of k raises uuerror())
+static _uuunused bool
+uukeys_init(struct uukeys *k)
+{
+#ifdef UUSTATIC
+    struct _uukeynode *t;
+
+    // startup only, so the wait is for another thread's uukeys_init()
+    while (__atomic_exchange_n(&_uukeylock, 1, __ATOMIC_ACQUIRE))
+        ;
+    if ((t = k->trie) == NULL && (t = _uukeybuild(k)) != NULL)
+        __atomic_store_n(&k->trie, t, __ATOMIC_RELEASE);
+    __atomic_store_n(&_uukeylock, 0, __ATOMIC_RELEASE);
+    return t != NULL;
+#else
+    return _uukeytrie(k) != NULL;
+#endif
+}
+
+// scan a keyword of set k or an abbreviation of one; res is an int * for its
+// index. an exact keyword wins over longer ones it is a prefix of; a prefix
+// of more than one fails with uu.failmsg "ambiguous", and one shorter than
+// its keyword's min with "abbreviation too short"
+static bool
+__scan_keys(struct uukeys *k, char *lp, void *res)
+{
+    struct _uukeynode *t = _uukeytrie(k), *v;
+    int key;
+
+    if (t == NULL)
+#ifdef UUSTATIC
+        uuerror("%s keywords not built by uukeys_init()", k->name);
+#else
+        return fail(lp, "out of memory");
+#endif
+
+    lp = skipspace(lp);
+    uu.lpfail = uu.lpstart = lp;
+    uu.failmsg = NULL;
+    uu.len = 0;
+
+    for (v = t; _uukeychar(*lp); ++lp) {
+        struct _uukeynode *c = &t[v->child], *end = c + v->nchild;
+
+        while (c < end && c->c != (unsigned char)*lp)
+            ++c;
+        if (c == end)
+            return fail(uu.lpstart);    // not a keyword, nor a prefix of one
+        v = c;
+    }
+    if (v == t)
+        return fail(lp);
+
+    if ((key = v->exact) < 0 && (key = v->only) < 0)
+        return fail(uu.lpstart, v->nabbrev? "ambiguous" : "abbreviation too short");
+    uu.len = lp - uu.lpstart;
+    if (res)
+        *(int *)res = key;
+    return success(lp);
+}
+//}}}
+
+//{{{ UUTRACE
+#ifdef UUTRACE
+// record formats, offsets relative to uu.line, ok is 0 or 1:
+//   = <shape>                              line fingerprint, \ooo escaped
+//   t <term> <start> <end> <ok> <name>
+//   c <char code> <start> <end> <ok>
+//   l <start> <end> <ok> <len>:<literal>
+
+static _uuunused void
+uutrace_line(void)
+{
+    if (uu.trace == NULL)
+        return;
+
+    fputs("= ", uu.trace);
+    for (unsigned char *cp = (unsigned char *)uu.line; *cp; ++cp) {
+        int c = isupper(*cp)? 'X' : isalpha(*cp)? 'x' : isdigit(*cp)? '1' : *cp;
+        if (c >= 0x80)
+            c = 0x80; // keep high bytes high, drop their value
+        if ((c < ' ' && c != '\t') || c == '\\' || c >= 0x7f)
+            fprintf(uu.trace, "\\%03o", c);
+        else
+            fputc(c, uu.trace);
+    }
+    fputc('\n', uu.trace);
+}
+
+static void
+_uutrace(int kind, int id, const char *wanted, char *lp, bool ok)
+{
+    int start = lp - uu.line;
+    int end = (ok? uu.lp : uu.lpfail) - uu.line;
+
+    switch (kind) {
+    case 't':
+        fprintf(uu.trace, "t %d %d %d %d %s\n", id, start, end, ok, uuterms[id].name);
+        break;
+    case 'c':
+        fprintf(uu.trace, "c %d %d %d %d\n", id, start, end, ok);
+        break;
+    case 'l':
+        fprintf(uu.trace, "l %d %d %d %d:%s\n", start, end, ok, (int)strlen(wanted),
+                wanted);
+        break;
+    }
+}
+
+static bool
+_uutrace_char(char wanted, char *lp, void *res)
+{
+    bool ok = __scan_char(wanted, lp, res);
+    if (uu.trace)
+        _uutrace('c', (unsigned char)wanted, NULL, lp, ok);
+    return ok;
+}
+
+static bool
+_uutrace_term(int x, char *lp, void *res)
+{
+    bool ok = __scan_term(x, lp, res);
+    if (uu.trace)
+        _uutrace('t', x, NULL, lp, ok);
+    return ok;
+}
+
+static bool
+_uutrace_literal(const char *wanted, char *lp, void *res)
+{
+    bool ok = __scan_literal(wanted, lp, res);
+    if (uu.trace)
+        _uutrace('l', 0, wanted, lp, ok);
+    return ok;
+}
+
+// read next traced line from fp into buf: the shape record is decoded and
+// successful literal and char matches are written back over it
+// returns buf, or NULL at end of trace
+
+static _uuunused char *
+uureplay(FILE *fp, char *buf, int size)
+{
+    int c, code, start, end, ok, len;
+    char *cp, *bp;
+
+    // skip to the next shape record
+    while ((c = getc(fp)) != '=')
+        if (c == EOF)
+            return NULL;
+        else while (c != '\n' && c != EOF)
+            c = getc(fp);
+
+    if (getc(fp) != ' ' || fgets(buf, size, fp) == NULL)
+        return NULL;
+
+    for (cp = bp = buf; *cp && *cp != '\n'; ++bp)
+        if (*cp == '\\' && sscanf(cp+1, "%3o", &c) == 1) {
+            *bp = c;
+            cp += 4;
+        } else
+            *bp = *cp++;
+    *bp = '\0';
+    len = bp - buf;
+
+    while ((c = getc(fp)) != EOF && c != '=') {
+        if (c == 'c' && fscanf(fp, "%d %d %d %d", &code, &start, &end, &ok) == 4) {
+            if (ok && code && end > 0 && end <= len)
+                buf[end-1] = code;
+        } else if (c == 'l'
+                   && fscanf(fp, "%d %d %d %d:", &start, &end, &ok, &code) == 4) {
+            if (ok && end >= code && end <= len)
+                fread(buf + end - code, 1, code, fp);
+        }
+        while (c != '\n' && c != EOF)
+            c = getc(fp);
+    }
+    if (c == '=')
+        ungetc(c, fp);
+
+    return buf;
+}
+
+// route the _Generic selections in accept() through the recorders
+#define __scan_char     _uutrace_char
+#define __scan_term     _uutrace_term
+#define __scan_literal  _uutrace_literal
+#endif
+//}}}
+//{{{ UUSDT
+#ifdef UUSDT
+// probe arguments are values already in registers or memory, so a probe
+// with nothing attached is the nop alone; offsets are lp - line in the script
+
+static _uuinline bool
+_uusdt_term(int x, char *lp, void *res)
+{
+    bool ok;
+
+    STAP_PROBE4(uuscan, term_entry, x, uuterms[x].name, lp, uu.line);
+    ok = __scan_term(x, lp, res);
+    STAP_PROBE4(uuscan, term_exit, x, ok, uu.lp, uu.line);
+    return ok;
+}
+
+static _uuinline bool
+_uusdt_char(char wanted, char *lp, void *res)
+{
+    bool ok = __scan_char(wanted, lp, res);
+
+    STAP_PROBE4(uuscan, char, wanted, ok, lp, uu.line);
+    return ok;
+}
+
+static _uuinline bool
+_uusdt_literal(const char *wanted, char *lp, void *res)
+{
+    bool ok = __scan_literal(wanted, lp, res);
+
+    STAP_PROBE4(uuscan, literal, wanted, ok, lp, uu.line);
+    return ok;
+}
+
+// after the UUTRACE recorders, if any, so both see every scan
+#undef __scan_char
+#undef __scan_term
+#undef __scan_literal
+#define __scan_char     _uusdt_char
+#define __scan_term     _uusdt_term
+#define __scan_literal  _uusdt_literal
+#endif
+//}}}
+//{{{ stack switching
+#if defined(UUBATCH) || defined(UURESUME)
+#if !defined(__x86_64__)
+#error UUBATCH and UURESUME switch stacks in x86-64 assembly
+#endif
+// _uuco_switch(&from->sp, to->sp) saves the callee-saved registers on the
+// current stack and resumes the other at its own _uuco_switch() call, or its
+// _uuco_capture(), which then returns 1; a new stack starts at _uuco_entry
+// with its function in r13 and argument in r12.
+// _uuco_capture(&sp, copy, arg) saves the registers the same way and calls
+// copy(sp, arg) to copy the stack from sp up, then returns 0: with the stack
+// copied back, a switch to sp returns from it again, as from setjmp(). No
+// returns_twice is needed: every frame above it is as it was at the call.
+void _uuco_switch(void **from, void *to) __asm__("_uuco_switch");
+int _uuco_capture(void **sp, void (*copy)(void *, void *), void *arg)
+    __asm__("_uuco_capture");
+void _uuco_entry(void) __asm__("_uuco_entry");
+__asm__(
+    ".text\n"
+    ".p2align 4\n"
+    "_uuco_switch:\n"
+    "   pushq %rbp\n"
+    "   pushq %rbx\n"
+    "   pushq %r12\n"
+    "   pushq %r13\n"
+    "   pushq %r14\n"
+    "   pushq %r15\n"
+    "   movq %rsp, (%rdi)\n"
+    "   movq %rsi, %rsp\n"
+    "   popq %r15\n"
+    "   popq %r14\n"
+    "   popq %r13\n"
+    "   popq %r12\n"
+    "   popq %rbx\n"
+    "   popq %rbp\n"
+    "   movl $1, %eax\n"
+    "   ret\n"
+    ".p2align 4\n"
+    "_uuco_capture:\n"
+    "   pushq %rbp\n"
+    "   pushq %rbx\n"
+    "   pushq %r12\n"
+    "   pushq %r13\n"
+    "   pushq %r14\n"
+    "   pushq %r15\n"
+    "   movq %rsp, (%rdi)\n"
+    "   movq %rsp, %rdi\n"
+    "   movq %rsi, %rax\n"
+    "   movq %rdx, %rsi\n"
+    "   subq $8, %rsp\n"
+    "   call *%rax\n"
+    "   addq $8, %rsp\n"
+    "   popq %r15\n"
+    "   popq %r14\n"
+    "   popq %r13\n"
+    "   popq %r12\n"
+    "   popq %rbx\n"
+    "   popq %rbp\n"
+    "   xorl %eax, %eax\n"
+    "   ret\n"
+    "_uuco_entry:\n"
+    "   movq %r12, %rdi\n"
+    "   call *%r13\n"
+    "   ud2\n");
+
+// a new stack of size at stack, to start with fn(arg) at its first switch:
+// _uuco_switch() pops six registers and returns to _uuco_entry, which calls
+// with the stack 16-byte aligned
+static void *
+_uuco_new(char *stack, size_t size, void (*fn)(void *), void *arg)
+{
+    void **sp = (void **)(((uintptr_t)stack + size) & ~(uintptr_t)15);
+
+    *--sp = (void *)_uuco_entry;
+    *--sp = NULL;                               // rbp
+    *--sp = NULL;                               // rbx
+    *--sp = arg;                                // r12
+    *--sp = (void *)fn;                         // r13
+    *--sp = NULL;                               // r14
+    *--sp = NULL;                               // r15
+    return sp;
+}
+#endif
+//}}}
+//{{{ UUBATCH scan points
+#ifdef UUBATCH
+#if defined(UUDEFER) || defined(UUINDENT) || defined(UUPROF)
+#error UUBATCH parses share the action queue, indentation and rule stacks
+#endif
+#ifndef UUBATCH_STACK
+#define UUBATCH_STACK   (64 * 1024)
+#endif
+#define _UUBATCH_AHEAD  192     // bytes prefetched at a miss, from its line
+#define _UUBATCH_NEAR   32      // a scan this close to the end misses
+
+// each parse of a batch is a coroutine with its own stack, and its own uu
+// while it runs: a switch saves uu to the one stopping and loads the next
+struct _uuco {
+    void *sp;                   // saved stack pointer
+    struct _uuco *next;         // ring of the parses still running
+    struct uuscan uu;
+    char *stack;
+};
+
+static _uutls struct {
+    struct _uuco *cur;          // NULL: no batch running
+    int live;
+    void *sp;                   // the caller's
+    struct uujob *jobs;
+    int n, taken;
+    bool (*rule)(void *);
+    long yields;
+} _uubatch;
+
+// uu out to from (if any) and in from to
+static void
+_uubatch_swap(struct _uuco *from, struct _uuco *to)
+{
+    if (from)
+        _uucopy(&from->uu, &uu);
+    _uucopy(&uu, &to->uu);
+    _uubatch.cur = to;
+}
+
+// on to the next parse in the ring, back here when the ring comes round
+static void
+_uubatch_yield(void)
+{
+    struct _uuco *from = _uubatch.cur, *to = from->next;
+
+    if (to == from)
+        return;
+    ++_uubatch.yields;
+    _uubatch_swap(from, to);
+    _uuco_switch(&from->sp, to->sp);
+}
+
+// lp is near or past the end of what was prefetched: fetch the lines from
+// lp's on and let the other parses run while they come in
+static _uucold void
+_uubatch_miss(char *lp)
+{
+    char *line = (char *)((uintptr_t)lp & ~(uintptr_t)63);
+
+    for (int i = 0; i < _UUBATCH_AHEAD; i += 64)
+        __builtin_prefetch(line + i);
+    uu.ahead = line + _UUBATCH_AHEAD;
+    if (_uubatch.cur)
+        _uubatch_yield();
+}
+
+// one compare at each scan: lp within [ahead - _UUBATCH_AHEAD, ahead - _UUBATCH_NEAR)
+static _uuinline void
+_uubatch_touch(char *lp)
+{
+    if (_uuunlikely((uintptr_t)lp - ((uintptr_t)uu.ahead - _UUBATCH_AHEAD)
+                >= _UUBATCH_AHEAD - _UUBATCH_NEAR))
+        _uubatch_miss(lp);
+}
+
+static _uuinline bool
+_uubatch_term(int x, char *lp, void *res)
+{
+    _uubatch_touch(lp);
+    return __scan_term(x, lp, res);
+}
+
+static _uuinline bool
+_uubatch_char(char wanted, char *lp, void *res)
+{
+    _uubatch_touch(lp);
+    return __scan_char(wanted, lp, res);
+}
+
+static _uuinline bool
+_uubatch_literal(const char *wanted, char *lp, void *res)
+{
+    _uubatch_touch(lp);
+    return __scan_literal(wanted, lp, res);
+}
+
+#undef __scan_char
+#undef __scan_term
+#undef __scan_literal
+#define __scan_char     _uubatch_char
+#define __scan_term     _uubatch_term
+#define __scan_literal  _uubatch_literal
+#endif
+//}}}
+//{{{ UUCOMPLETE scan points
+#ifdef UUCOMPLETE
+enum { UUCAND_LITERAL, UUCAND_CHAR, UUCAND_KEYWORD, UUCAND_TERM };
+
+struct uucandidate {
+    const char *text;   // NUL terminated: a literal, char, keyword or terminal name
+    int len;
+    int kind;           // UUCAND_*
+};
+
+static _uutls struct {
+    struct uucandidate *c;
+    int max, n;
+} _uucomp;
+
+// printable chars, one string per char at _uuprintable + c - ' '
+static const char _uuprintable[] =
+    " \0!\0\"\0#\0$\0%\0&\0'\0(\0)\0*\0+\0,\0-\0.\0/\0"
+    "0\0" "1\0" "2\0" "3\0" "4\0" "5\0" "6\0" "7\0" "8\0" "9\0"
+    ":\0;\0<\0=\0>\0?\0@\0"
+    "A\0B\0C\0D\0E\0F\0G\0H\0I\0J\0K\0L\0M\0N\0O\0P\0Q\0R\0S\0T\0U\0V\0W\0X\0Y\0Z\0"
+    "[\0\\\0]\0^\0_\0`\0"
+    "a\0b\0c\0d\0e\0f\0g\0h\0i\0j\0k\0l\0m\0n\0o\0p\0q\0r\0s\0t\0u\0v\0w\0x\0y\0z\0"
+    "{\0|\0}\0~";
+
+// a candidate, once: a set or literal tried again while backtracking is the
+// same string
+static void
+_uucomplete_add(const char *text, int len, int kind)
+{
+    for (int i = 0; i < _uucomp.n && i < _uucomp.max; ++i)
+        if (_uucomp.c[i].len == len && _uucomp.c[i].kind == kind
+                && (_uucomp.c[i].text == text
+                    || memcmp(_uucomp.c[i].text, text, len) == 0))
+            return;
+    if (_uucomp.n < _uucomp.max) {
+        _uucomp.c[_uucomp.n].text = text;
+        _uucomp.c[_uucomp.n].len = len;
+        _uucomp.c[_uucomp.n].kind = kind;
+    }
+    ++_uucomp.n;
+}
+
+// the rest of the input if a scan at lp would start on the cursor word
+static char *
+_uucomplete_word(char *lp, int *len)
+{
+    if ((lp = skipspace(lp)) != uu.cw)
+        return NULL;
+    *len = strlen(lp);
+    return lp;
+}
+
+static _uucold void
+_uucomplete_char(char c, char *lp)
+{
+    int n;
+    char *w = _uucomplete_word(lp, &n);
+
+    if (w && (n == 0 || (n == 1 && *w == c)) && c > ' ' && c <= '~')
+        _uucomplete_add(_uuprintable + 2 * (c - ' '), 1, UUCAND_CHAR);
+}
+
+static _uucold void
+_uucomplete_term(int x, char *lp)
+{
+    int n;
+
+    if (_uucomplete_word(lp, &n))
+        _uucomplete_add(uuterms[x].name, strlen(uuterms[x].name), UUCAND_TERM);
+}
+
+static _uucold void
+_uucomplete_literal(const char *wanted, char *lp)
+{
+    int n;
+    char *w = _uucomplete_word(lp, &n);
+
+    if (w && strncmp(wanted, w, n) == 0)
+        _uucomplete_add(wanted, strlen(wanted), UUCAND_LITERAL);
+}
+
+// every keyword under v, in sorted order
+static void
+_uucomplete_subtree(const struct uukeys *k, const struct _uukeynode *t,
+                    const struct _uukeynode *v)
+{
+    if (v->exact >= 0)
+        _uucomplete_add(k->words[v->exact].word, strlen(k->words[v->exact].word),
+                        UUCAND_KEYWORD);
+    for (int i = 0; i < v->nchild; ++i)
+        _uucomplete_subtree(k, t, &t[v->child + i]);
+}
+
+static _uucold void
+_uucomplete_keys(struct uukeys *k, char *lp)
+{
+    int n;
+    char *w = _uucomplete_word(lp, &n);
+    struct _uukeynode *t, *v;
+
+    if (w == NULL || (t = _uukeytrie(k)) == NULL)
+        return;
+    for (v = t; n-- > 0; ++w) {
+        struct _uukeynode *c = &t[v->child], *end = c + v->nchild;
+
+        while (c < end && c->c != (unsigned char)*w)
+            ++c;
+        if (c == end)
+            return;
+        v = c;
+    }
+    _uucomplete_subtree(k, t, v);
+}
+
+static _uuinline bool
+_uucomp_term(int x, char *lp, void *res)
+{
+    if (_uuunlikely(uu.cw != NULL))
+        _uucomplete_term(x, lp);
+    return __scan_term(x, lp, res);
+}
+
+static _uuinline bool
+_uucomp_char(char wanted, char *lp, void *res)
+{
+    if (_uuunlikely(uu.cw != NULL))
+        _uucomplete_char(wanted, lp);
+    return __scan_char(wanted, lp, res);
+}
+
+static _uuinline bool
+_uucomp_literal(const char *wanted, char *lp, void *res)
+{
+    if (_uuunlikely(uu.cw != NULL))
+        _uucomplete_literal(wanted, lp);
+    return __scan_literal(wanted, lp, res);
+}
+
+static _uuinline bool
+_uucomp_keys(struct uukeys *k, char *lp, void *res)
+{
+    if (_uuunlikely(uu.cw != NULL))
+        _uucomplete_keys(k, lp);
+    return __scan_keys(k, lp, res);
+}
+
+#undef __scan_char
+#undef __scan_term
+#undef __scan_literal
+#define __scan_char     _uucomp_char
+#define __scan_term     _uucomp_term
+#define __scan_literal  _uucomp_literal
+#define __scan_keys     _uucomp_keys
+#endif
+//}}}
+//{{{ UURESUME scan points
+#ifdef UURESUME
+#if defined(UUDEFER) || defined(UUINDENT) || defined(UUPROF)
+#error UURESUME checkpoints do not hold the action queue, indentation and rule stacks
+#endif
+#ifndef UURESUME_STACK
+#define UURESUME_STACK  (64 * 1024)
+#endif
+
+// a checkpoint: the parse as it was about to scan at pos, its stack from sp
+// up kept at copies + copy
+struct _uucheck {
+    char *pos;
+    char *seen;                 // the furthest char read before it
+    void *sp;
+    size_t copy, size;
+    struct uuscan uu;
+};
+
+struct uuresume {
+    bool (*rule)(void *);
+    void *res;
+    char *buf;                  // the line last parsed, and its checkpoints'
+    int len, room;
+    char *stack;
+    struct _uucheck *check;
+    int n, max;
+    char *copies;
+    size_t used, copyroom;
+    int status;
+    int from;                   // offset the last uuresume() resumed at
+};
+
+static _uutls struct {
+    struct uuresume *r;
+    char *line;                 // r->buf while its parse runs, else NULL
+    char *last;                 // position of the last checkpoint
+    char *seen;                 // the furthest char read by a scan
+    void *sp;                   // the caller's
+} _uures;
+
+static void
+_uuresume_copy(void *sp, void *arg)
+{
+    struct uuresume *r = (struct uuresume *)arg;
+    struct _uucheck *c = &r->check[r->n - 1];
+    char *top = (char *)(((uintptr_t)r->stack + UURESUME_STACK) & ~(uintptr_t)15);
+    size_t size = top - (char *)sp;
+
+    if (r->used + size > r->copyroom) {
+        size_t room = r->copyroom? r->copyroom * 2 : 64 * 1024;
+        char *copies;
+
+        while (r->used + size > room)
+            room *= 2;
+        if ((copies = (char *)realloc(r->copies, room)) == NULL) {
+            --r->n;             // the parse goes on without it
+            return;
+        }
+        r->copies = copies;
+        r->copyroom = room;
+    }
+    memcpy(r->copies + r->used, sp, size);
+    c->copy = r->used;
+    c->size = size;
+    r->used += size;
+}
+
+// a scan is about to start at lp, past the last checkpoint: take one here.
+// uuresume() restarts the parse by returning from _uuco_capture() again
+static _uucold void
+_uuresume_checkpoint(char *lp)
+{
+    struct uuresume *r = _uures.r;
+    struct _uucheck *c;
+
+    if (r->n == r->max) {
+        int max = r->max? r->max * 2 : 64;
+
+        if ((c = (struct _uucheck *)realloc(r->check, max * sizeof *c)) == NULL)
+            return;
+        r->check = c;
+        r->max = max;
+    }
+    c = &r->check[r->n++];
+    c->pos = _uures.last = lp;
+    c->seen = _uures.seen;
+    _uucopy(&c->uu, &uu);
+    _uuco_capture(&c->sp, _uuresume_copy, r);
+}
+
+static _uuinline void
+_uuresume_read(char *p)
+{
+    if (p > _uures.seen)
+        _uures.seen = p;
+}
+
+// each scan of the resumable parse checkpoints at a new position, then
+// notes how far it read: up to where it stopped or failed, a literal up to
+// its length, a keyword set to the end of the word
+static _uuinline bool
+_uures_term(int x, char *lp, void *res)
+{
+    bool ok;
+
+    if (!_uuunlikely(uu.line == _uures.line))
+        return __scan_term(x, lp, res);
+    if (lp > _uures.last)
+        _uuresume_checkpoint(lp);
+    ok = __scan_term(x, lp, res);
+    _uuresume_read(ok? uu.lp : uu.lpfail);
+    return ok;
+}
+
+static _uuinline bool
+_uures_char(char wanted, char *lp, void *res)
+{
+    bool ok;
+
+    if (!_uuunlikely(uu.line == _uures.line))
+        return __scan_char(wanted, lp, res);
+    if (lp > _uures.last)
+        _uuresume_checkpoint(lp);
+    ok = __scan_char(wanted, lp, res);
+    _uuresume_read(ok? uu.lp : uu.lpfail);
+    return ok;
+}
+
+static _uuinline bool
+_uures_literal(const char *wanted, char *lp, void *res)
+{
+    bool ok;
+
+    if (!_uuunlikely(uu.line == _uures.line))
+        return __scan_literal(wanted, lp, res);
+    if (lp > _uures.last)
+        _uuresume_checkpoint(lp);
+    ok = __scan_literal(wanted, lp, res);
+    _uuresume_read(ok? uu.lp : uu.lpstart + strlen(wanted));
+    return ok;
+}
+
+static _uuinline bool
+_uures_keys(struct uukeys *k, char *lp, void *res)
+{
+    bool ok;
+
+    if (!_uuunlikely(uu.line == _uures.line))
+        return __scan_keys(k, lp, res);
+    if (lp > _uures.last)
+        _uuresume_checkpoint(lp);
+    if (!(ok = __scan_keys(k, lp, res)))
+        for (lp = uu.lpstart; _uukeychar(*lp); ++lp)
+            ;
+    _uuresume_read(ok? uu.lp : lp);
+    return ok;
+}
+
+#undef __scan_char
+#undef __scan_term
+#undef __scan_literal
+#undef __scan_keys
+#define __scan_char     _uures_char
+#define __scan_term     _uures_term
+#define __scan_literal  _uures_literal
+#define __scan_keys     _uures_keys
+#endif
+//}}}
+//{{{ UUCACHE
+#ifdef UUCACHE
+#define _UUCACHE_KEY    24
+#define _UUCACHE_VAL    16
+
+struct _uucentry {
+    unsigned seq;       // odd while a put is writing
+    unsigned char len;  // key length, 0 for empty
+    char key[_UUCACHE_KEY];
+    uint64_t hash;
+    char val[_UUCACHE_VAL];
+};
+
+static struct _uucache {
+    long lookups, hits;
+    struct _uucentry e[UUCACHE];
+} *_uucache[UUTERMCOUNT];
+#ifdef UUSTATIC
+static struct _uucache _uucachepool[UUTERMCOUNT];
+#endif
+
+#define _uurelaxed(x)   __atomic_load_n(&(x), __ATOMIC_RELAXED)
+// lossy under contention, which is fine for statistics
+#define _uucount(x)     __atomic_store_n(&(x), _uurelaxed(x) + 1, __ATOMIC_RELAXED)
+
+static inline uint64_t
+_uuhash(const char *p, int len)
+{
+    uint64_t h = len * 0x9e3779b97f4a7c15ULL, w;
+
+    for (; len >= 8; p += 8, len -= 8) {
+        memcpy(&w, p, 8);
+        h = (h ^ w) * 0xff51afd7ed558ccdULL;
+    }
+    for (w = 0; len > 0; --len)
+        w = w << 8 | (unsigned char)p[len-1];
+    h = (h ^ w) * 0xc4ceb9fe1a85ec53ULL;
+    return h ^ h >> 29;
+}
+
+static inline bool
+uucache_get(int t, const char *p, int len, void *val, int size)
+{
+    struct _uucache *c = _uucache[t];
+    struct _uucentry *e;
+    char tmp[_UUCACHE_VAL];
+    uint64_t h;
+    unsigned seq;
+
+    if (c == NULL || len == 0 || len > _UUCACHE_KEY || size > _UUCACHE_VAL)
+        return false;
+    _uucount(c->lookups);
+
+    h = _uuhash(p, len);
+    e = &c->e[h & (UUCACHE - 1)];
+    seq = __atomic_load_n(&e->seq, __ATOMIC_ACQUIRE);
+    if ((seq & 1) || e->hash != h || e->len != len || memcmp(e->key, p, len))
+        return false;
+    memcpy(tmp, e->val, size);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (_uurelaxed(e->seq) != seq) // overwritten while copying
+        return false;
+
+    memcpy(val, tmp, size);
+    _uucount(c->hits);
+    return true;
+}
+
+static _uuunused void
+uucache_put(int t, const char *p, int len, const void *val, int size)
+{
+    struct _uucache *c = _uucache[t];
+    struct _uucentry *e;
+    uint64_t h;
+    unsigned seq;
+
+    if (len == 0 || len > _UUCACHE_KEY || size > _UUCACHE_VAL)
+        return;
+    if (c == NULL) {
+#ifdef UUSTATIC
+        c = &_uucachepool[t];
+        __atomic_store_n(&_uucache[t], c, __ATOMIC_RELEASE);
+#else
+        struct _uucache *none = NULL;
+
+        c = (struct _uucache *)calloc(1, sizeof *c);
+        if (c == NULL || !__atomic_compare_exchange_n(&_uucache[t], &none, c, false,
+                                             __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            free(c); // out of memory, or another thread got there first
+            return;
+        }
+#endif
+    }
+
+    h = _uuhash(p, len);
+    e = &c->e[h & (UUCACHE - 1)];
+    seq = _uurelaxed(e->seq);
+    if ((seq & 1) || !__atomic_compare_exchange_n(&e->seq, &seq, seq + 1, false,
+                                                  __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        return;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    e->hash = h;
+    e->len = len;
+    memcpy(e->key, p, len);
+    memcpy(e->val, val, size);
+    __atomic_store_n(&e->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+static _uuunused void
+uucache_report(FILE *fp)
+{
+    for (int t = 0; t < UUTERMCOUNT; ++t)
+        if (_uucache[t] && _uucache[t]->lookups)
+            fprintf(fp, "uucache: %s %ld lookups, %ld hits, %.1f%%\n", uuterms[t].name,
+                    _uucache[t]->lookups, _uucache[t]->hits,
+                    100.0 * _uucache[t]->hits / _uucache[t]->lookups);
+}
+#endif
+//}}}
+
+#ifndef __cplusplus
+// these are never called, they catch unknown type selector in the _Generic(..)
+// accept() with unknown type is a compile error
+static _uuunused void __unknown3(void *a, void *b, void *c) {}
+static _uuunused void __unknown2(void *a, void *b) {}
+#endif
+
+// literal, char, and user-term messages for failed expect()
+
+static _uuunused _uucold _uunoreturn void
+_msg_str(const char *s, const char *msg)
+{
+    _uusdt(STAP_PROBE4(uuscan, expect_fail, -1, s, uu.lpfail, uu.line));
+    if (uu.msg == NULL)
+        _uujump();
+    if (msg == NULL)
+        sprintf(uu.msg, "expected \"%s\" at pos %d", s, uuerrorpos());
+    else
+        sprintf(uu.msg, "%s at pos %d", msg, uuerrorpos());
+    _uujump();
+}
+
+static _uuunused _uucold _uunoreturn void
+_msg_char(char c, const char *msg)
+{
+    _uusdt(STAP_PROBE4(uuscan, expect_fail, -2, c, uu.lpfail, uu.line));
+    if (uu.msg == NULL)
+        _uujump();
+    if (msg)
+        sprintf(uu.msg, "%s at pos %d", msg, uuerrorpos());
+    else {
+        if (isprint(c))
+            sprintf(uu.msg, "expected '%c' at pos %d", c, uuerrorpos());
+        else
+            sprintf(uu.msg, "expected '\\%03o' at pos %d", c, uuerrorpos());
+    }
+    _uujump();
+}
+
+static _uuunused _uucold _uunoreturn void
+_msg_keys(struct uukeys *k, const char *msg)
+{
+    _uusdt(STAP_PROBE4(uuscan, expect_fail, -3, k->name, uu.lpfail, uu.line));
+    if (uu.msg == NULL)
+        _uujump();
+    sprintf(uu.msg, "%s%s at pos %d",
+            msg==NULL? "expected " : "",
+            msg==NULL? k->name : msg, uuerrorpos());
+    if (uu.failmsg) {
+        strcat(uu.msg, " (");
+        strcat(uu.msg, uu.failmsg);
+        strcat(uu.msg, ")");
+    }
+    _uujump();
+}
+
+static _uuunused _uucold _uunoreturn void
+_msg_term(int t, const char *msg)
+{
+    _uusdt(STAP_PROBE4(uuscan, expect_fail, t, uuterms[t].name, uu.lpfail, uu.line));
+    if (uu.msg == NULL)
+        _uujump();
+    sprintf(uu.msg, "%s%s at pos %d", 
+            msg==NULL? "expected " : "",
+            msg==NULL? uuterms[t].name : msg, uuerrorpos());
+
+    if (uu.failmsg) {
+        strcat(uu.msg, " (");
+        strcat(uu.msg, uu.failmsg);
+        strcat(uu.msg, ")");
+    }
+    _uujump();
+}
+
+//{{{ UUPROF sampler
+#ifdef UUPROF
+#define _UUPROF_STACKS  1024    // distinct stacks kept, power of 2
+#define _UUPROF_FRAMES  32      // frames kept per stack, leaf side
+
+static struct _uusample {
+    unsigned hash;              // 0: free slot
+    int ready;                  // frames written
+    long count;
+    short n;                    // frames kept
+    short term;                 // -1: not in a terminal
+    bool truncated;             // frames beyond the root end were dropped
+    const struct uurule *frame[_UUPROF_FRAMES];
+} _uuprof_samples[_UUPROF_STACKS];
+static long _uuprof_dropped;
+
+// SIGPROF handler: the interrupted thread's rule stack is counted in a table
+// claimed slot by slot with compare and swap, as other threads may be in
+// here at the same time; no locks, no allocation
+static void
+_uuprof_sample(int sig)
+{
+    int depth = _uuprof_stack.depth, term = _uuprof_stack.term;
+    int kept = depth < UUPROF_DEPTH? depth : UUPROF_DEPTH;
+    int first = kept > _UUPROF_FRAMES? kept - _UUPROF_FRAMES : 0;
+    int n = kept - first;
+    bool truncated = depth > n;
+    const struct uurule *frame[_UUPROF_FRAMES];
+    unsigned h = 2166136261u;
+
+    (void)sig;
+    for (int i = 0; i < n; ++i) {
+        frame[i] = _uuprof_stack.frame[first + i];
+        h = (h ^ (unsigned)(uintptr_t)frame[i]) * 16777619u;
+    }
+    h = ((h ^ (unsigned)term) * 16777619u ^ truncated) | 1;
+
+    for (unsigned j = h, probe = 0; probe < 16; ++probe, ++j) {
+        struct _uusample *s = &_uuprof_samples[j & (_UUPROF_STACKS - 1)];
+        unsigned sh = __atomic_load_n(&s->hash, __ATOMIC_ACQUIRE);
+
+        if (sh == 0) {
+            if (!__atomic_compare_exchange_n(&s->hash, &sh, h, false,
+                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                if (sh != h) // taken by another stack
+                    continue;
+            } else {
+                memcpy(s->frame, frame, n * sizeof frame[0]);
+                s->n = n;
+                s->term = term;
+                s->truncated = truncated;
+                s->count = 1;
+                __atomic_store_n(&s->ready, 1, __ATOMIC_RELEASE);
+                return;
+            }
+        }
+        if (sh == h && __atomic_load_n(&s->ready, __ATOMIC_ACQUIRE)
+                && s->n == n && s->term == term && s->truncated == truncated
+                && memcmp(s->frame, frame, n * sizeof frame[0]) == 0) {
+            __atomic_add_fetch(&s->count, 1, __ATOMIC_RELAXED);
+            return;
+        }
+    }
+    __atomic_add_fetch(&_uuprof_dropped, 1, __ATOMIC_RELAXED);
+}
+
+// sample every 1/hz s of CPU time used by the process, in whichever thread
+// is running; false if the signal or timer cannot be set up
+static _uuunused bool
+uuprof_start(int hz)
+{
+    struct sigaction sa;
+    struct itimerval it;
+
+    memset(&sa, 0, sizeof sa);
+    sa.sa_handler = _uuprof_sample;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    if (hz <= 0 || sigaction(SIGPROF, &sa, NULL) != 0)
+        return false;
+
+    it.it_interval.tv_sec = 0;
+    it.it_interval.tv_usec = hz > 1000000? 1 : 1000000 / hz;
+    it.it_value = it.it_interval;
+    return setitimer(ITIMER_PROF, &it, NULL) == 0;
+}
+
+static _uuunused void
+uuprof_stop(void)
+{
+    struct itimerval it;
+
+    memset(&it, 0, sizeof it);
+    setitimer(ITIMER_PROF, &it, NULL);
+}
+
+// one line per stack, root first: rule;rule;...;terminal count
+static _uuunused void
+uuprof_report(FILE *fp)
+{
+    for (int i = 0; i < _UUPROF_STACKS; ++i) {
+        struct _uusample *s = &_uuprof_samples[i];
+
+        if (!__atomic_load_n(&s->ready, __ATOMIC_ACQUIRE))
+            continue;
+        if (s->truncated)
+            fputs("...;", fp);
+        for (int f = 0; f < s->n; ++f)
+            fprintf(fp, "%s%s", f? ";" : "", s->frame[f]->name);
+        if (s->term >= 0)
+            fprintf(fp, "%s%s", s->n? ";" : "", uuterms[s->term].name);
+        else if (s->n == 0)
+            fputs("[no rule]", fp);
+        fprintf(fp, " %ld\n", s->count);
+    }
+    if (_uuprof_dropped)
+        fprintf(fp, "[dropped] %ld\n", _uuprof_dropped);
+}
+#endif
+//}}}
+//{{{ UUDEFER
+#ifdef UUDEFER
+struct uuaction {
+    void (*fn)(void *p, long n);
+    void *p;
+    long n;
+};
+#ifdef UUSTATIC
+static _uutls struct uuaction _uuactions[UUSTATIC_ACTIONS];
+#define _uuactsize      UUSTATIC_ACTIONS
+
+static _uucold void
+_uudefergrow(void)
+{
+    uuerror("more than %d deferred actions", UUSTATIC_ACTIONS);
+}
+#else
+static _uutls struct uuaction *_uuactions;
+static _uutls int _uuactsize;
+
+static _uucold void
+_uudefergrow(void)
+{
+    int size = _uuactsize? _uuactsize * 2 : 64;
+    struct uuaction *a = (struct uuaction *)realloc(_uuactions, size * sizeof *a);
+
+    if (a == NULL)
+        uuerror("out of memory for %d deferred actions", size);
+    _uuactions = a;
+    _uuactsize = size;
+}
+#endif
+
+// queue fn(p, n) to run after the parse has succeeded
+static _uuinline void
+uudefer(void (*fn)(void *, long), void *p, long n)
+{
+    struct uuaction *a;
+
+    if (_uuunlikely(uu.nactions == _uuactsize))
+        _uudefergrow();
+    a = &_uuactions[uu.nactions++];
+    a->fn = fn;
+    a->p = p;
+    a->n = n;
+}
+
+// run the queued actions in order; an action that queues more runs them too
+static _uuunused void
+uurun(void)
+{
+    for (int i = 0; i < uu.nactions; ++i)
+        _uuactions[i].fn(_uuactions[i].p, _uuactions[i].n);
+    uu.nactions = 0;
+}
+
+#ifndef UUSTATIC
+// the queued actions as a malloc'd array of *n, emptying the queue, so that
+// a parse can be kept and run again by calling each fn(p, n) in order
+static _uuunused struct uuaction *
+uudetach(int *n)
+{
+    struct uuaction *a = (struct uuaction *)malloc((uu.nactions + 1) * sizeof *a);
+
+    if (a == NULL)
+        uuerror("out of memory for %d deferred actions", uu.nactions);
+    memcpy(a, _uuactions, uu.nactions * sizeof *a);
+    *n = uu.nactions;
+    uu.nactions = 0;
+    return a;
+}
+#endif
+#endif
+//}}}
+//{{{ UUINDENT
+#ifdef UUINDENT
+#ifndef UUTABSIZE
+#define UUTABSIZE       8
+#endif
+#define _UUINDENT_MAX   100
+
+static _uutls int _uuindent[_UUINDENT_MAX]; // block widths, [0] is the outermost, 0
+
+static void
+uuindentinit(void)
+{
+    uu.indents = 0;
+    uu.indentat = NULL;
+}
+
+// width of the indentation at line start cp, *end set to its end; runs of
+// spaces are counted 16 bytes at a time, aligned so no load crosses a page
+static int
+_uuindentwidth(char *cp, char **end)
+{
+    int w = 0;
+
+    for (;;) {
+#ifdef __SSE2__
+        const __m128i sp = _mm_set1_epi8(' ');
+        char *p = (char *)((uintptr_t)cp & ~(uintptr_t)15);
+        unsigned m = ~_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((__m128i *)p), sp))
+                     & 0xffff & (~0u << (cp - p)); // bit set = not a space
+
+        while (m == 0) {
+            p += 16;
+            m = ~_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((__m128i *)p), sp))
+                & 0xffff;
+        }
+        w += p + __builtin_ctz(m) - cp;
+        cp = p + __builtin_ctz(m);
+#else
+        for (; *cp == ' '; ++cp)
+            ++w;
+#endif
+        if (*cp != '\t')
+            break;
+        w = (w / UUTABSIZE + 1) * UUTABSIZE;
+        ++cp;
+    }
+    *end = cp;
+    return w;
+}
+
+// skip blank lines from line start cp and measure the first line with text;
+// returns its first non-blank, the end of input is a line of width 0
+static char *
+_uuindentline(char *cp)
+{
+    char *end;
+    int w;
+
+    for (;;) {
+        w = _uuindentwidth(cp, &end);
+        end = skipspace(end);
+        if (*end != '\n')
+            break;
+        cp = end + 1;
+    }
+    uu.indentat = end;
+    uu.indentw = *end? w : 0;
+    return end;
+}
+
+// indentation width of the line whose first non-blank is lp, -1 if lp is
+// not the first non-blank of a line
+static int
+_uuindentof(char *lp)
+{
+    char *cp = lp;
+
+    if (lp == uu.indentat)
+        return uu.indentw;
+    while (cp > uu.line && cp[-1] != '\n' && uuisspace(cp[-1]))
+        --cp;
+    if (cp > uu.line && cp[-1] != '\n')
+        return -1;
+    _uuindentline(cp);
+    return uu.indentat == lp? uu.indentw : -1;
+}
+
+UUDEFINE(NEWLINE)
+{
+    if (*lp == '\n')
+        return success(_uuindentline(lp + 1));
+
+    // a last line without '\n' still ends in NEWLINE, once
+    if (*lp == '\0' && _uuindentof(lp) < 0) {
+        uu.indentat = lp;
+        uu.indentw = 0;
+        return success(lp);
+    }
+    return fail(lp);
+}
+
+UUDEFINE(INDENT)
+{
+    int w = _uuindentof(lp);
+
+    if (w <= _uuindent[uu.indents])
+        return fail(lp);
+    if (uu.indents == _UUINDENT_MAX - 1)
+        uuerror("too many indentation levels at pos %d", uuerrorpos());
+    _uuindent[++uu.indents] = w;
+    return success(lp);
+}
+
+UUDEFINE(DEDENT)
+{
+    int w = _uuindentof(lp);
+
+    if (w < 0 || w >= _uuindent[uu.indents])
+        return fail(lp);
+    if (w > _uuindent[--uu.indents])
+        uuerror("inconsistent indentation at pos %d", uuerrorpos());
+    return success(lp);
+}
+#endif
+//}}}
+//{{{ uuparse
+enum { UUPARSE_OK, UUPARSE_NOMATCH, UUPARSE_TRAILING, UUPARSE_ERROR };
+
+#ifdef UUSTATIC
+#define _UUPARSE_STACK  UUSTATIC_LINE   // longer inputs fail
+#else
+#define _UUPARSE_STACK  256     // shorter inputs are copied to the stack
+#endif
+
+// ptr[0..len) NUL terminated, in stack if it fits; NULL, with the reason in
+// msg (if any), if it cannot be copied
+static char *
+_uucopyline(char *msg, char *stack, const char *ptr, int len)
+{
+    char *buf = stack;
+
+    if (len >= _UUPARSE_STACK) {
+#ifdef UUSTATIC
+        if (msg)
+            snprintf(msg, sizeof _uumsgbuf, "input longer than %d chars",
+                     _UUPARSE_STACK - 1);
+        return NULL;
+#else
+        if ((buf = (char *)malloc(len + 1)) == NULL) {
+            if (msg)
+                snprintf(msg, sizeof _uumsgbuf, "out of memory for %d chars of input",
+                         len);
+            return NULL;
+        }
+#endif
+    }
+    memcpy(buf, ptr, len);
+    buf[len] = '\0';
+    return buf;
+}
+
+static void
+_uufreeline(char *buf, char *stack)
+{
+#ifndef UUSTATIC
+    if (buf != stack)
+        free(buf);
+#endif
+}
+
+// run rule at lp of line, as uuparse() does: trailing if it stops short of
+// end, or past it; uu as it was after
+static int
+_uuparsein(char *msg, char *line, char *lp, char *end, bool (*rule)(void *), void *res)
+{
+    struct uuscan save;         // all of uu but errjmp, UUVAL included
+    jmp_buf jmp;
+    int status;
+#ifdef UUINDENT
+    int indent[_UUINDENT_MAX];  // the caller's open blocks, pushed over by the rule's
+    memcpy(indent, _uuindent, (uu.indents + 1) * sizeof *indent);
+#endif
+#ifdef UUPROF
+    int profbase = _uuprof_stack.base;
+    _uuprofbase();
+#endif
+
+    _uucopy(&save, &uu);
+    uu.line = line;
+    uu.lp = lp;
+    uu.msg = msg;
+    uu.jmp = &jmp;
+#ifdef UUINDENT
+    uuindentinit();
+#endif
+    if (setjmp(jmp))
+        status = UUPARSE_ERROR;
+    else if (!rule(res))
+        status = UUPARSE_NOMATCH;
+    else
+        status = skipspace(uu.lp) != skipspace(end)? UUPARSE_TRAILING : UUPARSE_OK;
+
+#ifdef UUDEFER
+    if (status == UUPARSE_OK) // the rule's actions are the caller's only on success
+        save.nactions = uu.nactions;
+#endif
+#ifdef UURESUME
+    save.arena = uu.arena;    // the app's, may have grown
+#endif
+    _uucopy(&uu, &save);
+#ifdef UUINDENT
+    memcpy(_uuindent, indent, (save.indents + 1) * sizeof *indent);
+#endif
+#ifdef UUPROF
+    _uuprof_stack.base = profbase;
+#endif
+    return status;
+}
+
+// parse ptr[0..len) with rule, see notes
+static _uuunused int
+uuparse(char *msg, const char *ptr, int len, bool (*rule)(void *), void *res)
+{
+    char stack[_UUPARSE_STACK], *buf;
+    int status;
+
+    if ((buf = _uucopyline(msg, stack, ptr, len)) == NULL)
+        return UUPARSE_ERROR;
+    status = _uuparsein(msg, buf, buf, buf + len, rule, res);
+    _uufreeline(buf, stack);
+    return status;
+}
+//}}}
+//{{{ UULAZY blocks
+#ifdef UULAZY
+enum {
+    UUSKIP_HASH = 1,            // # to end of line is a comment
+    UUSKIP_SLASH = 2,           // so are // to end of line and /* to */
+    UUSKIP_SQUOTE = 4,          // '...' is a string, as "..." always is
+};
+
+struct uuthunk {
+    char *line;                 // input the block is in, uu.line when skipped
+    char *start, *end;          // the block, open to past its close
+    int status;                 // uuforce()'s, -1 until forced
+};
+
+// first byte at or after p that is a, b or NUL; 16 bytes at a time, aligned
+// so no load crosses a page
+static char *
+_uufind(char *p, char a, char b)
+{
+#ifdef __SSE2__
+    const __m128i va = _mm_set1_epi8(a), vb = _mm_set1_epi8(b), nul = _mm_setzero_si128();
+    char *q = (char *)((uintptr_t)p & ~(uintptr_t)15);
+    unsigned m;
+
+    for (m = ~0u << (p - q); ; q += 16, m = ~0u) {
+        __m128i v = _mm_load_si128((__m128i *)q);
+        m &= _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, va),
+                               _mm_cmpeq_epi8(v, vb)), _mm_cmpeq_epi8(v, nul)));
+        if (m)
+            return q + __builtin_ctz(m);
+    }
+#else
+    while (*p && *p != a && *p != b)
+        ++p;
+    return p;
+#endif
+}
+
+// past the string or comment that starts at q, q + 1 if none does; NULL if
+// the input ends in a string or block comment, or at q
+static char *
+_uuskipquoted(char *q, int flags)
+{
+    char quote = *q;
+
+    switch (quote) {
+    case '\0':
+        return NULL;
+    case '"': case '\'':
+        if (quote == '\'' && !(flags & UUSKIP_SQUOTE))
+            break;
+        for (++q; *(q = _uufind(q, quote, '\\')) == '\\'; q += 2)
+            if (q[1] == '\0')
+                return NULL;
+        return *q? q + 1 : NULL;
+    case '#':
+        if (!(flags & UUSKIP_HASH))
+            break;
+        return _uufind(q, '\n', '\n');
+    case '/':
+        if (!(flags & UUSKIP_SLASH))
+            break;
+        if (q[1] == '/')
+            return _uufind(q, '\n', '\n');
+        if (q[1] == '*') {
+            for (q += 2; *(q = _uufind(q, '*', '*')); ++q)
+                if (q[1] == '/')
+                    return q + 2;
+            return NULL;
+        }
+        break;
+    }
+    return q + 1;
+}
+
+// past the close that balances the open at lp, NULL if there is none. Per
+// 16 bytes: masks of opens, closes and the first quote, comment start or
+// NUL; the brackets before that one are counted, and walked one by one only
+// when the closes among them could balance
+static char *
+_uuskipblock(char *lp, char open, char close, int flags)
+{
+    int depth = 0;
+#ifdef __SSE2__
+    const __m128i vo = _mm_set1_epi8(open), vc = _mm_set1_epi8(close),
+        vq = _mm_set1_epi8('"'), nul = _mm_setzero_si128(),
+        v1 = _mm_set1_epi8(flags & UUSKIP_SQUOTE? '\'' : '"'),
+        v2 = _mm_set1_epi8(flags & UUSKIP_HASH? '#' : '"'),
+        v3 = _mm_set1_epi8(flags & UUSKIP_SLASH? '/' : '"');
+    char *cp = lp;
+
+    for (;;) {
+        char *p = (char *)((uintptr_t)cp & ~(uintptr_t)15);
+        __m128i v = _mm_load_si128((__m128i *)p);
+        unsigned from = ~0u << (cp - p), lim = 0xffff, o, c, s;
+
+        s = _mm_movemask_epi8(_mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(v, vq), _mm_cmpeq_epi8(v, nul)),
+                _mm_or_si128(_mm_cmpeq_epi8(v, v1),
+                             _mm_or_si128(_mm_cmpeq_epi8(v, v2), _mm_cmpeq_epi8(v, v3)))))
+            & from;
+        if (s)
+            lim = (1u << __builtin_ctz(s)) - 1;
+        o = _mm_movemask_epi8(_mm_cmpeq_epi8(v, vo)) & from & lim;
+        c = _mm_movemask_epi8(_mm_cmpeq_epi8(v, vc)) & from & lim;
+        if (depth > __builtin_popcount(c))
+            depth += __builtin_popcount(o) - __builtin_popcount(c);
+        else
+            for (unsigned b = o | c; b; b &= b - 1)
+                if (o & b & -b)
+                    ++depth;
+                else if (--depth == 0)
+                    return p + __builtin_ctz(b) + 1;
+        if (!s)
+            cp = p + 16;
+        else if ((cp = _uuskipquoted(p + __builtin_ctz(s), flags)) == NULL)
+            return NULL;
+    }
+#else
+    for (char *cp = lp; ; )
+        if (*cp == open) {
+            ++depth;
+            ++cp;
+        } else if (*cp == close) {
+            if (--depth == 0)
+                return cp + 1;
+            ++cp;
+        } else if (*cp == '"' || *cp == '\'' || *cp == '#' || *cp == '/' || *cp == '\0') {
+            if ((cp = _uuskipquoted(cp, flags)) == NULL)
+                return NULL;
+        } else
+            ++cp;
+#endif
+}
+
+// skip the block from open to its balancing close at uu.lp into t, to parse
+// with uuforce() when wanted; false as a failed accept() if there is no
+// open, or no close (uu.failmsg "unterminated block")
+static _uuunused bool
+uuskip(char open, char close, int flags, struct uuthunk *t)
+{
+    char *lp = skipspace(uu.lp), *end;
+
+    uu.lpfail = uu.lpstart = lp;
+    uu.failmsg = NULL;
+    if (*lp != open)
+        return false;
+    if ((end = _uuskipblock(lp, open, close, flags)) == NULL) {
+        uu.failmsg = "unterminated block";
+        return false;
+    }
+    t->line = uu.line;
+    t->start = lp;
+    t->end = end;
+    t->status = -1;
+    uu.len = end - lp;
+    uu.lp = end;
+    return true;
+}
+
+// parse t's block with rule into res, the first time only; returns
+// UUPARSE_* as uuparse() does, positions in msg are from t->line
+static _uuunused int
+uuforce(char *msg, struct uuthunk *t, bool (*rule)(void *), void *res)
+{
+    if (t->status < 0)
+        t->status = _uuparsein(msg, t->line, t->start, t->end, rule, res);
+    return t->status;
+}
+#endif
+//}}}
+//{{{ uucomplete
+#ifdef UUCOMPLETE
+// run rule over ptr[0..len) as far as it goes and collect up to max
+// candidates for the last word, see notes; returns how many there are
+static _uuunused int
+uucomplete(const char *ptr, int len, bool (*rule)(void *), void *res,
+           struct uucandidate *c, int max)
+{
+    char stack[_UUPARSE_STACK], *buf = stack, *cw;
+#ifdef UUDEFER
+    int nactions = uu.nactions;
+#endif
+
+    if ((buf = _uucopyline(NULL, stack, ptr, len)) == NULL)
+        return 0;
+    for (cw = buf + len; cw > buf && !uuisspace(cw[-1]); --cw)
+        ;
+
+    _uucomp.c = c;
+    _uucomp.max = max;
+    _uucomp.n = 0;
+    uu.cw = cw;
+    _uuparsein(NULL, buf, buf, buf + len, rule, res);
+    uu.cw = NULL;
+#ifdef UUDEFER
+    uu.nactions = nactions;     // a completion runs no actions
+#endif
+    _uufreeline(buf, stack);
+    return _uucomp.n;
+}
+#endif
+//}}}
+//{{{ uubatch
+#ifdef UUBATCH
+struct uujob {
+    char *line;                 // NUL terminated input
+    void *res;                  // passed to the rule
+    char *msg;                  // uuerror() message (80 chars), or NULL
+    int status;                 // UUPARSE_* on return
+};
+
+// a parse: takes the next job until there are none, then leaves the ring
+static void
+_uubatch_run(struct _uuco *co)
+{
+    jmp_buf jmp;
+
+    while (_uubatch.taken < _uubatch.n) {
+        struct uujob *job = &_uubatch.jobs[_uubatch.taken++];
+
+        uu.lp = uu.line = job->line;
+        uu.msg = job->msg;
+        uu.jmp = &jmp;
+        uu.ahead = NULL;
+        if (setjmp(jmp))
+            job->status = UUPARSE_ERROR;
+        else if (!_uubatch.rule(job->res))
+            job->status = UUPARSE_NOMATCH;
+        else
+            job->status = *skipspace(uu.lp)? UUPARSE_TRAILING : UUPARSE_OK;
+    }
+
+    struct _uuco *prev = co;
+    while (prev->next != co)
+        prev = prev->next;
+    prev->next = co->next;
+    if (--_uubatch.live == 0)
+        _uuco_switch(&co->sp, _uubatch.sp);
+    _uubatch_swap(NULL, co->next);
+    _uuco_switch(&co->sp, co->next->sp);
+}
+
+// parse jobs[0..n) with rule, k parses interleaved, see notes; returns the
+// number that are UUPARSE_OK, or -1 if out of memory
+static _uuunused int
+uubatch(struct uujob *jobs, int n, int k, bool (*rule)(void *))
+{
+    struct uuscan save = uu;
+    struct _uuco *co;
+    int ok = 0;
+
+    if (k < 1)
+        k = 1;
+    if ((co = (struct _uuco *)calloc(k, sizeof *co)) == NULL)
+        return -1;
+    for (int i = 0; i < k; ++i) {
+        if ((co[i].stack = (char *)malloc(UUBATCH_STACK)) == NULL) {
+            while (i-- > 0)
+                free(co[i].stack);
+            free(co);
+            return -1;
+        }
+        co[i].sp = _uuco_new(co[i].stack, UUBATCH_STACK, (void (*)(void *))_uubatch_run,
+                             &co[i]);
+        co[i].next = &co[(i + 1) % k];
+        co[i].uu = uu;
+    }
+
+    _uubatch.jobs = jobs;
+    _uubatch.n = n;
+    _uubatch.taken = 0;
+    _uubatch.rule = rule;
+    _uubatch.live = k;
+    _uubatch.yields = 0;
+    _uubatch.cur = co;
+    _uuco_switch(&_uubatch.sp, co[0].sp);
+    _uubatch.cur = NULL;
+
+    uu = save;
+    for (int i = 0; i < k; ++i)
+        free(co[i].stack);
+    free(co);
+    for (int i = 0; i < n; ++i)
+        ok += jobs[i].status == UUPARSE_OK;
+    return ok;
+}
+
+// switches from one parse to the next in the last uubatch()
+static _uuunused long
+uubatch_yields(void)
+{
+    return _uubatch.yields;
+}
+#endif
+//}}}
+//{{{ uuresume
+#ifdef UURESUME
+// a resumable parse of lines with rule, see notes; NULL if out of memory
+static _uuunused struct uuresume *
+uuresume_new(bool (*rule)(void *), void *res)
+{
+    struct uuresume *r = (struct uuresume *)calloc(1, sizeof *r);
+
+    if (r == NULL || (r->stack = (char *)malloc(UURESUME_STACK)) == NULL) {
+        free(r);
+        return NULL;
+    }
+    r->rule = rule;
+    r->res = res;
+    return r;
+}
+
+static _uuunused void
+uuresume_free(struct uuresume *r)
+{
+    if (r) {
+        free(r->buf);
+        free(r->stack);
+        free(r->check);
+        free(r->copies);
+        free(r);
+    }
+}
+
+// the parse, from the start of the line: back to the caller at the end
+static void
+_uuresume_run(struct uuresume *r)
+{
+    jmp_buf jmp;
+    void *sp;
+
+    uu.jmp = &jmp;
+    if (setjmp(jmp))
+        r->status = UUPARSE_ERROR;
+    else if (!r->rule(r->res))
+        r->status = UUPARSE_NOMATCH;
+    else
+        r->status = *skipspace(uu.lp)? UUPARSE_TRAILING : UUPARSE_OK;
+    _uuco_switch(&sp, _uures.sp);
+}
+
+// parse ptr[0..len) as uuparse() would, resumed from the last checkpoint
+// that read nothing from where ptr differs from the line r parsed last
+static _uuunused int
+uuresume(struct uuresume *r, char *msg, const char *ptr, int len)
+{
+    struct uuscan save = uu;
+    struct _uucheck *c;
+    void *sp;
+    int d, n;
+
+    n = len < r->len? len : r->len;
+    for (d = 0; d + 64 <= n && memcmp(r->buf + d, ptr + d, 64) == 0; d += 64)
+        ;
+    for (; d < n && r->buf[d] == ptr[d]; ++d)
+        ;
+    if (d == len && d == r->len)
+        ++d;                    // the same line: its NUL is unchanged too
+    if (len + 1 > r->room) {
+        int room = r->room? r->room : 256;
+        char *buf;
+
+        while (len + 1 > room)
+            room *= 2;
+        if ((buf = (char *)realloc(r->buf, room)) == NULL)
+            return UUPARSE_ERROR;
+        if (buf != r->buf)
+            r->n = 0;           // the checkpoints point into the old line
+        r->buf = buf;
+        r->room = room;
+    }
+    memcpy(r->buf + d, ptr + d, len > d? len - d : 0);
+    r->buf[len] = '\0';
+    r->len = len;
+
+    for (n = r->n; n > 0 && r->check[n - 1].seen >= r->buf + d; --n)
+        ;
+    r->n = n;
+    _uures.r = r;
+    _uures.line = r->buf;
+    if (n == 0) {
+        uu.lp = uu.line = r->buf;
+        uu.arena = 0;
+        _uures.last = _uures.seen = r->buf;
+        r->used = 0;
+        r->from = 0;
+        sp = _uuco_new(r->stack, UURESUME_STACK, (void (*)(void *))_uuresume_run, r);
+    } else {
+        c = &r->check[n - 1];
+        _uucopy(&uu, &c->uu);
+        memcpy(c->sp, r->copies + c->copy, c->size);
+        _uures.last = c->pos;
+        _uures.seen = c->seen;
+        r->used = c->copy + c->size;
+        r->from = c->pos - r->buf;
+        sp = c->sp;
+    }
+    uu.msg = msg;
+    _uuco_switch(&_uures.sp, sp);
+
+    _uures.r = NULL;
+    _uures.line = NULL;
+    uu = save;
+    return r->status;
+}
+#endif
+//}}}
+
+// accept('x') -- a char constant is promoted to int and would select
+// __scan_term in _Generic, so casting to char is required for char literals:
+// accept((char)'x'), or use convenience macros:
+
+#define CHAR(x) (char)x
+
+// e.g.
+// #define EQ  CHAR('=')
+// ...
+// accept(CHAR('*'));
+// expect(EQ);
+
+//{{{ C++ selection
+#ifdef __cplusplus
+// overloads standing in for the _Generic selections in accept() and expect();
+// an enum terminal promotes to int, so terminals take the int overload
+
+static _uuinline bool
+_uuscan(const char *x, char *lp, void *res) { return __scan_literal(x, lp, res); }
+static _uuinline bool
+_uuscan(char x, char *lp, void *res)        { return __scan_char(x, lp, res); }
+static _uuinline bool
+_uuscan(int x, char *lp, void *res)         { return __scan_term(x, lp, res); }
+static _uuinline bool
+_uuscan(struct uukeys *x, char *lp, void *res) { return __scan_keys(x, lp, res); }
+
+static _uunoreturn _uuinline void
+_uumsg(const char *x, const char *msg)      { _msg_str(x, msg); }
+static _uunoreturn _uuinline void
+_uumsg(char x, const char *msg)             { _msg_char(x, msg); }
+static _uunoreturn _uuinline void
+_uumsg(int x, const char *msg)              { _msg_term(x, msg); }
+static _uunoreturn _uuinline void
+_uumsg(struct uukeys *x, const char *msg)   { _msg_keys(x, msg); }
+
+template <class... T> static _uuinline bool
+_uuacceptall(T... t)
+{
+    struct uumark savem = uumark();
+
+    if ((__accept(t, NULL) && ...))
+        return true;
+    uurollback(savem);
+    return false;
+}
+#endif
+//}}}
@@ -0,0 +1,95 @@
+// uusdt.h - USDT probes, a minimal stand-in for systemtap's <sys/sdt.h>
+// each probe is a nop plus an ELF note (.note.stapsdt) naming it and where
+// its arguments are; perf, bpftrace and systemtap find the probes from the note
+// github.com/spinau/uuscan
+
+/*{{{ uusdt.h exports
+Macros
+  STAP_PROBE(provider, name)            probe with no arguments
+  STAP_PROBE1(provider, name, a1) ... STAP_PROBE6(provider, name, a1, ..., a6)
+  DTRACE_PROBE(provider, name) ...      the same under their DTrace names
+}}}*/
+/*{{{ notes
+Probe sites compile to a single nop. The note records the address of the nop
+and, for each argument, an operand the compiler chose ("nor": a constant,
+register or memory operand), so arguments that are already in registers or
+in memory cost nothing; an argument that has to be computed is computed
+whether or not anything is attached, so pass the inputs and let the script
+do the arithmetic. Arguments are recorded as signed 8-byte values (-8@):
+narrower integers are widened and pointers read as addresses. There are no
+semaphores: a probe never tests whether it is attached.
+
+    STAP_PROBE2(myapp, request, id, len);
+
+    $ readelf -n ./myapp                       # list the probes
+    $ bpftrace -e 'usdt:./myapp:myapp:request { @[arg1] = count(); }'
+    $ perf probe -x ./myapp sdt_myapp:request   # after perf buildid-cache --add
+
+If the system's <sys/sdt.h> was included first it is used instead; once this
+header is included the system one is skipped. 64-bit targets only (8-byte
+addresses in the note), gcc and clang.
+}}}*/
+
+#ifndef _SYS_SDT_H
+#define _SYS_SDT_H      1       // <sys/sdt.h> included after this is empty
+
+#define _UUSDT_ARG(x)   "nor"((long)(x))
+
+// the note for one probe site: name size, descriptor size, type 3, "stapsdt",
+// then the probe address, the address of _.stapsdt.base (for prelink
+// adjustment), a semaphore address of 0, and provider, name and arguments
+#define _UUSDT(provider, name, args, ...)                                  \
+    __asm__ __volatile__ (                                                 \
+        "990: nop\n"                                                       \
+        ".pushsection .note.stapsdt,\"?\",\"note\"\n"                      \
+        ".balign 4\n"                                                      \
+        ".4byte 992f-991f, 994f-993f, 3\n"                                 \
+        "991: .asciz \"stapsdt\"\n"                                        \
+        "992: .balign 4\n"                                                 \
+        "993: .8byte 990b\n"                                               \
+        ".8byte _.stapsdt.base\n"                                          \
+        ".8byte 0\n"                                                       \
+        ".asciz \"" #provider "\"\n"                                       \
+        ".asciz \"" #name "\"\n"                                           \
+        ".asciz \"" args "\"\n"                                            \
+        "994: .balign 4\n"                                                 \
+        ".popsection\n"                                                    \
+        ".ifndef _.stapsdt.base\n"                                         \
+        ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n" \
+        ".weak _.stapsdt.base\n"                                           \
+        ".hidden _.stapsdt.base\n"                                         \
+        "_.stapsdt.base: .space 1\n"                                       \
+        ".size _.stapsdt.base, 1\n"                                        \
+        ".popsection\n"                                                    \
+        ".endif\n"                                                         \
+        :: __VA_ARGS__)
+
+#define STAP_PROBE(p, n)                                                   \
+    _UUSDT(p, n, "")
+#define STAP_PROBE1(p, n, a1)                                              \
+    _UUSDT(p, n, "-8@%0", _UUSDT_ARG(a1))
+#define STAP_PROBE2(p, n, a1, a2)                                          \
+    _UUSDT(p, n, "-8@%0 -8@%1", _UUSDT_ARG(a1), _UUSDT_ARG(a2))
+#define STAP_PROBE3(p, n, a1, a2, a3)                                      \
+    _UUSDT(p, n, "-8@%0 -8@%1 -8@%2", _UUSDT_ARG(a1), _UUSDT_ARG(a2),      \
+           _UUSDT_ARG(a3))
+#define STAP_PROBE4(p, n, a1, a2, a3, a4)                                  \
+    _UUSDT(p, n, "-8@%0 -8@%1 -8@%2 -8@%3", _UUSDT_ARG(a1), _UUSDT_ARG(a2),\
+           _UUSDT_ARG(a3), _UUSDT_ARG(a4))
+#define STAP_PROBE5(p, n, a1, a2, a3, a4, a5)                              \
+    _UUSDT(p, n, "-8@%0 -8@%1 -8@%2 -8@%3 -8@%4", _UUSDT_ARG(a1),          \
+           _UUSDT_ARG(a2), _UUSDT_ARG(a3), _UUSDT_ARG(a4), _UUSDT_ARG(a5))
+#define STAP_PROBE6(p, n, a1, a2, a3, a4, a5, a6)                          \
+    _UUSDT(p, n, "-8@%0 -8@%1 -8@%2 -8@%3 -8@%4 -8@%5", _UUSDT_ARG(a1),    \
+           _UUSDT_ARG(a2), _UUSDT_ARG(a3), _UUSDT_ARG(a4), _UUSDT_ARG(a5), \
+           _UUSDT_ARG(a6))
+
+#define DTRACE_PROBE(p, n)                      STAP_PROBE(p, n)
+#define DTRACE_PROBE1(p, n, a1)                 STAP_PROBE1(p, n, a1)
+#define DTRACE_PROBE2(p, n, a1, a2)             STAP_PROBE2(p, n, a1, a2)
+#define DTRACE_PROBE3(p, n, a1, a2, a3)         STAP_PROBE3(p, n, a1, a2, a3)
+#define DTRACE_PROBE4(p, n, a1, a2, a3, a4)     STAP_PROBE4(p, n, a1, a2, a3, a4)
+#define DTRACE_PROBE5(p, n, a1, a2, a3, a4, a5) STAP_PROBE5(p, n, a1, a2, a3, a4, a5)
+#define DTRACE_PROBE6(p, n, a1, a2, a3, a4, a5, a6) \
+        STAP_PROBE6(p, n, a1, a2, a3, a4, a5, a6)
+#endif
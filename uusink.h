@@ -0,0 +1,356 @@
+// uusink.h - columnar output for uuscan grammars in Arrow memory layout
+// grammar actions append typed values per field; no row struct in between
+// github.com/spinau/uuscan
+
+/*{{{ uusink.h exports
+Types
+  struct uusink                         batch of columns being filled
+  struct uucol                          column: name, type, validity bitmap, values
+  UUSINK_INT, UUSINK_FLOAT, UUSINK_STR  column types: int64, float64, string view
+
+Functions
+  bool uusink_init(struct uusink *, struct uucol *, int ncols, int batch,
+                   const char *base, size_t baselen, void (*flush)(struct uusink *))
+  uusink_int(struct uusink *, int col, int64_t)
+  uusink_float(struct uusink *, int col, double)
+  uusink_str(struct uusink *, int col, const char *p, int len)
+  uusink_row(struct uusink *)           commit the row, flush when the batch is full
+  uusink_drop(struct uusink *)          discard the row being written
+  uusink_end(struct uusink *)           flush the last partial batch and free
+  uusink_arrow(struct uusink *, struct ArrowArray **, struct ArrowSchema **)
+                                        batch as an Arrow C data interface struct array
+}}}*/
+/*{{{ notes
+Set up one struct uucol per field with its name and type, then:
+
+    struct uucol cols[] = { { "host", UUSINK_STR }, { "status", UUSINK_INT }, ... };
+    struct uusink sink;
+
+    uusink_init(&sink, cols, NCOLS, 65536, input, inputlen, consume);
+
+Grammar actions write the fields of the current row as they are scanned:
+
+    expect(_field_, &s, "expected host");
+    uusink_str(&sink, HOST, s.p, s.len);
+
+and the row is committed once the whole record has parsed. A field not written
+in a row is null. on_uuerror should call uusink_drop() so that fields written
+before the error do not leak into the next row.
+
+When batch rows are committed flush(sink) is called with sink->n rows in the
+columns, col[i].nulls set, and the buffers in the layout of the Arrow columnar
+format: validity bitmaps LSB first (bit set = valid), int64 and float64 values,
+and strings as 16-byte views (Utf8View): up to 12 bytes inline, longer strings
+as a 4-byte prefix and a buffer index and offset into the input. The input is
+presented as buffers of up to 1G windows so that offsets fit in 32 bits. Every
+buffer is 64-byte aligned and padded. uusink_arrow() wraps the current batch as
+a struct array for Arrow C data interface consumers.
+
+The batch is only valid during flush(): the buffers are reused for the next
+batch and the release callbacks only mark the arrays released, so a consumer
+that keeps data past flush() must copy it. String views point into the input,
+which must outlive the sink. sink->arg is free for the flush callback.
+}}}*/
+//{{{ includes
+#ifndef _STDLIB_H
+#include <stdlib.h>
+#endif
+#ifndef _STDINT_H
+#include <stdint.h>
+#endif
+#ifndef _STRING_H
+#include <string.h>
+#endif
+#ifndef _STDBOOL_H
+#include <stdbool.h>
+#endif
+//}}}
+//{{{ Arrow C data interface
+// as published in the Arrow format specification
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+struct ArrowSchema {
+    const char* format;
+    const char* name;
+    const char* metadata;
+    int64_t flags;
+    int64_t n_children;
+    struct ArrowSchema** children;
+    struct ArrowSchema* dictionary;
+    void (*release)(struct ArrowSchema*);
+    void* private_data;
+};
+
+struct ArrowArray {
+    int64_t length;
+    int64_t null_count;
+    int64_t offset;
+    int64_t n_buffers;
+    int64_t n_children;
+    const void** buffers;
+    struct ArrowArray** children;
+    struct ArrowArray* dictionary;
+    void (*release)(struct ArrowArray*);
+    void* private_data;
+};
+#endif
+//}}}
+
+enum { UUSINK_INT, UUSINK_FLOAT, UUSINK_STR };
+
+// Arrow string view: inline up to 12 bytes, else prefix, buffer and offset
+struct uuview {
+    int32_t len;
+    union {
+        char data[12];
+        struct {
+            char prefix[4];
+            int32_t buf;
+            int32_t off;
+        } ref;
+    };
+};
+
+struct uucol {
+    const char *name;
+    int type;           // UUSINK_INT, UUSINK_FLOAT, UUSINK_STR
+    uint8_t *valid;     // validity bitmap for the batch
+    union {
+        int64_t *i;
+        double *f;
+        struct uuview *s;
+        void *p;
+    } v;                // values for the batch
+    int64_t nulls;      // null count, set before flush()
+};
+
+struct uusink {
+    struct uucol *col;
+    int ncols;
+    int batch;          // rows per batch
+    int n;              // rows committed in this batch, row being written
+    int64_t rows;       // rows in earlier batches
+    void (*flush)(struct uusink *);
+    void *arg;          // for the app's flush callback
+    const char *base;   // input the string views point into
+    size_t baselen;
+    int nbufs;          // 1G windows of base
+    //{{{ export
+    struct ArrowSchema schema, *schemas, **pschemas;
+    struct ArrowArray array, *arrays, **parrays;
+    const void **bufs;  // 2 per column, string columns 2 + nbufs + 1
+    int64_t *bufsizes;  // variadic buffer sizes, shared by string columns
+    //}}}
+};
+
+#define _UUSINK_WINDOW  30          // log2 of base window size
+#define _uusink_pad(n)  (((n) + 63) & ~(size_t)63)
+
+// zeroed, 64-byte aligned and padded
+static void *
+_uusink_alloc(size_t n)
+{
+    void *p = aligned_alloc(64, _uusink_pad(n));
+
+    if (p)
+        memset(p, 0, _uusink_pad(n));
+    return p;
+}
+
+static inline void
+_uusink_valid(struct uusink *s, int c)
+{
+    s->col[c].valid[s->n >> 3] |= 1 << (s->n & 7);
+}
+
+static inline void
+uusink_int(struct uusink *s, int c, int64_t val)
+{
+    s->col[c].v.i[s->n] = val;
+    _uusink_valid(s, c);
+}
+
+static inline void
+uusink_float(struct uusink *s, int c, double val)
+{
+    s->col[c].v.f[s->n] = val;
+    _uusink_valid(s, c);
+}
+
+static inline void
+uusink_str(struct uusink *s, int c, const char *p, int len)
+{
+    struct uuview *v = &s->col[c].v.s[s->n];
+    size_t off = p - s->base;
+
+    v->len = len;
+    if (len <= 12) {
+        memset(v->data, 0, sizeof v->data);
+        memcpy(v->data, p, len);
+    } else {
+        memcpy(v->ref.prefix, p, 4);
+        v->ref.buf = off >> _UUSINK_WINDOW;
+        v->ref.off = off & ((1 << _UUSINK_WINDOW) - 1);
+    }
+    _uusink_valid(s, c);
+}
+
+// flush the committed rows and start an empty batch
+static void
+_uusink_flush(struct uusink *s)
+{
+    int bytes = (s->n + 7) >> 3;
+
+    for (int c = 0; c < s->ncols; ++c) {
+        struct uucol *col = &s->col[c];
+        int valid = 0;
+
+        // a partial last byte only holds committed rows
+        for (int i = 0; i < bytes; ++i)
+            valid += __builtin_popcount(col->valid[i]);
+        col->nulls = s->n - valid;
+
+        // null views are zeroed so consumers that check views see no garbage
+        if (col->type == UUSINK_STR && col->nulls)
+            for (int i = 0; i < s->n; ++i)
+                if (!(col->valid[i >> 3] & 1 << (i & 7)))
+                    memset(&col->v.s[i], 0, sizeof col->v.s[i]);
+    }
+
+    s->flush(s);
+
+    for (int c = 0; c < s->ncols; ++c)
+        memset(s->col[c].valid, 0, bytes);
+    s->rows += s->n;
+    s->n = 0;
+}
+
+static inline void
+uusink_row(struct uusink *s)
+{
+    if (++s->n == s->batch)
+        _uusink_flush(s);
+}
+
+static void
+uusink_drop(struct uusink *s)
+{
+    for (int c = 0; c < s->ncols; ++c)
+        s->col[c].valid[s->n >> 3] &= ~(1 << (s->n & 7));
+}
+
+static bool
+uusink_init(struct uusink *s, struct uucol *col, int ncols, int batch,
+            const char *base, size_t baselen, void (*flush)(struct uusink *))
+{
+    static const size_t size[] = {
+        [UUSINK_INT] = sizeof(int64_t),
+        [UUSINK_FLOAT] = sizeof(double),
+        [UUSINK_STR] = sizeof(struct uuview),
+    };
+    int nbufs = (baselen >> _UUSINK_WINDOW) + 1;
+
+    memset(s, 0, sizeof *s);
+    s->col = col;
+    s->ncols = ncols;
+    s->batch = batch;
+    s->flush = flush;
+    s->base = base;
+    s->baselen = baselen;
+    s->nbufs = nbufs;
+
+    for (int c = 0; c < ncols; ++c)
+        if ((col[c].valid = _uusink_alloc((batch + 7) >> 3)) == NULL
+                || (col[c].v.p = _uusink_alloc(batch * size[col[c].type])) == NULL)
+            return false;
+
+    s->schemas = calloc(ncols, sizeof *s->schemas);
+    s->pschemas = calloc(ncols, sizeof *s->pschemas);
+    s->arrays = calloc(ncols, sizeof *s->arrays);
+    s->parrays = calloc(ncols, sizeof *s->parrays);
+    s->bufs = calloc(ncols * (2 + nbufs + 1) + 1, sizeof *s->bufs);
+    s->bufsizes = calloc(nbufs, sizeof *s->bufsizes);
+    if (!s->schemas || !s->pschemas || !s->arrays || !s->parrays || !s->bufs || !s->bufsizes)
+        return false;
+
+    // windows overlap to the end of base, so a string may cross a boundary
+    for (int b = 0; b < nbufs; ++b)
+        s->bufsizes[b] = baselen - ((size_t)b << _UUSINK_WINDOW);
+    return true;
+}
+
+static void
+uusink_end(struct uusink *s)
+{
+    if (s->n)
+        _uusink_flush(s);
+    for (int c = 0; c < s->ncols; ++c) {
+        free(s->col[c].valid);
+        free(s->col[c].v.p);
+    }
+    free(s->schemas);
+    free(s->pschemas);
+    free(s->arrays);
+    free(s->parrays);
+    free(s->bufs);
+    free(s->bufsizes);
+}
+
+//{{{ Arrow export
+// the sink owns all memory, release only marks the struct released
+static void _uusink_release_schema(struct ArrowSchema *sch) { sch->release = NULL; }
+static void _uusink_release_array(struct ArrowArray *arr) { arr->release = NULL; }
+
+// current batch as a struct array with one child per column
+static void
+uusink_arrow(struct uusink *s, struct ArrowArray **array, struct ArrowSchema **schema)
+{
+    static const char *format[] = {
+        [UUSINK_INT] = "l", [UUSINK_FLOAT] = "g", [UUSINK_STR] = "vu",
+    };
+    const void **bp = s->bufs;
+
+    for (int c = 0; c < s->ncols; ++c) {
+        struct uucol *col = &s->col[c];
+        struct ArrowSchema *sch = &s->schemas[c];
+        struct ArrowArray *arr = &s->arrays[c];
+
+        *sch = (struct ArrowSchema){
+            .format = format[col->type], .name = col->name,
+            .flags = ARROW_FLAG_NULLABLE, .release = _uusink_release_schema,
+        };
+        *arr = (struct ArrowArray){
+            .length = s->n, .null_count = col->nulls, .n_buffers = 2,
+            .buffers = bp, .release = _uusink_release_array,
+        };
+        *bp++ = col->valid;
+        *bp++ = col->v.p;
+        if (col->type == UUSINK_STR) {
+            for (int b = 0; b < s->nbufs; ++b)
+                *bp++ = s->base + ((size_t)b << _UUSINK_WINDOW);
+            *bp++ = s->bufsizes;
+            arr->n_buffers += s->nbufs + 1;
+        }
+        s->pschemas[c] = sch;
+        s->parrays[c] = arr;
+    }
+
+    // struct parent has no nulls; its validity buffer is omitted
+    *bp = NULL;
+    s->schema = (struct ArrowSchema){
+        .format = "+s", .name = "", .n_children = s->ncols,
+        .children = s->pschemas, .release = _uusink_release_schema,
+    };
+    s->array = (struct ArrowArray){
+        .length = s->n, .n_buffers = 1, .buffers = bp, .n_children = s->ncols,
+        .children = s->parrays, .release = _uusink_release_array,
+    };
+    *array = &s->array;
+    *schema = &s->schema;
+}
+//}}}
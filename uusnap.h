@@ -0,0 +1,370 @@
+// uusnap.h - name tables for live parsers, reloaded without stopping readers
+// a table is an immutable snapshot: readers take no lock and a reload swaps in
+// a new one; the old one is freed once every reader has moved past it
+// github.com/spinau/uuscan
+
+/*{{{ uusnap.h exports
+Types
+  struct uusnap                         immutable table: name -> value
+  struct uusnap_entry                   { const char *name; void *value; }
+
+Functions
+  struct uusnap *uusnap_build(const struct uusnap_entry *, int n, void (*free)(void *))
+                                        table over a copy of n entries
+  void *uusnap_find(const struct uusnap *, const char *name, int len)
+  struct uusnap *uusnap_get(struct uusnap **)
+                                        current snapshot, held until quiescent
+  int uusnap_publish(struct uusnap **, struct uusnap *)
+                                        swap in a new snapshot, retire the old one
+  bool uusnap_register()                make the calling thread a reader
+  uusnap_unregister()
+  uusnap_quiescent()                    reader holds no snapshot: between parses
+  uusnap_offline()                      reader idle until uusnap_online()
+  uusnap_online()
+  int uusnap_synchronize()              wait for every reader to pass a quiescent point
+  int uusnap_reclaim()                  free retired snapshots no reader can hold
+  uusnap_free(struct uusnap *)          free a snapshot that was never published
+}}}*/
+/*{{{ notes
+Names the grammar looks up (builtins, commands, keywords, interned symbols)
+go in a table built once and never modified:
+
+    struct uusnap_entry e[] = { { "min", &min_fn }, { "max", &max_fn }, ... };
+    static struct uusnap *builtins;
+
+    uusnap_publish(&builtins, uusnap_build(e, NENTRIES, NULL));
+
+Each parser thread registers as a reader, takes the current snapshot once per
+parse and declares a quiescent point when it holds no snapshot, between
+parses:
+
+    uusnap_register();
+    while (nextline()) {
+        struct uusnap *s = uusnap_get(&builtins);
+        ... fn = uusnap_find(s, name, len) ...
+        uusnap_quiescent();
+    }
+    uusnap_unregister();
+
+A reload builds the new table and publishes it; readers already in a parse
+keep the snapshot they took, so a parse sees one table throughout. The old
+snapshot is retired and freed, with its values if the table was built with a
+free function, once every registered reader has passed a quiescent point
+since the swap (quiescent-state based reclamation). uusnap_publish() frees
+what it can without waiting; what is left goes at a later publish or
+uusnap_reclaim(), or uusnap_synchronize() waits for it. A reader that blocks
+for long (reading input, waiting for work) should go offline so it does not
+hold reclamation up, and online again before its next uusnap_get().
+
+The reader side is an acquire load per uusnap_get() and a load and a store
+to the thread's own cache line per uusnap_quiescent(); no reader writes
+anything another reader reads. Writers serialize on a spin lock. Up to
+UUSNAP_READERS (default 64) threads can be registered at once. A thread that
+publishes while registered is treated as quiescent by uusnap_synchronize(),
+so it must not hold a snapshot then. Entries are found by hash, names are
+compared by length and bytes and need not be NUL terminated.
+}}}*/
+//{{{ includes
+#ifndef _STDLIB_H
+#include <stdlib.h>
+#endif
+#ifndef _STRING_H
+#include <string.h>
+#endif
+#ifndef _STDBOOL_H
+#include <stdbool.h>
+#endif
+#ifndef _LIMITS_H
+#include <limits.h>
+#endif
+#ifndef _SCHED_H
+#include <sched.h>
+#endif
+//}}}
+
+#ifndef UUSNAP_READERS
+#define UUSNAP_READERS  64
+#endif
+
+#ifdef __cplusplus
+#define _uusnap_tls     thread_local
+#else
+#define _uusnap_tls     _Thread_local
+#endif
+
+struct uusnap_entry {
+    const char *name;
+    void *value;
+};
+
+struct uusnap {
+    unsigned mask;              // slots - 1
+    int n;
+    void (*free)(void *);       // frees each value with the snapshot, or NULL
+    struct uusnap *next;        // retired list
+    unsigned long epoch;        // retired at
+    struct {
+        unsigned hash;
+        int len;
+        const char *name;       // NULL: empty slot
+        void *value;
+    } slot[];                   // followed by the names
+};
+
+//{{{ table
+static unsigned
+_uusnap_hash(const char *p, int len)
+{
+    unsigned h = 2166136261u;   // FNV-1a
+
+    while (len-- > 0)
+        h = (h ^ (unsigned char)*p++) * 16777619u;
+    return h;
+}
+
+// NULL if out of memory
+static struct uusnap *
+uusnap_build(const struct uusnap_entry *e, int n, void (*free_value)(void *))
+{
+    unsigned slots = 8;
+    size_t names = 0;
+    struct uusnap *s;
+    char *cp;
+
+    while (slots < 2u * n)
+        slots *= 2;
+    for (int i = 0; i < n; ++i)
+        names += strlen(e[i].name) + 1;
+    s = (struct uusnap *)calloc(1, sizeof *s + slots * sizeof s->slot[0] + names);
+    if (s == NULL)
+        return NULL;
+    s->mask = slots - 1;
+    s->n = n;
+    s->free = free_value;
+    cp = (char *)&s->slot[slots];
+
+    for (int i = 0; i < n; ++i) {
+        int len = strlen(e[i].name);
+        unsigned h = _uusnap_hash(e[i].name, len), j = h & s->mask;
+
+        while (s->slot[j].name)
+            j = (j + 1) & s->mask;
+        s->slot[j].hash = h;
+        s->slot[j].len = len;
+        s->slot[j].name = (const char *)memcpy(cp, e[i].name, len + 1);
+        s->slot[j].value = e[i].value;
+        cp += len + 1;
+    }
+    return s;
+}
+
+// value of name, NULL if not in the table; the first of duplicate names
+static inline void *
+uusnap_find(const struct uusnap *s, const char *name, int len)
+{
+    unsigned h = _uusnap_hash(name, len), j = h & s->mask;
+
+    for (; s->slot[j].name; j = (j + 1) & s->mask)
+        if (s->slot[j].hash == h && s->slot[j].len == len
+                && memcmp(s->slot[j].name, name, len) == 0)
+            return s->slot[j].value;
+    return NULL;
+}
+
+// a snapshot never published, or one no reader can hold any more
+static void
+uusnap_free(struct uusnap *s)
+{
+    if (s->free)
+        for (unsigned j = 0; j <= s->mask; ++j)
+            if (s->slot[j].name)
+                s->free(s->slot[j].value);
+    free(s);
+}
+//}}}
+//{{{ readers
+// a reader's seen is the epoch at its last quiescent point plus 1, 0 while
+// offline; each on its own cache line so readers never share a written line
+static struct {
+    unsigned long epoch;        // bumped by each retire
+    int lock;                   // writers
+    int nreaders;               // high water mark of reader slots
+    struct uusnap *retired;
+    struct {
+        unsigned long seen __attribute__((aligned(64)));
+        int used;
+    } reader[UUSNAP_READERS];
+} _uusnap;
+
+static _uusnap_tls int _uusnap_me = -1; // reader slot, -1 if not registered
+
+static inline unsigned long
+_uusnap_epoch(void)
+{
+    return __atomic_load_n(&_uusnap.epoch, __ATOMIC_ACQUIRE) + 1;
+}
+
+// quiescent, offline and online do nothing in a thread that is not registered
+static inline void
+uusnap_quiescent(void)
+{
+    if (_uusnap_me < 0)
+        return;
+    __atomic_store_n(&_uusnap.reader[_uusnap_me].seen, _uusnap_epoch(), __ATOMIC_RELEASE);
+}
+
+static inline void
+uusnap_offline(void)
+{
+    if (_uusnap_me < 0)
+        return;
+    __atomic_store_n(&_uusnap.reader[_uusnap_me].seen, 0, __ATOMIC_RELEASE);
+}
+
+// the fence keeps the next uusnap_get() after the store, so a writer either
+// sees this reader online or this reader sees the writer's new snapshot
+static inline void
+uusnap_online(void)
+{
+    if (_uusnap_me < 0)
+        return;
+    __atomic_store_n(&_uusnap.reader[_uusnap_me].seen, _uusnap_epoch(), __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+// false if UUSNAP_READERS are registered
+static bool
+uusnap_register(void)
+{
+    for (int i = 0; i < UUSNAP_READERS; ++i)
+        if (__atomic_exchange_n(&_uusnap.reader[i].used, 1, __ATOMIC_ACQ_REL) == 0) {
+            int n = __atomic_load_n(&_uusnap.nreaders, __ATOMIC_RELAXED);
+            while (n < i + 1 && !__atomic_compare_exchange_n(&_uusnap.nreaders,
+                        &n, i + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+                ;
+            _uusnap_me = i;
+            uusnap_online();
+            return true;
+        }
+    return false;
+}
+
+static void
+uusnap_unregister(void)
+{
+    if (_uusnap_me < 0)
+        return;
+    __atomic_store_n(&_uusnap.reader[_uusnap_me].seen, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&_uusnap.reader[_uusnap_me].used, 0, __ATOMIC_RELEASE);
+    _uusnap_me = -1;
+}
+
+static inline struct uusnap *
+uusnap_get(struct uusnap **cur)
+{
+    return __atomic_load_n(cur, __ATOMIC_ACQUIRE);
+}
+//}}}
+//{{{ writers
+static void
+_uusnap_lock(void)
+{
+    while (__atomic_exchange_n(&_uusnap.lock, 1, __ATOMIC_ACQUIRE))
+        sched_yield();
+}
+
+static void
+_uusnap_unlock(void)
+{
+    __atomic_store_n(&_uusnap.lock, 0, __ATOMIC_RELEASE);
+}
+
+// oldest epoch a reader online may still hold a snapshot from
+static unsigned long
+_uusnap_oldest(void)
+{
+    unsigned long min = ULONG_MAX;
+    int n = __atomic_load_n(&_uusnap.nreaders, __ATOMIC_ACQUIRE);
+
+    for (int i = 0; i < n; ++i) {
+        unsigned long seen = __atomic_load_n(&_uusnap.reader[i].seen, __ATOMIC_SEQ_CST);
+        if (seen && seen < min)
+            min = seen;
+    }
+    return min;
+}
+
+// a snapshot retired at e is safe once every reader online has seen e;
+// the list is taken before the readers are read, so a snapshot retired later
+// is not judged by a scan that began before its retirement; returns how many
+// were freed
+static int
+uusnap_reclaim(void)
+{
+    struct uusnap *list, *keep = NULL, *next;
+    unsigned long oldest;
+    int freed = 0;
+
+    _uusnap_lock();
+    list = _uusnap.retired;
+    _uusnap.retired = NULL;
+    _uusnap_unlock();
+
+    oldest = _uusnap_oldest();
+    for (; list; list = next) {
+        next = list->next;
+        if (list->epoch <= oldest) {
+            uusnap_free(list);
+            ++freed;
+        } else {
+            list->next = keep;
+            keep = list;
+        }
+    }
+
+    if (keep) {
+        _uusnap_lock();
+        for (list = keep; list->next; list = list->next)
+            ;
+        list->next = _uusnap.retired;
+        _uusnap.retired = keep;
+        _uusnap_unlock();
+    }
+    return freed;
+}
+
+// returns how many retired snapshots were freed
+static int
+uusnap_publish(struct uusnap **cur, struct uusnap *s)
+{
+    struct uusnap *old = __atomic_exchange_n(cur, s, __ATOMIC_SEQ_CST);
+
+    if (old) {
+        _uusnap_lock();
+        old->epoch = __atomic_add_fetch(&_uusnap.epoch, 1, __ATOMIC_SEQ_CST) + 1;
+        old->next = _uusnap.retired;
+        _uusnap.retired = old;
+        _uusnap_unlock();
+    }
+    return uusnap_reclaim();
+}
+
+// returns how many retired snapshots were freed
+static int
+uusnap_synchronize(void)
+{
+    unsigned long e = __atomic_add_fetch(&_uusnap.epoch, 1, __ATOMIC_SEQ_CST) + 1;
+    int n = __atomic_load_n(&_uusnap.nreaders, __ATOMIC_ACQUIRE);
+
+    if (_uusnap_me >= 0)
+        uusnap_quiescent();
+    for (int i = 0; i < n; ++i)
+        for (;;) {
+            unsigned long seen = __atomic_load_n(&_uusnap.reader[i].seen, __ATOMIC_SEQ_CST);
+            if (seen == 0 || seen >= e)
+                break;
+            sched_yield();
+        }
+    return uusnap_reclaim();
+}
+//}}}